@@ -99,6 +99,8 @@
 #include "gpio.h"
 #include "switch.h"
 #include "hardware.h"
+#include "kinematics.h"
+#include "persistence.h"
 #include "util.h"
 #include "xio.h"			// for serial queue flush
 /*
@@ -372,16 +374,14 @@ void cm_update_model_position_from_runtime() { copy_vector(cm.gmx.position, mr.g
 /*
  * cm_deferred_write_callback() - write any changed G10 values back to persistence
  *
- *	Only runs if there is G10 data to write, there is no movement, and the serial queues are quiescent
- *	This could be made tighter by issuing an XOFF or ~CTS beforehand and releasing it afterwards.
+ *	Only runs if there is G10 data to write and there is no movement. The values only go
+ *	as far as the NVM write queue; nvm_write_callback() waits for the serial queues to
+ *	be quiescent before writing them.
  */
 
 stat_t cm_deferred_write_callback()
 {
 	if ((cm.cycle_state == CYCLE_OFF) && (cm.deferred_write_flag == true)) {
-#ifdef __AVR
-		if (xio_isbusy()) return (STAT_OK);		// don't write back if serial RX is not empty
-#endif
 		cm.deferred_write_flag = false;
 		nvObj_t nv;
 		for (uint8_t i=1; i<=COORDS; i++) {
@@ -392,6 +392,7 @@ stat_t cm_deferred_write_callback()
 				nv_persist(&nv);				// Note: only writes values that have changed
 			}
 		}
+		nvm_flush();							// offsets share log pages - write them together
 	}
 	return (STAT_OK);
 }
@@ -1139,6 +1140,45 @@ stat_t cm_spindle_override_factor(uint8_t flag)		// M50.1
 	return (STAT_OK);
 }
 
+/*
+ * cm_step_override_factor() - step an override factor for realtime override commands
+ * cm_adjust_feed_override() - apply realtime feed override steps
+ * cm_apply_feed_override() - scale a feed move time by the feed rate override
+ *
+ *	The factor is reset to 100% first if reset is true, then moved by steps * OVERRIDE_STEP
+ *	and clamped to the override range. Realtime adjustments enable the override.
+ *
+ *	The feed rate factor is applied as moves are planned, by _calc_move_times() for lines
+ *	and _estimate_arc_time() for arcs, using cm_apply_feed_override(). It is not applied to
+ *	homing, probing or jogging. Moves already in the planner queue keep the feed rate they
+ *	were planned with.
+ */
+
+float cm_step_override_factor(float factor, uint8_t reset, int8_t steps)
+{
+	if ((reset == true) || (factor <= 0)) factor = 1.0;
+	factor += steps * OVERRIDE_STEP;
+	if (factor < OVERRIDE_FACTOR_MIN) factor = OVERRIDE_FACTOR_MIN;
+	if (factor > OVERRIDE_FACTOR_MAX) factor = OVERRIDE_FACTOR_MAX;
+	return (factor);
+}
+
+void cm_adjust_feed_override(uint8_t reset, int8_t steps)
+{
+	if (cm.gmx.feed_rate_override_enable == false) reset = true;
+	cm.gmx.feed_rate_override_factor = cm_step_override_factor(cm.gmx.feed_rate_override_factor, reset, steps);
+	cm.gmx.feed_rate_override_enable = true;
+}
+
+float cm_apply_feed_override(const float time)
+{
+	if ((cm.gmx.feed_rate_override_enable == true) && (cm.gmx.feed_rate_override_factor > 0) &&
+		(cm.cycle_state <= CYCLE_MACHINING)) {
+		return (time / cm.gmx.feed_rate_override_factor);
+	}
+	return (time);
+}
+
 /*
  * cm_message() - queue a RAM string as a message in the response (unconditionally)
  *
@@ -1330,6 +1370,7 @@ void cm_cycle_start()
 	if (cm.cycle_state == CYCLE_OFF) {					// don't (re)start homing, probe or other canned cycles
 		cm.cycle_state = CYCLE_MACHINING;
 		qr_init_queue_report();							// clear queue reporting buffer counts
+		en_reset_following_error();						// following error peaks are per cycle
 	}
 }
 
@@ -1377,7 +1418,7 @@ void cm_program_end()
 static const char msg_units0[] PROGMEM = " in";	// used by generic print functions
 static const char msg_units1[] PROGMEM = " mm";
 static const char msg_units2[] PROGMEM = " deg";
-static const char *const msg_units[] PROGMEM = { msg_units0, msg_units1, msg_units2 };
+const char *const msg_units[] PROGMEM = { msg_units0, msg_units1, msg_units2 };	// also used by kinematics.c
 #define DEGREE_INDEX 2
 
 static const char msg_am00[] PROGMEM = "[disabled]";
@@ -1676,6 +1717,7 @@ stat_t cm_set_am(nvObj_t *nv)		// axis mode
 		if (nv->value > AXIS_MODE_MAX_ROTARY) { return (STAT_INPUT_EXCEEDS_MAX_VALUE);}
 	}
 	set_ui8(nv);
+	kin_update_motor_map();					// inhibited axes are zeroed in the map
 	return(STAT_OK);
 }
 
@@ -1741,6 +1783,31 @@ stat_t cm_run_home(nvObj_t *nv)
 	return (STAT_OK);
 }
 
+stat_t cm_run_cal(nvObj_t *nv)
+{
+	char_t axes[] = {"xyzabc"};
+	char_t *ptr;
+
+	if (fp_FALSE(nv->value)) { return (STAT_OK);}
+	if (cm.cycle_state != CYCLE_OFF) { return (STAT_COMMAND_NOT_ACCEPTED);}
+	if ((ptr = strchr(axes, nv->token[3])) == NULL) { return (STAT_INTERNAL_RANGE_ERROR);}
+	return (cm_calibration_cycle_start(ptr - axes));
+}
+
+stat_t cm_set_prbs(nvObj_t *nv)
+{
+	if (cm.cycle_state != CYCLE_OFF) { return (STAT_COMMAND_NOT_ACCEPTED);}
+	if (nv->value >= NUM_SWITCHES) { return (STAT_INPUT_VALUE_RANGE_ERROR);}
+	return (set_ui8(nv));
+}
+
+stat_t cm_run_hmp(nvObj_t *nv)
+{
+	if (fp_FALSE(nv->value)) { return (STAT_OK);}
+	if (cm.cycle_state != CYCLE_OFF) { return (STAT_COMMAND_NOT_ACCEPTED);}
+	return (cm_probe_grid_start());
+}
+
 /*
  * Debugging Commands
  *
@@ -1874,6 +1941,12 @@ void cm_print_gdi(nvObj_t *nv) { text_print_int(nv, fmt_gdi);}
 
 const char fmt_ja[] PROGMEM = "[ja]  junction acceleration%8.0f%s\n";
 const char fmt_ct[] PROGMEM = "[ct]  chordal tolerance%17.4f%s\n";
+const char fmt_ca[] PROGMEM = "[ca]  arc acceleration%13.0f%s\n";
+const char fmt_cjl[] PROGMEM = "[cjl] calibration jerk limit%11.2f x jm\n";
+const char fmt_cvl[] PROGMEM = "[cvl] calibration velocity limit%7.2f x vm\n";
+const char fmt_ctr[] PROGMEM = "[ctr] calibration trials%12d\n";
+const char fmt_prbs[] PROGMEM = "[prbs] probe input switch%11d [0-7]\n";
+const char fmt_prbr[] PROGMEM = "[prbr] probe report enable%10d [0=off,1=stream]\n";
 const char fmt_sl[] PROGMEM = "[sl]  soft limit enable%12d\n";
 const char fmt_ml[] PROGMEM = "[ml]  min line segment%17.3f%s\n";
 const char fmt_ma[] PROGMEM = "[ma]  min arc segment%18.3f%s\n";
@@ -1881,6 +1954,12 @@ const char fmt_ms[] PROGMEM = "[ms]  min segment time%13.0f uSec\n";
 
 void cm_print_ja(nvObj_t *nv) { text_print_flt_units(nv, fmt_ja, GET_UNITS(ACTIVE_MODEL));}
 void cm_print_ct(nvObj_t *nv) { text_print_flt_units(nv, fmt_ct, GET_UNITS(ACTIVE_MODEL));}
+void cm_print_ca(nvObj_t *nv) { text_print_flt_units(nv, fmt_ca, GET_UNITS(ACTIVE_MODEL));}
+void cm_print_cjl(nvObj_t *nv) { text_print_flt(nv, fmt_cjl);}
+void cm_print_cvl(nvObj_t *nv) { text_print_flt(nv, fmt_cvl);}
+void cm_print_ctr(nvObj_t *nv) { text_print_ui8(nv, fmt_ctr);}
+void cm_print_prbs(nvObj_t *nv) { text_print_ui8(nv, fmt_prbs);}
+void cm_print_prbr(nvObj_t *nv) { text_print_ui8(nv, fmt_prbr);}
 void cm_print_sl(nvObj_t *nv) { text_print_ui8(nv, fmt_sl);}
 void cm_print_ml(nvObj_t *nv) { text_print_flt_units(nv, fmt_ml, GET_UNITS(ACTIVE_MODEL));}
 void cm_print_ma(nvObj_t *nv) { text_print_flt_units(nv, fmt_ma, GET_UNITS(ACTIVE_MODEL));}
@@ -1907,6 +1986,7 @@ void cm_print_ms(nvObj_t *nv) { text_print_flt_units(nv, fmt_ms, GET_UNITS(ACTIV
  *	cm_print_lv()
  *	cm_print_lb()
  *	cm_print_zb()
+ *	cm_print_hg()
  *
  *	cm_print_pos() - print position with unit displays for MM or Inches
  * 	cm_print_mpo() - print position with fixed unit display - always in Degrees or MM
@@ -1927,6 +2007,7 @@ static const char fmt_Xsv[] PROGMEM = "[%s%s] %s search velocity%12.0f%s/min\n";
 static const char fmt_Xlv[] PROGMEM = "[%s%s] %s latch velocity%13.0f%s/min\n";
 static const char fmt_Xlb[] PROGMEM = "[%s%s] %s latch backoff%18.3f%s\n";
 static const char fmt_Xzb[] PROGMEM = "[%s%s] %s zero backoff%19.3f%s\n";
+static const char fmt_Xhg[] PROGMEM = "[%s%s] %s homing group%16d\n";
 static const char fmt_cofs[] PROGMEM = "[%s%s] %s %s offset%20.3f%s\n";
 static const char fmt_cpos[] PROGMEM = "[%s%s] %s %s position%18.3f%s\n";
 
@@ -1985,6 +2066,7 @@ void cm_print_sv(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xsv);}
 void cm_print_lv(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xlv);}
 void cm_print_lb(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xlb);}
 void cm_print_zb(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xzb);}
+void cm_print_hg(nvObj_t *nv) { _print_axis_ui8(nv, fmt_Xhg);}
 
 void cm_print_cofs(nvObj_t *nv) { _print_axis_coord_flt(nv, fmt_cofs);}
 void cm_print_cpos(nvObj_t *nv) { _print_axis_coord_flt(nv, fmt_cpos);}
@@ -47,6 +47,9 @@ extern "C"{
 #define _to_millimeters(a) ((cm.gm.units_mode == INCHES) ? (a * MM_PER_INCH) : a)
 
 #define JOGGING_START_VELOCITY ((float)10.0)
+#define OVERRIDE_STEP ((float)0.10)			// realtime override increment (10%)
+#define OVERRIDE_FACTOR_MIN ((float)0.10)	// override factor clamps
+#define OVERRIDE_FACTOR_MAX ((float)2.00)
 #define DISABLE_SOFT_LIMIT (-1000000)
 
 /*****************************************************************************
@@ -206,6 +209,7 @@ typedef struct cmAxis {
 	float latch_velocity;				// homing latch velocity
 	float latch_backoff;				// backoff from switches prior to homing latch movement
 	float zero_backoff;					// backoff from switches for machine zero
+	uint8_t homing_group;				// axes with the same group are homed together, lowest first
 } cfgAxis_t;
 
 typedef struct cmSingleton {			// struct to manage cm globals and cycles
@@ -216,7 +220,13 @@ typedef struct cmSingleton {			// struct to manage cm globals and cycles
 	// system group settings
 	float junction_acceleration;		// centripetal acceleration max for cornering
 	float chordal_tolerance;			// arc chordal accuracy setting in mm
+	float arc_acceleration;				// centripetal acceleration max for arcs
 	uint8_t soft_limit_enable;
+	float calibration_jerk_limit;		// calibration sweep ends at this multiple of $xjm
+	float calibration_velocity_limit;	// calibration sweep ends at this multiple of $xvm
+	uint8_t calibration_trials;			// number of calibration sweep trials
+	uint8_t probe_switch;				// switch used as the probe input (swNums)
+	uint8_t probe_report_enable;		// stream a compact record for each probe result
 
 	// hidden system settings
 	float min_segment_len;				// line drawing resolution in mm
@@ -247,6 +257,7 @@ typedef struct cmSingleton {			// struct to manage cm globals and cycles
 	uint8_t homed[AXES];				// individual axis homing flags
 
 	uint8_t probe_state;				// 1==success, 0==failed
+	uint32_t probe_linenum;				// line number of the probe that produced the results
 	float probe_results[AXES];			// probing results
 
 	uint8_t	g28_flag;					// true = complete a G28 move
@@ -363,6 +374,15 @@ enum cmProbeState {					// applies to cm.probe_state
 	PROBE_WAITING					// probe is waiting to be started
 };
 
+enum cmProbeType {						// G38.2 - G38.5, see cm_straight_probe()
+	PROBE_TOWARD_REPORTED = 0,			// G38.2 - probe toward workpiece, no contact is reported in prbe only
+	PROBE_TOWARD,						// G38.3 - probe toward workpiece, no error (runs as G38.2)
+	PROBE_AWAY_WITH_ERROR,				// G38.4 - probe away from workpiece, error if contact is not lost
+	PROBE_AWAY							// G38.5 - probe away from workpiece, no error
+};
+#define PROBE_NO_ERROR_BIT	0x01		// bits in cmProbeType - no error only changes G38.4
+#define PROBE_AWAY_BIT		0x02
+
 /* The difference between NextAction and MotionMode is that NextAction is
  * used by the current block, and may carry non-modal commands, whereas
  * MotionMode persists across blocks (as G modal group 1)
@@ -383,7 +403,10 @@ enum cmNextAction {						// these are in order to optimized CASE statement
 	NEXT_ACTION_SUSPEND_ORIGIN_OFFSETS,	// G92.2
 	NEXT_ACTION_RESUME_ORIGIN_OFFSETS,	// G92.3
 	NEXT_ACTION_DWELL,					// G4
-	NEXT_ACTION_STRAIGHT_PROBE			// G38.2
+	NEXT_ACTION_STRAIGHT_PROBE,			// G38.2
+	NEXT_ACTION_STRAIGHT_PROBE_NO_ERROR,// G38.3
+	NEXT_ACTION_STRAIGHT_PROBE_AWAY,	// G38.4
+	NEXT_ACTION_STRAIGHT_PROBE_AWAY_NO_ERROR // G38.5
 };
 
 enum cmMotionMode {						// G Modal Group 1
@@ -623,6 +646,10 @@ stat_t cm_traverse_override_enable(uint8_t flag); 				// M50.2
 stat_t cm_traverse_override_factor(uint8_t flag);				// M50.3
 stat_t cm_spindle_override_enable(uint8_t flag); 				// M51
 stat_t cm_spindle_override_factor(uint8_t flag);				// M51.1
+void cm_adjust_feed_override(uint8_t reset, int8_t steps);		// realtime feed override
+float cm_apply_feed_override(const float time);					// scale a feed time by the override
+void cm_adjust_spindle_override(uint8_t reset, int8_t steps);	// realtime spindle override (see spindle.c)
+float cm_step_override_factor(float factor, uint8_t reset, int8_t steps);
 
 void cm_message(char_t *message);								// msg to console (e.g. Gcode comments)
 
@@ -647,15 +674,20 @@ void cm_program_end(void);										// M2
 stat_t cm_homing_cycle_start(void);								// G28.2
 stat_t cm_homing_cycle_start_no_set(void);						// G28.4
 stat_t cm_homing_callback(void);								// G28.2/.4 main loop callback
+uint8_t cm_homing_switch_latch(uint8_t sw_num);					// group latch and squaring hook for the switch ISR
+stat_t cm_calibration_cycle_start(uint8_t axis);				// {"calx":1} - runs in the homing callback
 
 // Probe cycles
-stat_t cm_straight_probe(float target[], float flags[]);		// G38.2
-stat_t cm_probe_callback(void);									// G38.2 main loop callback
+stat_t cm_straight_probe(float target[], float flags[], uint8_t type);	// G38.2 - G38.5
+stat_t cm_probe_callback(void);									// G38.x main loop callback
+stat_t cm_set_prbs(nvObj_t *nv);								// set the probe input switch
+stat_t cm_probe_grid_start(void);								// {"hmpr":1} - height map grid probing
 
 // Jogging cycle
 stat_t cm_jogging_callback(void);								// jogging cycle main loop
 stat_t cm_jogging_cycle_start(uint8_t axis);					// {"jogx":-100.3}
 float cm_get_jogging_dest(void);
+void cm_request_jogging_cancel(void);							// realtime jog cancel
 
 /*--- cfgArray interface functions ---*/
 
@@ -687,6 +719,8 @@ stat_t cm_get_ofs(nvObj_t *nv);			// get runtime work offset...
 
 stat_t cm_run_qf(nvObj_t *nv);			// run queue flush
 stat_t cm_run_home(nvObj_t *nv);		// start homing cycle
+stat_t cm_run_cal(nvObj_t *nv);			// start step loss calibration cycle
+stat_t cm_run_hmp(nvObj_t *nv);			// start height map grid probing cycle
 
 stat_t cm_dam(nvObj_t *nv);				// dump active model (debugging command)
 
@@ -735,6 +769,12 @@ stat_t cm_set_xjh(nvObj_t *nv);			// set jerk homing with 1,000,000 correction
 
 	void cm_print_ja(nvObj_t *nv);		// global CM settings
 	void cm_print_ct(nvObj_t *nv);
+	void cm_print_ca(nvObj_t *nv);
+	void cm_print_cjl(nvObj_t *nv);
+	void cm_print_cvl(nvObj_t *nv);
+	void cm_print_ctr(nvObj_t *nv);
+	void cm_print_prbs(nvObj_t *nv);
+	void cm_print_prbr(nvObj_t *nv);
 	void cm_print_sl(nvObj_t *nv);
 	void cm_print_ml(nvObj_t *nv);
 	void cm_print_ma(nvObj_t *nv);
@@ -756,6 +796,7 @@ stat_t cm_set_xjh(nvObj_t *nv);			// set jerk homing with 1,000,000 correction
 	void cm_print_lv(nvObj_t *nv);
 	void cm_print_lb(nvObj_t *nv);
 	void cm_print_zb(nvObj_t *nv);
+	void cm_print_hg(nvObj_t *nv);
 	void cm_print_cofs(nvObj_t *nv);
 	void cm_print_cpos(nvObj_t *nv);
 
@@ -792,6 +833,12 @@ stat_t cm_set_xjh(nvObj_t *nv);			// set jerk homing with 1,000,000 correction
 
 	#define cm_print_ja tx_print_stub		// global CM settings
 	#define cm_print_ct tx_print_stub
+	#define cm_print_ca tx_print_stub
+	#define cm_print_cjl tx_print_stub
+	#define cm_print_cvl tx_print_stub
+	#define cm_print_ctr tx_print_stub
+	#define cm_print_prbs tx_print_stub
+	#define cm_print_prbr tx_print_stub
 	#define cm_print_sl tx_print_stub
 	#define cm_print_ml tx_print_stub
 	#define cm_print_ma tx_print_stub
@@ -813,6 +860,7 @@ stat_t cm_set_xjh(nvObj_t *nv);			// set jerk homing with 1,000,000 correction
 	#define cm_print_lv tx_print_stub
 	#define cm_print_lb tx_print_stub
 	#define cm_print_zb tx_print_stub
+	#define cm_print_hg tx_print_stub
 	#define cm_print_cofs tx_print_stub
 	#define cm_print_cpos tx_print_stub
 
@@ -152,6 +152,7 @@ void config_init()
 static void _set_defa(nvObj_t *nv)
 {
 	cm_set_units_mode(MILLIMETERS);				// must do inits in MM mode
+	nvm_reset_log();							// logged values are rewritten below
 	for (nv->index=0; nv_index_is_single(nv->index); nv->index++) {
 		if (GET_TABLE_BYTE(flags) & F_INITIALIZE) {
 			nv->value = GET_TABLE_FLOAT(def_value);
@@ -160,6 +161,7 @@ static void _set_defa(nvObj_t *nv)
 			nv_persist(nv);
 		}
 	}
+	nvm_flush();
 	sr_init_status_report();					// reset status reports
 	rpt_print_initializing_message();			// don't start TX until all the NVM persistence is done
 }
@@ -189,7 +189,7 @@ typedef uint16_t index_t;				// use this if there are > 255 indexed objects
 
 #define GROUP_LEN 3						// max length of group prefix
 #define TOKEN_LEN 5						// mnemonic token string: group prefix + short token
-#define NV_FOOTER_LEN 18				// sufficient space to contain a JSON footer array
+#define NV_FOOTER_LEN 28				// sufficient space to contain a JSON footer array (with credits)
 #define NV_LIST_LEN (NV_BODY_LEN+2)		// +2 allows for a header and a footer
 #define NV_MAX_OBJECTS (NV_BODY_LEN-1)	// maximum number of objects in a body string
 #define NO_MATCH (index_t)0xFFFF
@@ -205,7 +205,8 @@ enum tgCommunicationsMode {
 enum flowControl {
 	FLOW_CONTROL_OFF = 0,				// flow control disabled
 	FLOW_CONTROL_XON,					// flow control uses XON/XOFF
-	FLOW_CONTROL_RTS					// flow control uses RTS/CTS
+	FLOW_CONTROL_RTS,					// flow control uses RTS/CTS
+	FLOW_CONTROL_CREDIT					// host streams against RX credits reported in footers
 };
 
 /*
@@ -240,6 +241,7 @@ enum valueType {						// value typing for config and JSON
 #define F_PERSIST 		0x02			// persist this item when set is run
 #define F_NOSTRIP		0x04			// do not strip the group prefix from the token
 #define F_CONVERT		0x08			// set if unit conversion is required
+#define F_LOG			0x10			// frequently written - persist through the NVM log (see persistence.c)
 
 #define _f0				0x00
 #define _fi				(F_INITIALIZE)
@@ -250,6 +252,7 @@ enum valueType {						// value typing for config and JSON
 #define _fipc			(F_INITIALIZE | F_PERSIST | F_CONVERT)
 #define _fipn			(F_INITIALIZE | F_PERSIST | F_NOSTRIP)
 #define _fipnc			(F_INITIALIZE | F_PERSIST | F_NOSTRIP | F_CONVERT)
+#define _fipcl			(F_INITIALIZE | F_PERSIST | F_CONVERT | F_LOG)
 
 /**** Structures ****/
 
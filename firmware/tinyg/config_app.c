@@ -39,9 +39,12 @@
 #include "pwm.h"
 #include "report.h"
 #include "hardware.h"
+#include "kinematics.h"
+#include "encoder.h"
 #include "test.h"
 #include "util.h"
 #include "help.h"
+#include "persistence.h"
 #include "network.h"
 #include "xio.h"
 
@@ -157,7 +160,27 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "hom","homb",_f0, 0, cm_print_pos, get_ui8, set_nul,(float *)&cm.homed[AXIS_B], false },	// B homed
 	{ "hom","homc",_f0, 0, cm_print_pos, get_ui8, set_nul,(float *)&cm.homed[AXIS_C], false },	// C homed
 
+	{ "cal","calx",_f0, 0, tx_print_nul, get_nul, cm_run_cal,(float *)&cs.null, 0 },			// run step loss calibration on X
+	{ "cal","caly",_f0, 0, tx_print_nul, get_nul, cm_run_cal,(float *)&cs.null, 0 },
+	{ "cal","calz",_f0, 0, tx_print_nul, get_nul, cm_run_cal,(float *)&cs.null, 0 },
+	{ "cal","cala",_f0, 0, tx_print_nul, get_nul, cm_run_cal,(float *)&cs.null, 0 },
+
+	// Height map grid probing and Z compensation
+	{ "hmp","hmpx",_fipc,3, kin_print_hmpx, get_flt, kin_set_hmp, (float *)&kin.map.origin_x,	HEIGHT_MAP_ORIGIN_X },
+	{ "hmp","hmpy",_fipc,3, kin_print_hmpy, get_flt, kin_set_hmp, (float *)&kin.map.origin_y,	HEIGHT_MAP_ORIGIN_Y },
+	{ "hmp","hmpi",_fipc,3, kin_print_hmpi, get_flt, kin_set_hmp, (float *)&kin.map.spacing_x,	HEIGHT_MAP_SPACING_X },
+	{ "hmp","hmpj",_fipc,3, kin_print_hmpj, get_flt, kin_set_hmp, (float *)&kin.map.spacing_y,	HEIGHT_MAP_SPACING_Y },
+	{ "hmp","hmpn",_fip, 0, kin_print_hmpn, get_ui8, kin_set_hmpn,(float *)&kin.map.columns,	HEIGHT_MAP_COLUMNS },
+	{ "hmp","hmpm",_fip, 0, kin_print_hmpm, get_ui8, kin_set_hmpn,(float *)&kin.map.rows,		HEIGHT_MAP_ROWS },
+	{ "hmp","hmpd",_fipc,3, kin_print_hmpd, get_flt, set_flu,     (float *)&kin.map.probe_depth,HEIGHT_MAP_PROBE_DEPTH },
+	{ "hmp","hmph",_fipc,3, kin_print_hmph, get_flt, set_flu,     (float *)&kin.map.clearance,	HEIGHT_MAP_CLEARANCE },
+	{ "hmp","hmpf",_fipc,0, kin_print_hmpf, get_flt, set_flu,     (float *)&kin.map.feed_rate,	HEIGHT_MAP_FEED_RATE },
+	{ "hmp","hmpe",_f0,  0, kin_print_hmpe, get_ui8, kin_set_hmpe,(float *)&kin.map.enable,		0 },	// Z compensation on/off
+	{ "hmp","hmpv",_f0,  0, kin_print_hmpv, get_ui8, set_nul,     (float *)&kin.map.points,		0 },	// points probed
+	{ "hmp","hmpr",_f0,  0, tx_print_nul,   get_nul, cm_run_hmp,  (float *)&cs.null,			0 },	// run grid probing
+
 	{ "prb","prbe",_f0, 0, tx_print_nul, get_ui8, set_nul,(float *)&cm.probe_state, 0 },		// probing state
+	{ "prb","prbn",_f0, 0, tx_print_nul, get_int, set_nul,(float *)&cm.probe_linenum, 0 },	// line number of the probe
 	{ "prb","prbx",_f0, 3, tx_print_nul, get_flt, set_nul,(float *)&cm.probe_results[AXIS_X], 0 },
 	{ "prb","prby",_f0, 3, tx_print_nul, get_flt, set_nul,(float *)&cm.probe_results[AXIS_Y], 0 },
 	{ "prb","prbz",_f0, 3, tx_print_nul, get_flt, set_nul,(float *)&cm.probe_results[AXIS_Z], 0 },
@@ -183,6 +206,28 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "pwr","pwr6",_f0, 0, st_print_pwr, st_get_pwr, set_nul, (float *)&cs.null, 0},
 #endif
 
+	{ "fer","fer1",_f0, 2, en_print_fer, en_get_fer, set_nul, (float *)&cs.null, 0},	// RMS following error (steps)
+	{ "fer","fer2",_f0, 2, en_print_fer, en_get_fer, set_nul, (float *)&cs.null, 0},
+	{ "fer","fer3",_f0, 2, en_print_fer, en_get_fer, set_nul, (float *)&cs.null, 0},
+	{ "fer","fer4",_f0, 2, en_print_fer, en_get_fer, set_nul, (float *)&cs.null, 0},
+#if (MOTORS >= 5)
+	{ "fer","fer5",_f0, 2, en_print_fer, en_get_fer, set_nul, (float *)&cs.null, 0},
+#endif
+#if (MOTORS >= 6)
+	{ "fer","fer6",_f0, 2, en_print_fer, en_get_fer, set_nul, (float *)&cs.null, 0},
+#endif
+
+	{ "fep","fep1",_f0, 2, en_print_fep, en_get_fep, set_nul, (float *)&cs.null, 0},	// peak following error (steps)
+	{ "fep","fep2",_f0, 2, en_print_fep, en_get_fep, set_nul, (float *)&cs.null, 0},
+	{ "fep","fep3",_f0, 2, en_print_fep, en_get_fep, set_nul, (float *)&cs.null, 0},
+	{ "fep","fep4",_f0, 2, en_print_fep, en_get_fep, set_nul, (float *)&cs.null, 0},
+#if (MOTORS >= 5)
+	{ "fep","fep5",_f0, 2, en_print_fep, en_get_fep, set_nul, (float *)&cs.null, 0},
+#endif
+#if (MOTORS >= 6)
+	{ "fep","fep6",_f0, 2, en_print_fep, en_get_fep, set_nul, (float *)&cs.null, 0},
+#endif
+
 	// Reports, tests, help, and messages
 	{ "", "sr",  _f0, 0, sr_print_sr,  sr_get,  sr_set,   (float *)&cs.null, 0 },	// status report object
 	{ "", "qr",  _f0, 0, qr_print_qr,  qr_get,  set_nul,  (float *)&cs.null, 0 },	// queue report - planner buffers available
@@ -198,6 +243,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 
 	{ "", "test",_f0, 0, tx_print_nul, help_test, run_test, (float *)&cs.null,0 },	// run tests, print test help screen
 	{ "", "defa",_f0, 0, tx_print_nul, help_defa, set_defaults,(float *)&cs.null,0 },	// set/print defaults / help screen
+	{ "", "snap",_f0, 0, tx_print_nul, nvm_print_snapshot, set_nul,(float *)&cs.null,0 },	// print config snapshot
 	{ "", "boot",_f0, 0, tx_print_nul, help_boot_loader,hw_run_boot, (float *)&cs.null,0 },
 
 #ifdef __HELP_SCREENS
@@ -206,66 +252,78 @@ const cfgItem_t cfgArray[] PROGMEM = {
 #endif
 
 	// Motor parameters
-	{ "1","1ma",_fip, 0, st_print_ma, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_1].motor_map,	M1_MOTOR_MAP },
+	{ "1","1ma",_fip, 0, st_print_ma, get_ui8, st_set_ma, (float *)&st_cfg.mot[MOTOR_1].motor_map,	M1_MOTOR_MAP },
 	{ "1","1sa",_fip, 3, st_print_sa, get_flt, st_set_sa, (float *)&st_cfg.mot[MOTOR_1].step_angle,	M1_STEP_ANGLE },
 	{ "1","1tr",_fipc,4, st_print_tr, get_flt, st_set_tr, (float *)&st_cfg.mot[MOTOR_1].travel_rev,	M1_TRAVEL_PER_REV },
 	{ "1","1mi",_fip, 0, st_print_mi, get_ui8, st_set_mi, (float *)&st_cfg.mot[MOTOR_1].microsteps,	M1_MICROSTEPS },
 	{ "1","1po",_fip, 0, st_print_po, get_ui8, set_01,    (float *)&st_cfg.mot[MOTOR_1].polarity,	M1_POLARITY },
 	{ "1","1pm",_fip, 0, st_print_pm, get_ui8, st_set_pm, (float *)&st_cfg.mot[MOTOR_1].power_mode,	M1_POWER_MODE },
+	{ "1","1hs",_fip, 0, st_print_hs, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_1].homing_switch,	M1_HOMING_SWITCH },
+	{ "1","1so",_fipc,3, st_print_so, get_flt, set_flu,   (float *)&st_cfg.mot[MOTOR_1].squaring_offset,M1_SQUARING_OFFSET },
 #ifdef __ARM
 	{ "1","1pl",_fip, 3, st_print_pl, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_1].power_level,M1_POWER_LEVEL },
 #endif
 #if (MOTORS >= 2)
-	{ "2","2ma",_fip, 0, st_print_ma, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_2].motor_map,	M2_MOTOR_MAP },
+	{ "2","2ma",_fip, 0, st_print_ma, get_ui8, st_set_ma, (float *)&st_cfg.mot[MOTOR_2].motor_map,	M2_MOTOR_MAP },
 	{ "2","2sa",_fip, 3, st_print_sa, get_flt, st_set_sa, (float *)&st_cfg.mot[MOTOR_2].step_angle,	M2_STEP_ANGLE },
 	{ "2","2tr",_fipc,4, st_print_tr, get_flt, st_set_tr, (float *)&st_cfg.mot[MOTOR_2].travel_rev,	M2_TRAVEL_PER_REV },
 	{ "2","2mi",_fip, 0, st_print_mi, get_ui8, st_set_mi, (float *)&st_cfg.mot[MOTOR_2].microsteps,	M2_MICROSTEPS },
 	{ "2","2po",_fip, 0, st_print_po, get_ui8, set_01,    (float *)&st_cfg.mot[MOTOR_2].polarity,	M2_POLARITY },
 	{ "2","2pm",_fip, 0, st_print_pm, get_ui8, st_set_pm, (float *)&st_cfg.mot[MOTOR_2].power_mode,	M2_POWER_MODE },
+	{ "2","2hs",_fip, 0, st_print_hs, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_2].homing_switch,	M2_HOMING_SWITCH },
+	{ "2","2so",_fipc,3, st_print_so, get_flt, set_flu,   (float *)&st_cfg.mot[MOTOR_2].squaring_offset,M2_SQUARING_OFFSET },
 #ifdef __ARM
 	{ "2","2pl",_fip, 3, st_print_pl, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_2].power_level,M2_POWER_LEVEL},
 #endif
 #endif
 #if (MOTORS >= 3)
-	{ "3","3ma",_fip, 0, st_print_ma, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_3].motor_map,	M3_MOTOR_MAP },
+	{ "3","3ma",_fip, 0, st_print_ma, get_ui8, st_set_ma, (float *)&st_cfg.mot[MOTOR_3].motor_map,	M3_MOTOR_MAP },
 	{ "3","3sa",_fip, 3, st_print_sa, get_flt, st_set_sa, (float *)&st_cfg.mot[MOTOR_3].step_angle,	M3_STEP_ANGLE },
 	{ "3","3tr",_fipc,4, st_print_tr, get_flt, st_set_tr, (float *)&st_cfg.mot[MOTOR_3].travel_rev,	M3_TRAVEL_PER_REV },
 	{ "3","3mi",_fip, 0, st_print_mi, get_ui8, st_set_mi, (float *)&st_cfg.mot[MOTOR_3].microsteps,	M3_MICROSTEPS },
 	{ "3","3po",_fip, 0, st_print_po, get_ui8, set_01,    (float *)&st_cfg.mot[MOTOR_3].polarity,	M3_POLARITY },
 	{ "3","3pm",_fip, 0, st_print_pm, get_ui8, st_set_pm, (float *)&st_cfg.mot[MOTOR_3].power_mode,	M3_POWER_MODE },
+	{ "3","3hs",_fip, 0, st_print_hs, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_3].homing_switch,	M3_HOMING_SWITCH },
+	{ "3","3so",_fipc,3, st_print_so, get_flt, set_flu,   (float *)&st_cfg.mot[MOTOR_3].squaring_offset,M3_SQUARING_OFFSET },
 #ifdef __ARM
 	{ "3","3pl",_fip, 3, st_print_pl, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_3].power_level,M3_POWER_LEVEL },
 #endif
 #endif
 #if (MOTORS >= 4)
-	{ "4","4ma",_fip, 0, st_print_ma, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_4].motor_map,	M4_MOTOR_MAP },
+	{ "4","4ma",_fip, 0, st_print_ma, get_ui8, st_set_ma, (float *)&st_cfg.mot[MOTOR_4].motor_map,	M4_MOTOR_MAP },
 	{ "4","4sa",_fip, 3, st_print_sa, get_flt, st_set_sa, (float *)&st_cfg.mot[MOTOR_4].step_angle,	M4_STEP_ANGLE },
 	{ "4","4tr",_fipc,4, st_print_tr, get_flt, st_set_tr, (float *)&st_cfg.mot[MOTOR_4].travel_rev,	M4_TRAVEL_PER_REV },
 	{ "4","4mi",_fip, 0, st_print_mi, get_ui8, st_set_mi, (float *)&st_cfg.mot[MOTOR_4].microsteps,	M4_MICROSTEPS },
 	{ "4","4po",_fip, 0, st_print_po, get_ui8, set_01,    (float *)&st_cfg.mot[MOTOR_4].polarity,	M4_POLARITY },
 	{ "4","4pm",_fip, 0, st_print_pm, get_ui8, st_set_pm, (float *)&st_cfg.mot[MOTOR_4].power_mode,	M4_POWER_MODE },
+	{ "4","4hs",_fip, 0, st_print_hs, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_4].homing_switch,	M4_HOMING_SWITCH },
+	{ "4","4so",_fipc,3, st_print_so, get_flt, set_flu,   (float *)&st_cfg.mot[MOTOR_4].squaring_offset,M4_SQUARING_OFFSET },
 #ifdef __ARM
 	{ "4","4pl",_fip, 3, st_print_pl, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_4].power_level,M4_POWER_LEVEL },
 #endif
 #endif
 #if (MOTORS >= 5)
-	{ "5","5ma",_fip, 0, st_print_ma, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_5].motor_map,	M5_MOTOR_MAP },
+	{ "5","5ma",_fip, 0, st_print_ma, get_ui8, st_set_ma, (float *)&st_cfg.mot[MOTOR_5].motor_map,	M5_MOTOR_MAP },
 	{ "5","5sa",_fip, 3, st_print_sa, get_flt, st_set_sa, (float *)&st_cfg.mot[MOTOR_5].step_angle,	M5_STEP_ANGLE },
 	{ "5","5tr",_fipc,4, st_print_tr, get_flt, st_set_tr, (float *)&st_cfg.mot[MOTOR_5].travel_rev,	M5_TRAVEL_PER_REV },
 	{ "5","5mi",_fip, 0, st_print_mi, get_ui8, st_set_mi, (float *)&st_cfg.mot[MOTOR_5].microsteps,	M5_MICROSTEPS },
 	{ "5","5po",_fip, 0, st_print_po, get_ui8, set_01,    (float *)&st_cfg.mot[MOTOR_5].polarity,	M5_POLARITY },
 	{ "5","5pm",_fip, 0, st_print_pm, get_ui8, st_set_pm, (float *)&st_cfg.mot[MOTOR_5].power_mode,	M5_POWER_MODE },
+	{ "5","5hs",_fip, 0, st_print_hs, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_5].homing_switch,	M5_HOMING_SWITCH },
+	{ "5","5so",_fipc,3, st_print_so, get_flt, set_flu,   (float *)&st_cfg.mot[MOTOR_5].squaring_offset,M5_SQUARING_OFFSET },
 #ifdef __ARM
 	{ "5","5pl",_fip, 3, st_print_pl, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_5].power_level,M5_POWER_LEVEL },
 #endif
 #endif
 #if (MOTORS >= 6)
-	{ "6","6ma",_fip, 0, st_print_ma, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_6].motor_map,	M6_MOTOR_MAP },
+	{ "6","6ma",_fip, 0, st_print_ma, get_ui8, st_set_ma, (float *)&st_cfg.mot[MOTOR_6].motor_map,	M6_MOTOR_MAP },
 	{ "6","6sa",_fip, 3, st_print_sa, get_flt, st_set_sa, (float *)&st_cfg.mot[MOTOR_6].step_angle,	M6_STEP_ANGLE },
 	{ "6","6tr",_fipc,4, st_print_tr, get_flt, st_set_tr, (float *)&st_cfg.mot[MOTOR_6].travel_rev,	M6_TRAVEL_PER_REV },
 	{ "6","6mi",_fip, 0, st_print_mi, get_ui8, st_set_mi, (float *)&st_cfg.mot[MOTOR_6].microsteps,	M6_MICROSTEPS },
 	{ "6","6po",_fip, 0, st_print_po, get_ui8, set_01,    (float *)&st_cfg.mot[MOTOR_6].polarity,	M6_POLARITY },
 	{ "6","6pm",_fip, 0, st_print_pm, get_ui8, st_set_pm, (float *)&st_cfg.mot[MOTOR_6].power_mode,	M6_POWER_MODE },
+	{ "6","6hs",_fip, 0, st_print_hs, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_6].homing_switch,	M6_HOMING_SWITCH },
+	{ "6","6so",_fipc,3, st_print_so, get_flt, set_flu,   (float *)&st_cfg.mot[MOTOR_6].squaring_offset,M6_SQUARING_OFFSET },
 #ifdef __ARM
 	{ "6","6pl",_fip, 3, st_print_pl, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_6].power_level,M6_POWER_LEVEL },
 #endif
@@ -287,6 +345,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "x","xlv",_fipc, 0, cm_print_lv, get_flt,   set_flu,   (float *)&cm.a[AXIS_X].latch_velocity,	X_LATCH_VELOCITY },
 	{ "x","xlb",_fipc, 3, cm_print_lb, get_flt,   set_flu,   (float *)&cm.a[AXIS_X].latch_backoff,	X_LATCH_BACKOFF },
 	{ "x","xzb",_fipc, 3, cm_print_zb, get_flt,   set_flu,   (float *)&cm.a[AXIS_X].zero_backoff,	X_ZERO_BACKOFF },
+	{ "x","xhg",_fip,  0, cm_print_hg, get_ui8,   set_ui8,   (float *)&cm.a[AXIS_X].homing_group,	X_HOMING_GROUP },
 
 	{ "y","yam",_fip,  0, cm_print_am, cm_get_am, cm_set_am, (float *)&cm.a[AXIS_Y].axis_mode,		Y_AXIS_MODE },
 	{ "y","yvm",_fipc, 0, cm_print_vm, get_flt,   set_flu,   (float *)&cm.a[AXIS_Y].velocity_max,	Y_VELOCITY_MAX },
@@ -304,6 +363,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "y","ylv",_fipc, 0, cm_print_lv, get_flt,   set_flu,   (float *)&cm.a[AXIS_Y].latch_velocity,	Y_LATCH_VELOCITY },
 	{ "y","ylb",_fipc, 3, cm_print_lb, get_flt,   set_flu,   (float *)&cm.a[AXIS_Y].latch_backoff,	Y_LATCH_BACKOFF },
 	{ "y","yzb",_fipc, 3, cm_print_zb, get_flt,   set_flu,   (float *)&cm.a[AXIS_Y].zero_backoff,	Y_ZERO_BACKOFF },
+	{ "y","yhg",_fip,  0, cm_print_hg, get_ui8,   set_ui8,   (float *)&cm.a[AXIS_Y].homing_group,	Y_HOMING_GROUP },
 
 	{ "z","zam",_fip,  0, cm_print_am, cm_get_am, cm_set_am, (float *)&cm.a[AXIS_Z].axis_mode,		Z_AXIS_MODE },
 	{ "z","zvm",_fipc, 0, cm_print_vm, get_flt,   set_flu,   (float *)&cm.a[AXIS_Z].velocity_max,	Z_VELOCITY_MAX },
@@ -321,6 +381,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "z","zlv",_fipc, 0, cm_print_lv, get_flt,   set_flu,   (float *)&cm.a[AXIS_Z].latch_velocity,	Z_LATCH_VELOCITY },
 	{ "z","zlb",_fipc, 3, cm_print_lb, get_flt,   set_flu,   (float *)&cm.a[AXIS_Z].latch_backoff,	Z_LATCH_BACKOFF },
 	{ "z","zzb",_fipc, 3, cm_print_zb, get_flt,   set_flu,   (float *)&cm.a[AXIS_Z].zero_backoff,	Z_ZERO_BACKOFF },
+	{ "z","zhg",_fip,  0, cm_print_hg, get_ui8,   set_ui8,   (float *)&cm.a[AXIS_Z].homing_group,	Z_HOMING_GROUP },
 
 	{ "a","aam",_fip,  0, cm_print_am, cm_get_am, cm_set_am, (float *)&cm.a[AXIS_A].axis_mode,		A_AXIS_MODE },
 	{ "a","avm",_fip,  0, cm_print_vm, get_flt,   set_flt,   (float *)&cm.a[AXIS_A].velocity_max,	A_VELOCITY_MAX },
@@ -339,6 +400,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "a","alv",_fip,  0, cm_print_lv, get_flt,   set_flt,   (float *)&cm.a[AXIS_A].latch_velocity,	A_LATCH_VELOCITY },
 	{ "a","alb",_fip,  3, cm_print_lb, get_flt,   set_flt,   (float *)&cm.a[AXIS_A].latch_backoff,	A_LATCH_BACKOFF },
 	{ "a","azb",_fip,  3, cm_print_zb, get_flt,   set_flt,   (float *)&cm.a[AXIS_A].zero_backoff,	A_ZERO_BACKOFF },
+	{ "a","ahg",_fip,  0, cm_print_hg, get_ui8,   set_ui8,   (float *)&cm.a[AXIS_A].homing_group,	A_HOMING_GROUP },
 
 	{ "b","bam",_fip,  0, cm_print_am, cm_get_am, cm_set_am, (float *)&cm.a[AXIS_B].axis_mode,		B_AXIS_MODE },
 	{ "b","bvm",_fip,  0, cm_print_vm, get_flt,   set_flt,   (float *)&cm.a[AXIS_B].velocity_max,	B_VELOCITY_MAX },
@@ -389,47 +451,47 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "p1","p1pof",_fip, 3, pwm_print_p1pof, get_flt, set_flt,(float *)&pwm.c[PWM_1].phase_off,		P1_PWM_PHASE_OFF },
 
 	// Coordinate system offsets (G54-G59 and G92)
-	{ "g54","g54x",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G54][AXIS_X], G54_X_OFFSET },
-	{ "g54","g54y",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G54][AXIS_Y], G54_Y_OFFSET },
-	{ "g54","g54z",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G54][AXIS_Z], G54_Z_OFFSET },
-	{ "g54","g54a",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G54][AXIS_A], G54_A_OFFSET },
-	{ "g54","g54b",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G54][AXIS_B], G54_B_OFFSET },
-	{ "g54","g54c",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G54][AXIS_C], G54_C_OFFSET },
-
-	{ "g55","g55x",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G55][AXIS_X], G55_X_OFFSET },
-	{ "g55","g55y",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G55][AXIS_Y], G55_Y_OFFSET },
-	{ "g55","g55z",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G55][AXIS_Z], G55_Z_OFFSET },
-	{ "g55","g55a",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G55][AXIS_A], G55_A_OFFSET },
-	{ "g55","g55b",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G55][AXIS_B], G55_B_OFFSET },
-	{ "g55","g55c",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G55][AXIS_C], G55_C_OFFSET },
-
-	{ "g56","g56x",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G56][AXIS_X], G56_X_OFFSET },
-	{ "g56","g56y",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G56][AXIS_Y], G56_Y_OFFSET },
-	{ "g56","g56z",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G56][AXIS_Z], G56_Z_OFFSET },
-	{ "g56","g56a",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G56][AXIS_A], G56_A_OFFSET },
-	{ "g56","g56b",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G56][AXIS_B], G56_B_OFFSET },
-	{ "g56","g56c",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G56][AXIS_C], G56_C_OFFSET },
-
-	{ "g57","g57x",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G57][AXIS_X], G57_X_OFFSET },
-	{ "g57","g57y",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G57][AXIS_Y], G57_Y_OFFSET },
-	{ "g57","g57z",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G57][AXIS_Z], G57_Z_OFFSET },
-	{ "g57","g57a",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G57][AXIS_A], G57_A_OFFSET },
-	{ "g57","g57b",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G57][AXIS_B], G57_B_OFFSET },
-	{ "g57","g57c",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G57][AXIS_C], G57_C_OFFSET },
-
-	{ "g58","g58x",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G58][AXIS_X], G58_X_OFFSET },
-	{ "g58","g58y",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G58][AXIS_Y], G58_Y_OFFSET },
-	{ "g58","g58z",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G58][AXIS_Z], G58_Z_OFFSET },
-	{ "g58","g58a",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G58][AXIS_A], G58_A_OFFSET },
-	{ "g58","g58b",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G58][AXIS_B], G58_B_OFFSET },
-	{ "g58","g58c",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G58][AXIS_C], G58_C_OFFSET },
-
-	{ "g59","g59x",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G59][AXIS_X], G59_X_OFFSET },
-	{ "g59","g59y",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G59][AXIS_Y], G59_Y_OFFSET },
-	{ "g59","g59z",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G59][AXIS_Z], G59_Z_OFFSET },
-	{ "g59","g59a",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G59][AXIS_A], G59_A_OFFSET },
-	{ "g59","g59b",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G59][AXIS_B], G59_B_OFFSET },
-	{ "g59","g59c",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G59][AXIS_C], G59_C_OFFSET },
+	{ "g54","g54x",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G54][AXIS_X], G54_X_OFFSET },
+	{ "g54","g54y",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G54][AXIS_Y], G54_Y_OFFSET },
+	{ "g54","g54z",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G54][AXIS_Z], G54_Z_OFFSET },
+	{ "g54","g54a",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G54][AXIS_A], G54_A_OFFSET },
+	{ "g54","g54b",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G54][AXIS_B], G54_B_OFFSET },
+	{ "g54","g54c",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G54][AXIS_C], G54_C_OFFSET },
+
+	{ "g55","g55x",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G55][AXIS_X], G55_X_OFFSET },
+	{ "g55","g55y",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G55][AXIS_Y], G55_Y_OFFSET },
+	{ "g55","g55z",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G55][AXIS_Z], G55_Z_OFFSET },
+	{ "g55","g55a",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G55][AXIS_A], G55_A_OFFSET },
+	{ "g55","g55b",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G55][AXIS_B], G55_B_OFFSET },
+	{ "g55","g55c",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G55][AXIS_C], G55_C_OFFSET },
+
+	{ "g56","g56x",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G56][AXIS_X], G56_X_OFFSET },
+	{ "g56","g56y",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G56][AXIS_Y], G56_Y_OFFSET },
+	{ "g56","g56z",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G56][AXIS_Z], G56_Z_OFFSET },
+	{ "g56","g56a",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G56][AXIS_A], G56_A_OFFSET },
+	{ "g56","g56b",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G56][AXIS_B], G56_B_OFFSET },
+	{ "g56","g56c",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G56][AXIS_C], G56_C_OFFSET },
+
+	{ "g57","g57x",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G57][AXIS_X], G57_X_OFFSET },
+	{ "g57","g57y",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G57][AXIS_Y], G57_Y_OFFSET },
+	{ "g57","g57z",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G57][AXIS_Z], G57_Z_OFFSET },
+	{ "g57","g57a",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G57][AXIS_A], G57_A_OFFSET },
+	{ "g57","g57b",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G57][AXIS_B], G57_B_OFFSET },
+	{ "g57","g57c",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G57][AXIS_C], G57_C_OFFSET },
+
+	{ "g58","g58x",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G58][AXIS_X], G58_X_OFFSET },
+	{ "g58","g58y",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G58][AXIS_Y], G58_Y_OFFSET },
+	{ "g58","g58z",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G58][AXIS_Z], G58_Z_OFFSET },
+	{ "g58","g58a",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G58][AXIS_A], G58_A_OFFSET },
+	{ "g58","g58b",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G58][AXIS_B], G58_B_OFFSET },
+	{ "g58","g58c",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G58][AXIS_C], G58_C_OFFSET },
+
+	{ "g59","g59x",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G59][AXIS_X], G59_X_OFFSET },
+	{ "g59","g59y",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G59][AXIS_Y], G59_Y_OFFSET },
+	{ "g59","g59z",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G59][AXIS_Z], G59_Z_OFFSET },
+	{ "g59","g59a",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G59][AXIS_A], G59_A_OFFSET },
+	{ "g59","g59b",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G59][AXIS_B], G59_B_OFFSET },
+	{ "g59","g59c",_fipcl, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G59][AXIS_C], G59_C_OFFSET },
 
 	{ "g92","g92x",_fi, 3, cm_print_cofs, get_flt, set_nul,(float *)&cm.gmx.origin_offset[AXIS_X], 0 },// G92 handled differently
 	{ "g92","g92y",_fi, 3, cm_print_cofs, get_flt, set_nul,(float *)&cm.gmx.origin_offset[AXIS_Y], 0 },
@@ -462,6 +524,17 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	// System parameters
 	{ "sys","ja",  _fipnc,0, cm_print_ja,  get_flt,   set_flu,    (float *)&cm.junction_acceleration,JUNCTION_ACCELERATION },
 	{ "sys","ct",  _fipnc,4, cm_print_ct,  get_flt,   set_flu,    (float *)&cm.chordal_tolerance,	CHORDAL_TOLERANCE },
+	{ "sys","ca",  _fipnc,0, cm_print_ca,  get_flt,   set_flu,    (float *)&cm.arc_acceleration,	ARC_ACCELERATION },
+	{ "sys","kin", _fipn, 0, kin_print_kin,get_ui8,   kin_set_kin,(float *)&kin.type,				KINEMATICS },
+	{ "sys","dla", _fipnc,3, kin_print_dla,get_flt,   kin_set_delta,(float *)&kin.delta_arm_length,	DELTA_ARM_LENGTH },
+	{ "sys","dtr", _fipnc,3, kin_print_dtr,get_flt,   kin_set_delta,(float *)&kin.delta_radius,	DELTA_RADIUS },
+	{ "sys","fet", _fipn, 2, en_print_fet, get_flt,   set_flt,    (float *)&en.fe.threshold,		FOLLOWING_ERROR_THRESHOLD },
+	{ "sys","fen", _fipn, 0, en_print_fen, get_ui8,   en_set_fen, (float *)&en.fe.segments,			FOLLOWING_ERROR_SEGMENTS },
+	{ "sys","cjl", _fipn, 2, cm_print_cjl, get_flt,   set_flt,    (float *)&cm.calibration_jerk_limit,	CALIBRATION_JERK_LIMIT },
+	{ "sys","cvl", _fipn, 2, cm_print_cvl, get_flt,   set_flt,    (float *)&cm.calibration_velocity_limit,CALIBRATION_VELOCITY_LIMIT },
+	{ "sys","ctr", _fipn, 0, cm_print_ctr, get_ui8,   set_ui8,    (float *)&cm.calibration_trials,		CALIBRATION_TRIALS },
+	{ "sys","prbs",_fipn, 0, cm_print_prbs,get_ui8,   cm_set_prbs,(float *)&cm.probe_switch,		PROBE_SWITCH },
+	{ "sys","prbr",_fipn, 0, cm_print_prbr,get_ui8,   set_01,     (float *)&cm.probe_report_enable,	PROBE_REPORT_ENABLE },
 	{ "sys","sl",  _fipn, 0, cm_print_sl,  get_ui8,   set_ui8,    (float *)&cm.soft_limit_enable,	SOFT_LIMIT_ENABLE },
 	{ "sys","st",  _fipn, 0, sw_print_st,  get_ui8,   sw_set_st,  (float *)&sw.switch_type,			SWITCH_TYPE },
 	{ "sys","mt",  _fipn, 2, st_print_mt,  get_flt,   st_set_mt,  (float *)&st_cfg.motor_power_timeout,MOTOR_IDLE_TIMEOUT},
@@ -471,6 +544,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "sys","ej",  _fipn, 0, js_print_ej,  get_ui8,   set_01,     (float *)&cfg.comm_mode,			COMM_MODE },
 	{ "sys","jv",  _fipn, 0, js_print_jv,  get_ui8,   json_set_jv,(float *)&js.json_verbosity,		JSON_VERBOSITY },
 	{ "sys","js",  _fipn, 0, js_print_js,  get_ui8,   set_01,     (float *)&js.json_syntax, 		JSON_SYNTAX_MODE },
+	{ "sys","jm",  _fipn, 0, js_print_jm,  get_ui8,   set_01,     (float *)&js.json_streaming,		JSON_PARSER_MODE },
 	{ "sys","tv",  _fipn, 0, tx_print_tv,  get_ui8,   set_01,     (float *)&txt.text_verbosity,		TEXT_VERBOSITY },
 	{ "sys","qv",  _fipn, 0, qr_print_qv,  get_ui8,   set_0123,   (float *)&qr.queue_report_verbosity,QUEUE_REPORT_VERBOSITY },
 	{ "sys","sv",  _fipn, 0, sr_print_sv,  get_ui8,   set_012,    (float *)&sr.status_report_verbosity,STATUS_REPORT_VERBOSITY },
@@ -480,6 +554,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "sys","ec",  _fipn, 0, cfg_print_ec,  get_ui8,   set_ec,     (float *)&cfg.enable_cr,			COM_EXPAND_CR },
 	{ "sys","ee",  _fipn, 0, cfg_print_ee,  get_ui8,   set_ee,     (float *)&cfg.enable_echo,		COM_ENABLE_ECHO },
 	{ "sys","ex",  _fipn, 0, cfg_print_ex,  get_ui8,   set_ex,     (float *)&cfg.enable_flow_control,COM_ENABLE_FLOW_CONTROL },
+	{ "sys","rxi", _fipn, 0, rx_print_rxi,  get_int,   set_int,    (float *)&rx.credit_report_interval,COM_CREDIT_REPORT_INTERVAL },
 	{ "sys","baud",_fn,   0, cfg_print_baud,get_ui8,   set_baud,   (float *)&cfg.usb_baud_rate,		XIO_BAUD_115200 },
 	{ "sys","net", _fipn, 0, cfg_print_net, get_ui8,   set_ui8,    (float *)&cs.network_mode,		NETWORK_MODE },
 
@@ -596,6 +671,11 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "",   "_dam",_f0, 0, tx_print_nul, cm_dam,  cm_dam, (float *)&cs.null, 0 },	// dump active model
 #endif	//  __DIAGNOSTIC_PARAMETERS
 
+#ifdef __DISPATCH_PROFILE
+	{ "", "dp",  _f0, 0, tx_print_nul, dp_get,  dp_set,  (float *)&cs.null, 0 },		// dispatch profile dump / clear
+	{ "", "dpb", _f0, 0, tx_print_int, get_int, set_int, (float *)&dp.budget_us, 0 },	// default dispatch budget in uSec (0=off)
+#endif
+
 	// Persistence for status report - must be in sequence
 	// *** Count must agree with NV_STATUS_REPORT_LEN in config.h ***
 	{ "","se00",_fp, 0, tx_print_nul, get_int, set_int,(float *)&sr.status_report_list[0],0 },
@@ -670,7 +750,10 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "","ofs",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// work offset group
 	{ "","hom",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// axis homing state group
 	{ "","prb",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// probing state group
+	{ "","hmp",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// height map group
 	{ "","pwr",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// motor power enagled group
+	{ "","fer",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// RMS following error group
+	{ "","fep",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// peak following error group
 	{ "","jog",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// axis jogging state group
 	{ "","jid",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// job ID group
 
@@ -701,7 +784,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 /***** Make sure these defines line up with any changes in the above table *****/
 
 #define NV_COUNT_UBER_GROUPS 	4 		// count of uber-groups, above
-#define STANDARD_GROUPS 		33		// count of standard groups, excluding diagnostic parameter groups
+#define STANDARD_GROUPS 		36		// count of standard groups, excluding diagnostic parameter groups
 
 #if (MOTORS >= 5)
 #define MOTOR_GROUP_5			1
@@ -858,7 +941,7 @@ static stat_t _do_all(nvObj_t *nv)	// print all parameters
 /**** COMMUNICATIONS FUNCTIONS ******************************************************
  * set_ec() - enable CRLF on TX
  * set_ee() - enable character echo
- * set_ex() - enable XON/XOFF or RTS/CTS flow control
+ * set_ex() - enable XON/XOFF, RTS/CTS or credit flow control
  * set_baud() - set USB baud rate
  * get_rx()	- get bytes available in RX buffer
  *
@@ -893,9 +976,12 @@ static stat_t set_ee(nvObj_t *nv) 				// enable character echo
 
 static stat_t set_ex(nvObj_t *nv)				// enable XON/XOFF or RTS/CTS flow control
 {
-	if (nv->value > FLOW_CONTROL_RTS)
+	if (nv->value > FLOW_CONTROL_CREDIT)
         return (STAT_INPUT_VALUE_RANGE_ERROR);
 	cfg.enable_flow_control = (uint8_t)nv->value;
+	if (cfg.enable_flow_control == FLOW_CONTROL_CREDIT) {	// credits replace XON/XOFF
+		return (xio_ctrl(XIO_DEV_USB, XIO_NOXOFF));
+	}
 	return(_set_comm_helper(nv, XIO_XOFF, XIO_NOXOFF));
 }
 
@@ -975,7 +1061,7 @@ stat_t set_baud_callback(void)
 //static const char fmt_ic[] PROGMEM = "[ic]  ignore CR or LF on RX%8d [0=off,1=CR,2=LF]\n";
 static const char fmt_ec[] PROGMEM = "[ec]  expand LF to CRLF on TX%6d [0=off,1=on]\n";
 static const char fmt_ee[] PROGMEM = "[ee]  enable echo%18d [0=off,1=on]\n";
-static const char fmt_ex[] PROGMEM = "[ex]  enable flow control%10d [0=off,1=XON/XOFF, 2=RTS/CTS]\n";
+static const char fmt_ex[] PROGMEM = "[ex]  enable flow control%10d [0=off,1=XON/XOFF, 2=RTS/CTS, 3=credits]\n";
 static const char fmt_baud[] PROGMEM = "[baud] USB baud rate%15d [1=9600,2=19200,3=38400,4=57600,5=115200,6=230400]\n";
 static const char fmt_net[] PROGMEM = "[net] network mode%17d [0=master]\n";
 static const char fmt_rx[] PROGMEM = "rx:%d\n";
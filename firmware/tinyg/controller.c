@@ -43,9 +43,15 @@
 #include "gpio.h"
 #include "report.h"
 #include "help.h"
+#include "persistence.h"
 #include "util.h"
 #include "xio.h"
 
+#ifdef __AVR
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#endif
+
 #ifdef __ARM
 #include "Reset.h"
 #endif
@@ -55,12 +61,17 @@
  ***********************************************************************************/
 
 controller_t cs;		// controller state structure
+#ifdef __DISPATCH_PROFILE
+dpProfile_t dp;			// dispatch profiler
+#endif
 
 /***********************************************************************************
  **** STATICS AND LOCALS ***********************************************************
  ***********************************************************************************/
 
 static void _controller_HSM(void);
+static void _controller_sleep(void);
+static stat_t _realtime_dispatch(void);
 static stat_t _shutdown_idler(void);
 static stat_t _normal_idler(void);
 static stat_t _limit_switch_handler(void);
@@ -98,6 +109,12 @@ void controller_init(uint8_t std_in, uint8_t std_out, uint8_t std_err)
 	tg_set_primary_source(cs.default_src);
 #endif
 
+#if defined(__DISPATCH_PROFILE) && defined(__AVR)
+	memset(&dp, 0, sizeof(dp));
+	TIMER_5.PER = 0xFFFF;							// free-running timebase for the profiler
+	TIMER_5.CTRLA = TC_CLKSEL_DIV64_gc;				// 2 uSec per tick at 32 MHz
+#endif
+
 #ifdef __ARM
 	cs.state = CONTROLLER_NOT_CONNECTED;			// find USB next
 	IndicatorLed.setFrequency(100000);
@@ -138,57 +155,283 @@ stat_t controller_test_assertions()
  * and runs the next routine in the list.
  *
  * A routine that had no action (i.e. is OFF or idle) should return STAT_NOOP
+ *
+ * In a __DISPATCH_PROFILE build each DISPATCH is also timed. DISPATCH_BUDGET
+ * is DISPATCH with a time budget in uSec for that task (see dp_begin()).
+ *
+ * Event scheduling (AVR): ISRs and producers post EVENT_ bits to cs.events.
+ * DISPATCH_WAIT is DISPATCH for a task whose STAT_EAGAIN means it is waiting on
+ * those events (e.g. _command_dispatch() waiting for an RX line). When a pass
+ * blocks in such a task the controller sleeps until one of its events, or an
+ * EVENT_ALWAYS event, is posted. A pass that blocks in a plain DISPATCH or runs
+ * to the end is a continuation making progress and is run again immediately.
+ * The ready mask is consumed at the start of each pass, and every task is still
+ * called in order, so the continuation semantics are unchanged.
  */
 
 void controller_run()
 {
 	while (true) {
 		_controller_HSM();
+		_controller_sleep();					// sleeps only if the pass blocked waiting on events
 	}
 }
 
-#define	DISPATCH(func) if (func == STAT_EAGAIN) return;
+#ifdef __DISPATCH_PROFILE
+#define	_DISPATCH(func, us, wait) { uint8_t _task = dp_begin(PSTR(#func), us); \
+		if (dp_end(_task, func) == STAT_EAGAIN) { cs.wait_events = wait; return; } }
+#else
+#define	_DISPATCH(func, us, wait) if (func == STAT_EAGAIN) { cs.wait_events = wait; return; }
+#endif
+#define	DISPATCH(func) _DISPATCH(func, 0, EVENT_NONE)
+#define	DISPATCH_BUDGET(func, us) _DISPATCH(func, us, EVENT_NONE)
+#define	DISPATCH_WAIT(func, events) _DISPATCH(func, 0, events)
+
 static void _controller_HSM()
 {
+#ifdef __DISPATCH_PROFILE
+	dp.next = 0;								// profile records are allocated in dispatch order
+#endif
+#ifdef __AVR
+	cli();										// consume the ready mask
+	cs.events = EVENT_NONE;
+	sei();
+#endif
+	cs.wait_events = EVENT_NONE;
 //----- Interrupt Service Routines are the highest priority controller functions ----//
 //      See hardware.h for a list of ISRs and their priorities.
 //
 //----- kernel level ISR handlers ----(flags are set in ISRs)------------------------//
 												// Order is important:
+	DISPATCH(_realtime_dispatch());				// 0. realtime commands run ahead of everything else
 	DISPATCH(hw_hard_reset_handler());			// 1. handle hard reset requests
 	DISPATCH(hw_bootloader_handler());			// 2. handle requests to enter bootloader
-	DISPATCH(_shutdown_idler());				// 3. idle in shutdown state
+	DISPATCH_WAIT(_shutdown_idler(), EVENT_TICK);// 3. idle in shutdown state
 //	DISPATCH( poll_switches());					// 4. run a switch polling cycle
 	DISPATCH(_limit_switch_handler());			// 5. limit switch has been thrown
 
 	DISPATCH(cm_feedhold_sequencing_callback());// 6a. feedhold state machine runner
 	DISPATCH(mp_plan_hold_callback());			// 6b. plan a feedhold from line runtime
 	DISPATCH(_system_assertions());				// 7. system integrity assertions
+	DISPATCH(en_following_error_callback());	// 8. following error alarm
 
 //----- planner hierarchy for gcode and cycles ---------------------------------------//
 
 	DISPATCH(st_motor_power_callback());		// stepper motor power sequencing
 //	DISPATCH(switch_debounce_callback());		// debounce switches
-	DISPATCH(sr_status_report_callback());		// conditionally send status report
+	DISPATCH_BUDGET(sr_status_report_callback(), 2000);	// conditionally send status report
 	DISPATCH(qr_queue_report_callback());		// conditionally send queue report
 	DISPATCH(rx_report_callback());             // conditionally send rx report
-	DISPATCH(cm_arc_callback());				// arc generation runs behind lines
-	DISPATCH(cm_homing_callback());				// G28.2 continuation
-	DISPATCH(cm_jogging_callback());			// jog function
-	DISPATCH(cm_probe_callback());				// G38.2 continuation
+	DISPATCH_BUDGET(cm_arc_callback(), 1000);	// arc generation runs behind lines
+	DISPATCH_WAIT(cm_homing_callback(), EVENT_PLANNER);	// G28.2 continuation
+	DISPATCH_WAIT(cm_jogging_callback(), EVENT_PLANNER);// jog function
+	DISPATCH_WAIT(cm_probe_callback(), EVENT_PLANNER | EVENT_TX);	// G38.2 continuation (reports wait for TX)
 	DISPATCH(cm_deferred_write_callback());		// persist G10 changes when not in machining cycle
+	DISPATCH(nvm_write_callback());				// perform queued NVM page writes
 
 //----- command readers and parsers --------------------------------------------------//
 
-	DISPATCH(_sync_to_planner());				// ensure there is at least one free buffer in planning queue
-	DISPATCH(_sync_to_tx_buffer());				// sync with TX buffer (pseudo-blocking)
+	DISPATCH_WAIT(_sync_to_planner(), EVENT_PLANNER);	// ensure there is at least one free buffer in planning queue
+	DISPATCH_WAIT(_sync_to_tx_buffer(), EVENT_TX);		// sync with TX buffer (pseudo-blocking)
 #ifdef __AVR
 	DISPATCH(set_baud_callback());				// perform baud rate update (must be after TX sync)
 #endif
-	DISPATCH(_command_dispatch());				// read and execute next command
+	DISPATCH_WAIT(_command_dispatch(), EVENT_RX);		// read and execute next command
 	DISPATCH(_normal_idler());					// blink LEDs slowly to show everything is OK
 }
 
+/*
+ * _controller_sleep() - sleep until an event the blocked task is waiting on is posted
+ *
+ *	The mask is tested with interrupts off and sleep_cpu() directly follows sei(), so a
+ *	post cannot slip in between the test and the sleep. Any interrupt wakes the CPU;
+ *	if it didn't post a wanted event the loop goes back to sleep.
+ */
+
+static void _controller_sleep()
+{
+#ifdef __AVR
+	if (cs.wait_events == EVENT_NONE) return;	// blocked task is making progress - run again
+	uint8_t wanted = cs.wait_events | EVENT_ALWAYS;
+
+	while (true) {
+		cli();
+		if ((cs.events & wanted) != 0) break;
+		sleep_enable();
+		sei();
+		sleep_cpu();
+		sleep_disable();
+	}
+	sei();
+#endif
+}
+
+/*****************************************************************************
+ * controller_queue_realtime() - trap a realtime command character (called from RX ISRs)
+ * _realtime_dispatch() 		- service the realtime command queue
+ *
+ *	controller_queue_realtime() returns true if the character was a realtime command
+ *	and has been consumed, false if it should take the normal character path. If the
+ *	queue is full a feedhold is still honored by setting the request flag directly;
+ *	other realtime commands are dropped. Only rt_head is written from the ISR side.
+ *
+ *	_realtime_dispatch() runs first in the controller so realtime commands are never
+ *	blocked behind other tasks. It drains the queue in one pass and services what it
+ *	found in priority order: stops (feedhold, queue flush, jog cancel), then cycle start,
+ *	then overrides, then status polls. Override steps accumulate, so a burst of +10%
+ *	commands is applied as a single adjustment.
+ */
+
+#define RT_FEEDHOLD		0x01
+#define RT_QUEUE_FLUSH	0x02
+#define RT_JOG_CANCEL	0x04
+#define RT_CYCLE_START	0x08
+#define RT_FEED_OVR		0x10
+#define RT_SPINDLE_OVR	0x20
+#define RT_STATUS_POLL	0x40
+
+uint8_t controller_queue_realtime(char_t c)
+{
+	switch (c) {
+		case CHAR_FEEDHOLD:
+		case CHAR_QUEUE_FLUSH:
+		case CHAR_CYCLE_START:
+		case CHAR_STATUS_POLL:
+		case CHAR_JOG_CANCEL:
+		case CHAR_FEED_OVR_RESET:
+		case CHAR_FEED_OVR_PLUS:
+		case CHAR_FEED_OVR_MINUS:
+		case CHAR_SPINDLE_OVR_RESET:
+		case CHAR_SPINDLE_OVR_PLUS:
+		case CHAR_SPINDLE_OVR_MINUS: break;
+		default: return (false);
+	}
+	uint8_t next = (cs.rt_head + 1) & (RT_QUEUE_LEN-1);
+	if (next != cs.rt_tail) {
+		cs.rt_queue[cs.rt_head] = c;
+		cs.rt_head = next;
+	} else if (c == CHAR_FEEDHOLD) {
+		cm_request_feedhold();
+	}
+	controller_post_event(EVENT_REALTIME);
+	return (true);
+}
+
+static stat_t _realtime_dispatch()
+{
+	uint8_t pending = 0;
+	uint8_t feed_reset = false;
+	uint8_t spindle_reset = false;
+	int8_t feed_steps = 0;
+	int8_t spindle_steps = 0;
+
+	while (cs.rt_tail != cs.rt_head) {
+		char_t c = cs.rt_queue[cs.rt_tail];
+		cs.rt_tail = (cs.rt_tail + 1) & (RT_QUEUE_LEN-1);
+
+		switch (c) {
+			case CHAR_FEEDHOLD:		{ pending |= RT_FEEDHOLD; break;}
+			case CHAR_QUEUE_FLUSH:	{ pending |= RT_QUEUE_FLUSH; break;}
+			case CHAR_JOG_CANCEL:	{ pending |= RT_JOG_CANCEL; break;}
+			case CHAR_CYCLE_START:	{ pending |= RT_CYCLE_START; break;}
+			case CHAR_STATUS_POLL:	{ pending |= RT_STATUS_POLL; break;}
+			case CHAR_FEED_OVR_RESET: { feed_reset = true; feed_steps = 0; pending |= RT_FEED_OVR; break;}
+			case CHAR_FEED_OVR_PLUS:  { feed_steps++; pending |= RT_FEED_OVR; break;}
+			case CHAR_FEED_OVR_MINUS: { feed_steps--; pending |= RT_FEED_OVR; break;}
+			case CHAR_SPINDLE_OVR_RESET: { spindle_reset = true; spindle_steps = 0; pending |= RT_SPINDLE_OVR; break;}
+			case CHAR_SPINDLE_OVR_PLUS:  { spindle_steps++; pending |= RT_SPINDLE_OVR; break;}
+			case CHAR_SPINDLE_OVR_MINUS: { spindle_steps--; pending |= RT_SPINDLE_OVR; break;}
+		}
+	}
+	if (pending == 0) return (STAT_NOOP);
+
+	if (pending & RT_FEEDHOLD) cm_request_feedhold();
+	if (pending & RT_QUEUE_FLUSH) cm_request_queue_flush();
+	if (pending & RT_JOG_CANCEL) cm_request_jogging_cancel();
+	if (pending & RT_CYCLE_START) cm_request_cycle_start();
+	if (pending & RT_FEED_OVR) cm_adjust_feed_override(feed_reset, feed_steps);
+	if (pending & RT_SPINDLE_OVR) cm_adjust_spindle_override(spindle_reset, spindle_steps);
+	if (pending & RT_STATUS_POLL) sr_request_status_report(SR_IMMEDIATE_REQUEST);
+	return (STAT_OK);
+}
+
+#ifdef __DISPATCH_PROFILE
+/*****************************************************************************
+ * Dispatch profiler
+ *
+ * dp_begin() 	- start timing a DISPATCH() site. Returns its record index
+ * dp_end()		- stop timing, update the record and pass the task's status through
+ * dp_get()		- $dp or {"dp":n} dumps the table as [name,calls,eagains,total_us,max_us,budget_us,overruns]
+ * dp_set()		- $dp=0 or {"dp":0} clears the table
+ *
+ *	Records are allocated in dispatch order, so record 0's call count is the number
+ *	of controller passes. Times come from free-running TIMER_5, so a single call longer
+ *	than ~131 ms wraps and is under-reported. Total time wraps after ~2.4 hours.
+ *
+ *	A task's budget is the one given to DISPATCH_BUDGET() or $dpb if none was given.
+ *	Overruns are counted. The first overrun and any new worst case are logged as
+ *	{"dpo":[name,us]} so a latency spike can be tied to its task without flooding the
+ *	output.
+ */
+
+uint8_t dp_begin(const char *name, uint32_t budget_us)
+{
+	uint8_t index = dp.next++;
+	if (index < DP_TASKS) {
+		dp.task[index].name = name;
+		dp.task[index].budget_us = budget_us;
+	}
+	dp.start = TIMER_5.CNT;
+	return (index);
+}
+
+stat_t dp_end(uint8_t index, stat_t status)
+{
+	uint16_t ticks = TIMER_5.CNT - dp.start;		// unsigned math handles timer wrap
+	if (index >= DP_TASKS) return (status);
+
+	dpTask_t *t = &dp.task[index];
+	t->calls++;
+	if (status == STAT_EAGAIN) t->eagains++;
+	t->total_ticks += ticks;
+
+	uint8_t new_max = false;
+	if (ticks > t->max_ticks) {
+		t->max_ticks = ticks;
+		new_max = true;
+	}
+	uint32_t budget_us = (t->budget_us != 0) ? t->budget_us : dp.budget_us;
+	uint32_t us = (uint32_t)ticks * DP_USEC_PER_TICK;
+	if ((budget_us != 0) && (us > budget_us)) {
+		if ((t->overruns++ == 0) || (new_max == true)) {
+			fprintf_P(stderr, PSTR("{\"dpo\":[\"%S\",%lu]}\n"), t->name, us);
+		}
+	}
+	return (status);
+}
+
+stat_t dp_get(nvObj_t *nv)
+{
+	fprintf_P(stderr, PSTR("{\"dp\":[\n"));
+	for (uint8_t i=0; (i < DP_TASKS) && (dp.task[i].name != NULL); i++) {
+		dpTask_t *t = &dp.task[i];
+		fprintf_P(stderr, PSTR("[\"%S\",%lu,%lu,%lu,%lu,%lu,%u]%S\n"), t->name,
+			t->calls, t->eagains, t->total_ticks * DP_USEC_PER_TICK,
+			(uint32_t)t->max_ticks * DP_USEC_PER_TICK,
+			(t->budget_us != 0) ? t->budget_us : dp.budget_us, t->overruns,
+			((i+1 < DP_TASKS) && (dp.task[i+1].name != NULL)) ? PSTR(",") : PSTR(""));
+	}
+	fprintf_P(stderr, PSTR("]}\n"));
+	return (STAT_OK);
+}
+
+stat_t dp_set(nvObj_t *nv)
+{
+	memset(&dp.task, 0, sizeof(dp.task));			// names and budgets are restored on the next pass
+	return (STAT_OK);
+}
+#endif // __DISPATCH_PROFILE
+
 /*****************************************************************************
  * _command_dispatch() - dispatch line received from active input device
  *
@@ -249,7 +492,10 @@ static stat_t _command_dispatch()
 
 	// set up the buffers
 	cs.linelen = strlen(cs.in_buf)+1;					// linelen only tracks primary input
-	strncpy(cs.saved_buf, cs.bufp, SAVED_BUFFER_LEN-1);	// save input buffer for reporting
+	// save input buffer for reporting - JSON mode Gcode is echoed from in_buf, so skip the copy
+	if ((cfg.comm_mode != JSON_MODE) || (strchr("{:$?H", toupper(*cs.bufp)) != NULL)) {
+		strncpy(cs.saved_buf, cs.bufp, SAVED_BUFFER_LEN-1);
+	}
 
 	// dispatch the new text line
 	switch (toupper(*cs.bufp)) {						// first char
@@ -274,16 +520,25 @@ static stat_t _command_dispatch()
 			json_parser(cs.bufp);
 			break;
 		}
+		case ':': { 									// config snapshot line
+			stat_t snap_status = nvm_load_snapshot(cs.bufp);
+			if (cfg.comm_mode == JSON_MODE) {
+				nv_reset_nv_list();
+				json_print_response(snap_status);
+			} else {
+				text_response(snap_status, cs.saved_buf);
+			}
+			break;
+		}
 		default: {										// anything else must be Gcode
 			if (cfg.comm_mode == JSON_MODE) {			// run it as JSON...
-				strncpy(cs.out_buf, cs.bufp, INPUT_BUFFER_LEN -8);					// use out_buf as temp
-				sprintf((char *)cs.bufp,"{\"gc\":\"%s\"}\n", (char *)cs.out_buf);	// '-8' is used for JSON chars
-				json_parser(cs.bufp);
+				json_parse_gcode(cs.bufp);				//...in place, without wrapping it in {"gc":""}
 			} else {									//...or run it as text
 				text_response(gc_gcode_parser(cs.bufp), cs.saved_buf);
 			}
 		}
 	}
+	nvm_flush();										// write back any settings changed by the command
 	return (STAT_OK);
 }
 
@@ -374,13 +629,23 @@ void tg_set_primary_source(uint8_t dev) { cs.primary_src = dev;}
 void tg_set_secondary_source(uint8_t dev) { cs.secondary_src = dev;}
 
 /*
- * _sync_to_tx_buffer() - return eagain if TX queue is backed up
+ * _sync_to_tx_buffer() - return eagain if TX queue can't take the next command's response
+ *
+ *	A JSON response that didn't fit the TX buffer when it was made is held in cs.out_buf.
+ *	It goes out here, before the next command is read, once the host has read enough.
+ *	A streamed JSON response that is waiting for TX room is continued here the same way.
  * _sync_to_planner() - return eagain if planner is not ready for a new command
  * _sync_to_time() - return eagain if planner is not ready for a new command
  */
 static stat_t _sync_to_tx_buffer()
 {
-	if ((xio_get_tx_bufcount_usart(ds[XIO_DEV_USB].x) >= XOFF_TX_LO_WATER_MARK)) {
+	if (json_write_pending() == STAT_EAGAIN) {
+		return (STAT_EAGAIN);
+	}
+	if (json_write_streaming() == STAT_EAGAIN) {
+		return (STAT_EAGAIN);
+	}
+	if (xio_get_tx_free() < TX_RESPONSE_RESERVE) {
 		return (STAT_EAGAIN);
 	}
 	return (STAT_OK);
@@ -34,6 +34,7 @@ extern "C"{
 
 #define INPUT_BUFFER_LEN 255			// text buffer size (255 max)
 #define SAVED_BUFFER_LEN 100			// saved buffer size (for reporting only)
+#define RT_QUEUE_LEN 8					// realtime command queue depth (must be a power of 2)
 #define OUTPUT_BUFFER_LEN 512			// text buffer size
 // see also: tinyg.h MESSAGE_LEN and config.h NV_ lengths
 
@@ -71,6 +72,15 @@ typedef struct controllerSingleton {	// main TG controller struct
 
 	int32_t job_id[4];					// uuid to identify the job
 
+	// event scheduler - see controller_run()
+	volatile uint8_t events;			// ready mask: EVENT_ bits posted by ISRs and producers
+	uint8_t wait_events;				// events the blocked task is waiting on (EVENT_NONE = run again)
+
+	// realtime command queue - filled by RX ISRs, drained by _realtime_dispatch()
+	volatile uint8_t rt_head;			// written by ISRs only
+	volatile uint8_t rt_tail;			// written by the controller only
+	char_t rt_queue[RT_QUEUE_LEN];		// queued realtime command characters
+
 	// controller serial buffers
 	char_t *bufp;						// pointer to primary or secondary in buffer
 	char_t in_buf[INPUT_BUFFER_LEN];	// primary input buffer
@@ -81,6 +91,50 @@ typedef struct controllerSingleton {	// main TG controller struct
 
 extern controller_t cs;					// controller state structure
 
+#ifdef __DISPATCH_PROFILE
+#define DP_TASKS 32						// max number of profiled DISPATCH() sites
+#define DP_USEC_PER_TICK 2				// TIMER_5 runs at F_CPU/64
+
+typedef struct dpTask {					// profile record for one DISPATCH() site
+	const char *name;					// PSTR name of the dispatched function
+	uint32_t calls;						// number of times called
+	uint32_t eagains;					// number of times it returned STAT_EAGAIN
+	uint32_t total_ticks;				// cumulative execution time
+	uint16_t max_ticks;					// worst case execution time
+	uint16_t overruns;					// number of times the budget was exceeded
+	uint32_t budget_us;					// call-site budget in uSec (0 = use dp.budget_us)
+} dpTask_t;
+
+typedef struct dpProfile {				// dispatch profiler singleton
+	uint32_t budget_us;					// default per-task budget in uSec (0 = disabled)
+	uint16_t start;						// TIMER_5 count at start of the current task
+	uint8_t next;						// index of the next DISPATCH() site in this pass
+	dpTask_t task[DP_TASKS];
+} dpProfile_t;
+
+extern dpProfile_t dp;
+
+uint8_t dp_begin(const char *name, uint32_t budget_us);
+stat_t dp_end(uint8_t index, stat_t status);
+stat_t dp_get(struct nvObject *nv);			// dump the profile table
+stat_t dp_set(struct nvObject *nv);			// clear the profile table
+#endif // __DISPATCH_PROFILE
+
+enum ctrlEvent {						// controller ready-mask bits
+	EVENT_NONE = 0,
+	EVENT_RX = 0x01,					// RX line completed
+	EVENT_TX = 0x02,					// TX buffer space freed
+	EVENT_PLANNER = 0x04,				// planner buffer freed or runtime segment executed
+	EVENT_SWITCH = 0x08,				// switch thrown
+	EVENT_TICK = 0x10,					// RTC tick (10 ms) - drives report and timeout timers
+	EVENT_REALTIME = 0x20				// realtime command queued or reset requested
+};
+#define EVENT_ALWAYS (EVENT_REALTIME | EVENT_SWITCH | EVENT_TICK)	// events that wake any wait
+
+// controller_post_event() may be called from ISRs or the main loop. A post lost to a
+// nested interrupt is recovered by the next RTC tick.
+#define controller_post_event(e) (cs.events |= (e))
+
 enum cmControllerState {				// manages startup lines
 	CONTROLLER_INITIALIZING = 0,		// controller is initializing - not ready for use
 	CONTROLLER_NOT_CONNECTED,			// controller has not yet detected connection to USB (or other comm channel)
@@ -95,6 +149,7 @@ void controller_init(uint8_t std_in, uint8_t std_out, uint8_t std_err);
 void controller_init_assertions(void);
 stat_t controller_test_assertions(void);
 void controller_run(void);
+uint8_t controller_queue_realtime(char_t c);
 //void controller_reset(void);
 
 void tg_reset_source(void);
@@ -28,12 +28,15 @@
 #include "tinyg.h"
 #include "util.h"
 #include "config.h"
+#include "settings.h"
 #include "json_parser.h"
 #include "text_parser.h"
 #include "canonical_machine.h"
 #include "planner.h"
 #include "switch.h"
 #include "report.h"
+#include "stepper.h"
+#include "encoder.h"
 
 #ifdef __cplusplus
 extern "C"{
@@ -41,6 +44,27 @@ extern "C"{
 
 /**** Homing singleton structure ****/
 
+enum hmGroupAxisState {				// per-axis progress through a group homing
+	HOMING_AXIS_IDLE = 0,			// not part of the group being homed
+	HOMING_AXIS_SEARCH,				// searching for its homing switch
+	HOMING_AXIS_LATCH,				// on the switch, waiting for the latch to open it
+	HOMING_AXIS_LATCHED				// latch position recorded
+};
+
+typedef struct hmGroupAxis {		// per-axis parameters for homing groups
+	uint8_t state;					// see hmGroupAxisState
+	int8_t homing_switch;			// homing switch for the axis (index into switch flag table)
+	int8_t limit_switch;			// limit switch for the axis, or -1 if none
+	float search_travel;			// signed search distance remaining
+	float search_velocity;
+	float latch_velocity;
+	float latch_backoff;			// signed, away from the switch
+	float zero_backoff;				// signed, away from the switch
+	float position;					// position at the start of the current search move
+	float latch_position;			// position where the switch opened during the latch
+	float saved_jerk;
+} hmGroupAxis_t;
+
 struct hmHomingSingleton {			// persistent homing runtime variables
 	// controls for homing cycle
 	int8_t axis;					// axis currently being homed
@@ -58,6 +82,8 @@ struct hmHomingSingleton {			// persistent homing runtime variables
 #endif
 	void (*switch_saved_on_trailing)(struct swSwitch *s);
 
+	uint8_t edge_captured;			// true = the latch edge of the homing switch was captured...
+	float edge_position;			// ...at this position, which then sets zero (not the stop position)
 	uint8_t homing_closed;			// 0=open, 1=closed
 	uint8_t limit_closed;			// 0=open, 1=closed
 	uint8_t set_coordinates;		// G28.4 flag. true = set coords to zero at the end of homing cycle
@@ -79,6 +105,34 @@ struct hmHomingSingleton {			// persistent homing runtime variables
 	uint8_t saved_feed_rate_mode;   // G93,G94 global setting
 	float saved_feed_rate;			// F setting
 	float saved_jerk;				// saved and restored for each axis homed
+
+	// homing groups - axes in the same group search and latch together
+	uint8_t axis_done[HOMING_AXES];	// axis has been homed (or skipped) in this cycle
+	uint8_t group_passes;			// clear passes run for the group, bounds the clear loop
+	volatile uint8_t group_latch;	// true = switch openings are recorded, not held
+	hmGroupAxis_t g[HOMING_AXES];
+
+	// gantry squaring - each motor of the axis stops on its own switch ($1hs...)
+	int8_t motor_switch[MOTORS];	// homing switch for each motor of the axis, -1 if not on the axis
+	uint8_t square_motors;			// bitmask of the axis motors. 0 = axis is not squared
+	volatile uint8_t square_pending;// motors still waiting for their switch to change
+	uint8_t square_target;			// switch state that stops a pending motor
+	int8_t square_motor;			// motor whose squaring offset is being moved
+
+	// step loss calibration - runs as an extension of the homing state machine
+	uint8_t calibrate;				// true = calibrating hm.cal_axis instead of homing
+	int8_t cal_axis;				// axis being calibrated
+	uint8_t trial;					// sweep trial number. 0 is the baseline latch
+	uint8_t step_loss;				// set when a trial moved the switch latch position
+	uint8_t saved_homing_state;		// calibration does not change the machine's homing state
+	float cal_travel;				// signed length of the sweep moves (away from the switch)
+	float latch_position;			// baseline position where the search stopped on the switch
+	float trial_jerk;				// jerk and velocity used by the current trial
+	float trial_velocity;
+	float passed_jerk;				// highest jerk and velocity that held position (0 = none)
+	float passed_velocity;
+	float saved_velocity_max;		// saved and restored around each trial
+	float saved_feedrate_max;
 };
 static struct hmHomingSingleton hm;
 
@@ -86,9 +140,12 @@ static struct hmHomingSingleton hm;
 
 static stat_t _set_homing_func(stat_t (*func)(int8_t axis));
 static stat_t _homing_axis_start(int8_t axis);
+static stat_t _homing_axis_check(int8_t axis);
+static stat_t _homing_axis_setup(int8_t axis);
 static stat_t _homing_axis_clear(int8_t axis);
 static stat_t _homing_axis_search(int8_t axis);
 static stat_t _homing_axis_latch(int8_t axis);
+static stat_t _homing_axis_square(int8_t axis);
 static stat_t _homing_axis_zero_backoff(int8_t axis);
 static stat_t _homing_axis_set_zero(int8_t axis);
 static stat_t _homing_axis_move(int8_t axis, float target, float velocity);
@@ -96,6 +153,28 @@ static stat_t _homing_abort(int8_t axis);
 static stat_t _homing_error_exit(int8_t axis, stat_t status);
 static stat_t _homing_finalize_exit(int8_t axis);
 static int8_t _get_next_axis(int8_t axis);
+static uint8_t _get_group_size(int8_t axis);
+
+static stat_t _homing_group_start(int8_t axis);
+static stat_t _homing_group_clear(int8_t axis);
+static stat_t _homing_group_search(int8_t axis);
+static stat_t _homing_group_found(int8_t axis);
+static stat_t _homing_group_latch(int8_t axis);
+static stat_t _homing_group_zero_backoff(int8_t axis);
+static stat_t _homing_group_set_zero(int8_t axis);
+static stat_t _homing_group_move(float travel[], float velocity[]);
+static void _homing_group_restore(void);
+
+static stat_t _homing_square_setup(int8_t axis);
+static uint8_t _homing_square_pending(uint8_t target);
+static uint8_t _homing_square_begin(uint8_t target);
+
+static stat_t _calibrate_axis_sweep(int8_t axis);
+static stat_t _calibrate_axis_return(int8_t axis);
+static stat_t _calibrate_axis_search(int8_t axis);
+static stat_t _calibrate_axis_measure(int8_t axis);
+static void _calibrate_restore_axis(int8_t axis);
+static stat_t _calibrate_finalize_exit(int8_t axis);
 
 /***********************************************************************************
  **** G28.2 Homing Cycle ***********************************************************
@@ -112,9 +191,12 @@ static int8_t _get_next_axis(int8_t axis);
  *	Homing is invoked using a G28.2 command with 1 or more axes specified in the
  *	command: e.g. g28.2 x0 y0 z0     (FYI: the number after each axis is irrelevant)
  *
- *	Homing is always run in the following order - for each enabled axis:
+ *	Homing is run in order of the axis homing group settings ($xhg...). The defaults
+ *	give the traditional order - for each enabled axis:
  *	  Z,X,Y,A			Note: B and C cannot be homed
  *
+ *	Axes given the same group number are homed together - see HOMING GROUPS below.
+ *
  *	At the start of a homing cycle those switches configured for homing
  *	(or for homing and limits) are treated as homing switches (they are modal).
  *
@@ -125,6 +207,11 @@ static int8_t _get_next_axis(int8_t axis);
  *	  2. Drive away from the homing switch at latch velocity until switch opens
  *	  3. Back off switch by the zero backoff distance and set zero for that axis
  *
+ *	Zero is set at the zero backoff distance from where the switch opened in step 2.
+ *	The switch interrupt captures the step position at the edge, so the deglitch time
+ *	and the feedhold deceleration don't move the zero. If the edge is not captured the
+ *	zero is the zero backoff from where the latch stopped, as before.
+ *
  *	Homing works as a state machine that is driven by registering a callback
  *	function at hm.func() for the next state to be run. Once the axis is
  *	initialized each callback basically does two things (1) start the move
@@ -168,6 +255,7 @@ stat_t cm_homing_cycle_start(void)
 	cm_set_coord_system(ABSOLUTE_COORDS);	// homing is done in machine coordinates
 	cm_set_feed_rate_mode(UNITS_PER_MINUTE_MODE);
 	hm.set_coordinates = true;
+	hm.calibrate = false;
 
 	hm.axis = -1;							// set to retrieve initial axis
 	hm.func = _homing_axis_start; 			// bind initial processing function
@@ -187,6 +275,7 @@ stat_t cm_homing_cycle_start_no_set(void)
 /* Homing axis moves - these execute in sequence for each axis
  * cm_homing_callback() 		- main loop callback for running the homing cycle
  *	_set_homing_func()			- a convenience for setting the next dispatch vector and exiting
+ *	_homing_axis_setup()		- check axis settings and load the homing parameters into hm
  *	_trigger_feedhold()			- callback from switch closure to trigger a feedhold (convenience for casting)
  *  _bind_switch_settings()		- setup switch for homing operation
  *	_restore_switch_settings()	- return switch to normal operation
@@ -194,6 +283,7 @@ stat_t cm_homing_cycle_start_no_set(void)
  *	_homing_axis_clear()		- initiate a clear to move off a switch that is thrown at the start
  *	_homing_axis_search()		- fast search for switch, closes switch
  *	_homing_axis_latch()		- slow reverse until switch opens again
+ *	_homing_axis_square()		- move the squaring offsets of a squared gantry
  *	_homing_axis_final()		- backoff from latch location to zero position
  *	_homing_axis_move()			- helper that actually executes the above moves
  */
@@ -234,23 +324,54 @@ static stat_t _homing_axis_start(int8_t axis)
 	// get the first or next axis
 	if ((axis = _get_next_axis(axis)) < 0) { 				// axes are done or error
 		if (axis == -1) {									// -1 is done
+			if (hm.calibrate == true) {
+				return (_set_homing_func(_calibrate_finalize_exit));
+			}
 			cm.homing_state = HOMING_HOMED;
 			return (_set_homing_func(_homing_finalize_exit));
 		} else if (axis == -2) { 							// -2 is error
 			return (_homing_error_exit(-2, STAT_HOMING_ERROR_BAD_OR_NO_AXIS));
 		}
 	}
-	// clear the homed flag for axis so we'll be able to move w/o triggering soft limits
-	cm.homed[axis] = false;
+#ifndef __NEW_SWITCHES
+	if ((hm.calibrate == false) && (_get_group_size(axis) > 1)) {
+		return (_homing_group_start(axis));					// home the axis with its group
+	}
+#endif
+	stat_t status = _homing_axis_setup(axis);
+	if (status == STAT_NOOP) {								// homing is disabled for the axis
+		return (_set_homing_func(_homing_axis_start));
+	}
+	if (status != STAT_OK) {								// error exit has already run
+		return (status);
+	}
+#ifndef __NEW_SWITCHES
+	if ((status = _homing_square_setup(axis)) != STAT_OK) {
+		return (status);
+	}
+#endif
+//	hm.saved_jerk = cm.a[axis].jerk_max;					// save the max jerk value
+	hm.saved_jerk = cm_get_axis_jerk(axis);					// save the max jerk value
+	return (_set_homing_func(_homing_axis_clear));			// start the clear
+}
+
+/*
+ * _homing_axis_check() - check the axis settings and switch setup without moving anything
+ *
+ *	Returns STAT_OK if the axis can be homed or the homing error status for the setting
+ *	that prevents it. Leaves the switch modes in hm.min_mode and hm.max_mode.
+ */
 
+static stat_t _homing_axis_check(int8_t axis)
+{
 	// trap axis mis-configurations
-	if (fp_ZERO(cm.a[axis].search_velocity)) return (_homing_error_exit(axis, STAT_HOMING_ERROR_ZERO_SEARCH_VELOCITY));
-	if (fp_ZERO(cm.a[axis].latch_velocity)) return (_homing_error_exit(axis, STAT_HOMING_ERROR_ZERO_LATCH_VELOCITY));
-	if (cm.a[axis].latch_backoff < 0) return (_homing_error_exit(axis, STAT_HOMING_ERROR_NEGATIVE_LATCH_BACKOFF));
+	if (fp_ZERO(cm.a[axis].search_velocity)) return (STAT_HOMING_ERROR_ZERO_SEARCH_VELOCITY);
+	if (fp_ZERO(cm.a[axis].latch_velocity)) return (STAT_HOMING_ERROR_ZERO_LATCH_VELOCITY);
+	if (cm.a[axis].latch_backoff < 0) return (STAT_HOMING_ERROR_NEGATIVE_LATCH_BACKOFF);
 
-	// calculate and test travel distance
+	// test travel distance
 	float travel_distance = fabs(cm.a[axis].travel_max - cm.a[axis].travel_min) + cm.a[axis].latch_backoff;
-	if (fp_ZERO(travel_distance)) return (_homing_error_exit(axis, STAT_HOMING_ERROR_TRAVEL_MIN_MAX_IDENTICAL));
+	if (fp_ZERO(travel_distance)) return (STAT_HOMING_ERROR_TRAVEL_MIN_MAX_IDENTICAL);
 
 	// determine the switch setup and that config is OK
 #ifndef __NEW_SWITCHES
@@ -261,9 +382,29 @@ static stat_t _homing_axis_start(int8_t axis)
 	hm.max_mode = get_switch_mode(axis, SW_MAX);
 #endif
 
-	if ( ((hm.min_mode & SW_HOMING_BIT) ^ (hm.max_mode & SW_HOMING_BIT)) == 0) {	  // one or the other must be homing
-		return (_homing_error_exit(axis, STAT_HOMING_ERROR_SWITCH_MISCONFIGURATION)); // axis cannot be homed
+	if ( ((hm.min_mode & SW_HOMING_BIT) ^ (hm.max_mode & SW_HOMING_BIT)) == 0) {	// one or the other must be homing
+		return (STAT_HOMING_ERROR_SWITCH_MISCONFIGURATION);	// axis cannot be homed
+	}
+	return (STAT_OK);
+}
+
+/*
+ * _homing_axis_setup() - check axis settings and load the homing parameters for the axis
+ *
+ *	Returns STAT_OK if the axis can be homed, STAT_NOOP if homing is disabled for the axis,
+ *	or the status of the error exit if the axis is misconfigured.
+ */
+
+static stat_t _homing_axis_setup(int8_t axis)
+{
+	// clear the homed flag for axis so we'll be able to move w/o triggering soft limits
+	cm.homed[axis] = false;
+
+	stat_t status = _homing_axis_check(axis);
+	if (status != STAT_OK) {
+		return (_homing_error_exit(axis, status));
 	}
+	float travel_distance = fabs(cm.a[axis].travel_max - cm.a[axis].travel_min) + cm.a[axis].latch_backoff;
 	hm.axis = axis;											// persist the axis
 	hm.search_velocity = fabs(cm.a[axis].search_velocity);	// search velocity is always positive
 	hm.latch_velocity = fabs(cm.a[axis].latch_velocity);	// latch velocity is always positive
@@ -303,7 +444,7 @@ static stat_t _homing_axis_start(int8_t axis)
 #ifndef __NEW_SWITCHES
 	uint8_t sw_mode = get_switch_mode(hm.homing_switch);
 	if ((sw_mode != SW_MODE_HOMING) && (sw_mode != SW_MODE_HOMING_LIMIT)) {
-		return (_set_homing_func(_homing_axis_start));
+		return (STAT_NOOP);
 	}
 	// disable the limit switch parameter if there is no limit switch
 	if (get_switch_mode(hm.limit_switch) == SW_MODE_DISABLED) hm.limit_switch = -1;
@@ -314,17 +455,14 @@ static stat_t _homing_axis_start(int8_t axis)
 
 	uint8_t sw_mode = get_switch_mode(hm.homing_switch_axis, hm.homing_switch_position);
 	if ((sw_mode != SW_MODE_HOMING) && (sw_mode != SW_MODE_HOMING_LIMIT)) {
-		return (_set_homing_func(_homing_axis_start));
+		return (STAT_NOOP);
 	}
 	// disable the limit switch parameter if there is no limit switch
 	if (get_switch_mode(hm.limit_switch_axis, hm.limit_switch_position) == SW_MODE_DISABLED) {
 		hm.limit_switch_axis = -1;
 	}
 #endif
-
-//	hm.saved_jerk = cm.a[axis].jerk_max;					// save the max jerk value
-	hm.saved_jerk = cm_get_axis_jerk(axis);					// save the max jerk value
-	return (_set_homing_func(_homing_axis_clear));			// start the clear
+	return (STAT_OK);
 }
 
 // Handle an initial switch closure by backing off the closed switch
@@ -332,7 +470,8 @@ static stat_t _homing_axis_start(int8_t axis)
 static stat_t _homing_axis_clear(int8_t axis)				// first clear move
 {
 #ifndef __NEW_SWITCHES
-	if (sw.state[hm.homing_switch] == SW_CLOSED) {
+	if ((sw.state[hm.homing_switch] == SW_CLOSED) ||
+		((hm.square_motors != 0) && (_homing_square_pending(SW_OPEN) != 0))) {
 		_homing_axis_move(axis, hm.latch_backoff, hm.search_velocity);
 	} else if (sw.state[hm.limit_switch] == SW_CLOSED) {
 		_homing_axis_move(axis, -hm.latch_backoff, hm.search_velocity);
@@ -352,6 +491,11 @@ static stat_t _homing_axis_clear(int8_t axis)				// first clear move
 static stat_t _homing_axis_search(int8_t axis)				// start the search
 {
 	cm_set_axis_jerk(axis, cm.a[axis].jerk_homing);			// use the homing jerk for search onward
+#ifndef __NEW_SWITCHES
+	if ((hm.square_motors != 0) && (_homing_square_begin(SW_CLOSED) == 0)) {
+		return (_set_homing_func(_homing_axis_latch));		// every motor is already on its switch
+	}
+#endif
 	_homing_axis_move(axis, hm.search_travel, hm.search_velocity);
     return (_set_homing_func(_homing_axis_latch));
 }
@@ -361,8 +505,17 @@ static stat_t _homing_axis_latch(int8_t axis)				// latch to switch open
 	// verify assumption that we arrived here because of homing switch closure
 	// rather than user-initiated feedhold or other disruption
 #ifndef __NEW_SWITCHES
+	if (hm.square_motors != 0) {
+		if (_homing_square_pending(SW_CLOSED) != 0)			// a motor did not find its switch
+			return (_set_homing_func(_homing_abort));
+		_homing_square_begin(SW_OPEN);						// each motor stops as its switch opens
+		hm.square_motor = -1;
+		_homing_axis_move(axis, hm.latch_backoff, hm.latch_velocity);
+		return (_set_homing_func(_homing_axis_square));
+	}
 	if (sw.state[hm.homing_switch] != SW_CLOSED)
 		return (_set_homing_func(_homing_abort));
+	sw_clear_edge(hm.homing_switch);						// capture the edge that opens the switch
 #else
 	if (read_switch(hm.homing_switch_axis, hm.homing_switch_position) != SW_CLOSED)
 		return (_set_homing_func(_homing_abort));
@@ -371,8 +524,36 @@ static stat_t _homing_axis_latch(int8_t axis)				// latch to switch open
 	return (_set_homing_func(_homing_axis_zero_backoff));
 }
 
+static stat_t _homing_axis_square(int8_t axis)			// one offset move per motor
+{
+	if (hm.square_pending != 0) {							// the latch ran out before every switch opened
+		return (_set_homing_func(_homing_abort));
+	}
+	mp_set_steps_to_runtime_position();						// held motors lag their steps - drop the lag
+	while (++hm.square_motor < MOTORS) {
+		if (((hm.square_motors & (1<<hm.square_motor)) == 0) ||
+			(fp_ZERO(st_cfg.mot[hm.square_motor].squaring_offset))) {
+			continue;
+		}
+		float offset = st_cfg.mot[hm.square_motor].squaring_offset;
+		st_set_motor_inhibit(hm.square_motors & ~(1<<hm.square_motor));
+		_homing_axis_move(axis, (hm.search_travel > 0) ? -offset : offset, hm.latch_velocity);
+		return (_set_homing_func(_homing_axis_square));
+	}
+	st_set_motor_inhibit(0);								// the gantry is square - move together
+	return (_set_homing_func(_homing_axis_zero_backoff));
+}
+
 static stat_t _homing_axis_zero_backoff(int8_t axis)		// backoff to zero position
 {
+	hm.edge_captured = false;
+#ifndef __NEW_SWITCHES
+	if ((hm.square_motors == 0) && (sw.state[hm.homing_switch] == SW_OPEN)) {
+		float position[AXES];
+		hm.edge_captured = sw_get_edge_position(hm.homing_switch, position);
+		hm.edge_position = position[axis];
+	}
+#endif
 	_homing_axis_move(axis, hm.zero_backoff, hm.search_velocity);
 	return (_set_homing_func(_homing_axis_set_zero));
 }
@@ -380,7 +561,11 @@ static stat_t _homing_axis_zero_backoff(int8_t axis)		// backoff to zero positio
 static stat_t _homing_axis_set_zero(int8_t axis)			// set zero and finish up
 {
 	if (hm.set_coordinates != false) {
-		cm_set_position(axis, 0);
+		if (hm.edge_captured == true) {						// zero is the zero backoff from the edge
+			cm_set_position(axis, mp_get_runtime_absolute_position(axis) - (hm.edge_position + hm.zero_backoff));
+		} else {
+			cm_set_position(axis, 0);
+		}
 		cm.homed[axis] = true;
 	} else {
         // do not set axis if in G28.4 cycle
@@ -393,6 +578,9 @@ static stat_t _homing_axis_set_zero(int8_t axis)			// set zero and finish up
 	s->on_trailing = hm.switch_saved_on_trailing;
 	_restore_switch_settings(&sw.s[hm.homing_switch_axis][hm.homing_switch_position]);
 #endif
+	if (hm.calibrate == true) {
+		return (_set_homing_func(_calibrate_axis_sweep));	// every latch returns to the sweep
+	}
 	return (_set_homing_func(_homing_axis_start));
 }
 
@@ -416,7 +604,16 @@ static stat_t _homing_axis_move(int8_t axis, float target, float velocity)
 
 static stat_t _homing_abort(int8_t axis)
 {
-	cm_set_axis_jerk(axis, hm.saved_jerk);					// restore the max jerk value
+	uint8_t group = false;
+	for (uint8_t i=0; i<HOMING_AXES; i++) {
+		if (hm.g[i].state != HOMING_AXIS_IDLE) group = true;
+	}
+	if (group == true) {
+		_homing_group_restore();							// groups restore their own jerk
+	} else {
+		_calibrate_restore_axis(axis);
+		cm_set_axis_jerk(axis, hm.saved_jerk);				// single axis path saved the jerk
+	}
 #ifdef __NEW_SWITCHES
 	_restore_switch_settings(&sw.s[hm.homing_switch_axis][hm.homing_switch_position]);
 #endif
@@ -456,6 +653,13 @@ static stat_t _homing_finalize_exit(int8_t axis)			// third part of return to ho
 {
 	mp_flush_planner(); 									// should be stopped, but in case of switch closure.
 															// don't use cm_request_queue_flush() here
+	_homing_group_restore();								// in case of a group error exit
+	hm.square_pending = 0;									// in case squaring was interrupted
+	hm.square_motors = 0;
+	if (st_pre.motor_inhibit != 0) {
+		st_set_motor_inhibit(0);
+		mp_set_steps_to_runtime_position();					// so correction doesn't chase the held motors
+	}
 
 	cm_set_coord_system(hm.saved_coord_system);				// restore to work coordinate system
 	cm_set_units_mode(hm.saved_units_mode);
@@ -472,10 +676,11 @@ static stat_t _homing_finalize_exit(int8_t axis)			// third part of return to ho
  * _get_next_axis() - return next axis in sequence based on axis in arg
  *
  *	Accepts "axis" arg as the current axis; or -1 to retrieve the first axis
- *	Returns next axis based on "axis" argument and if that axis is flagged for homing in the gf struct
+ *	Returns next axis flagged for homing in the gf struct that has not been homed yet
  *	Returns -1 when all axes have been processed
  *	Returns -2 if no axes are specified (Gcode calling error)
- *	Homes Z first, then the rest in sequence
+ *	Axes are taken in ascending homing group order. Within a group the lowest axis comes
+ *	first; the group homing takes the rest of the group with it.
  *
  *	Isolating this function facilitates implementing more complex and
  *	user-specified axis homing orders
@@ -483,74 +688,587 @@ static stat_t _homing_finalize_exit(int8_t axis)			// third part of return to ho
 
 static int8_t _get_next_axis(int8_t axis)
 {
-#if (HOMING_AXES <= 4)
-//    uint8_t axis;
-//    for(axis = AXIS_X; axis < HOMING_AXES; axis++)
-//        if(fp_TRUE(cm.gf.target[axis])) break;
-//    if(axis >= HOMING_AXES) return -2;
-//    switch(axis) {
-//        case -1:        if (fp_TRUE(cm.gf.target[AXIS_Z])) return (AXIS_Z);
-//        case AXIS_Z:    if (fp_TRUE(cm.gf.target[AXIS_X])) return (AXIS_X);
-//        case AXIS_X:    if (fp_TRUE(cm.gf.target[AXIS_Y])) return (AXIS_Y);
-//        case AXIS_Y:    if (fp_TRUE(cm.gf.target[AXIS_A])) return (AXIS_A);
-//#if (HOMING_AXES > 4)
-//        case AXIS_A:    if (fp_TRUE(cm.gf.target[AXIS_B])) return (AXIS_B);
-//        case AXIS_B:    if (fp_True(cm.gf.target[AXIS_C])) return (AXIS_C);
-//#endif
-//        default:        return -1;
-//    }
-	if (axis == -1) {	// inelegant brute force solution
-		if (fp_TRUE(cm.gf.target[AXIS_Z])) return (AXIS_Z);
-		if (fp_TRUE(cm.gf.target[AXIS_X])) return (AXIS_X);
-		if (fp_TRUE(cm.gf.target[AXIS_Y])) return (AXIS_Y);
-		if (fp_TRUE(cm.gf.target[AXIS_A])) return (AXIS_A);
-		return (-2);	// error
-	} else if (axis == AXIS_Z) {
-		if (fp_TRUE(cm.gf.target[AXIS_X])) return (AXIS_X);
-		if (fp_TRUE(cm.gf.target[AXIS_Y])) return (AXIS_Y);
-		if (fp_TRUE(cm.gf.target[AXIS_A])) return (AXIS_A);
-	} else if (axis == AXIS_X) {
-		if (fp_TRUE(cm.gf.target[AXIS_Y])) return (AXIS_Y);
-		if (fp_TRUE(cm.gf.target[AXIS_A])) return (AXIS_A);
-	} else if (axis == AXIS_Y) {
-		if (fp_TRUE(cm.gf.target[AXIS_A])) return (AXIS_A);
-	}
-	return (-1);	// done
+	if (hm.calibrate == true) {								// calibration runs a single axis
+		return ((axis == -1) ? hm.cal_axis : -1);
+	}
+	if (axis == -1) {
+		for (uint8_t i=0; i<HOMING_AXES; i++) hm.axis_done[i] = false;
+	} else {
+		hm.axis_done[axis] = true;
+	}
+	int8_t next_axis = -1;
+	uint8_t requested = false;
+	for (int8_t i=0; i<HOMING_AXES; i++) {
+		if (fp_FALSE(cm.gf.target[i])) continue;
+		requested = true;
+		if (hm.axis_done[i] == true) continue;
+		if ((next_axis == -1) || (cm.a[i].homing_group < cm.a[next_axis].homing_group)) {
+			next_axis = i;
+		}
+	}
+	if ((axis == -1) && (requested == false)) return (-2);	// error
+	return (next_axis);										// -1 is done
+}
 
-#else
+/*
+ * _get_group_size() - return the number of axes still to be homed in the axis' group
+ */
 
-	if (axis == -1) {
-		if (fp_TRUE(cm.gf.target[AXIS_Z])) return (AXIS_Z);
-		if (fp_TRUE(cm.gf.target[AXIS_X])) return (AXIS_X);
-		if (fp_TRUE(cm.gf.target[AXIS_Y])) return (AXIS_Y);
-		if (fp_TRUE(cm.gf.target[AXIS_A])) return (AXIS_A);
-		if (fp_TRUE(cm.gf.target[AXIS_B])) return (AXIS_B);
-		if (fp_TRUE(cm.gf.target[AXIS_C])) return (AXIS_C);
-		return (-2);	// error
-	} else if (axis == AXIS_Z) {
-		if (fp_TRUE(cm.gf.target[AXIS_X])) return (AXIS_X);
-		if (fp_TRUE(cm.gf.target[AXIS_Y])) return (AXIS_Y);
-		if (fp_TRUE(cm.gf.target[AXIS_A])) return (AXIS_A);
-		if (fp_TRUE(cm.gf.target[AXIS_B])) return (AXIS_B);
-		if (fp_TRUE(cm.gf.target[AXIS_C])) return (AXIS_C);
-	} else if (axis == AXIS_X) {
-		if (fp_TRUE(cm.gf.target[AXIS_Y])) return (AXIS_Y);
-		if (fp_TRUE(cm.gf.target[AXIS_A])) return (AXIS_A);
-		if (fp_TRUE(cm.gf.target[AXIS_B])) return (AXIS_B);
-		if (fp_TRUE(cm.gf.target[AXIS_C])) return (AXIS_C);
-	} else if (axis == AXIS_Y) {
-		if (fp_TRUE(cm.gf.target[AXIS_A])) return (AXIS_A);
-		if (fp_TRUE(cm.gf.target[AXIS_B])) return (AXIS_B);
-		if (fp_TRUE(cm.gf.target[AXIS_C])) return (AXIS_C);
-	} else if (axis == AXIS_A) {
-		if (fp_TRUE(cm.gf.target[AXIS_B])) return (AXIS_B);
-		if (fp_TRUE(cm.gf.target[AXIS_C])) return (AXIS_C);
-	} else if (axis == AXIS_B) {
-		if (fp_TRUE(cm.gf.target[AXIS_C])) return (AXIS_C);
-	}
-	return (-1);	// done
+static uint8_t _get_group_size(int8_t axis)
+{
+	uint8_t size = 0;
+	for (uint8_t i=0; i<HOMING_AXES; i++) {
+		if ((fp_TRUE(cm.gf.target[i])) && (hm.axis_done[i] == false) &&
+			(cm.a[i].homing_group == cm.a[axis].homing_group)) {
+			size++;
+		}
+	}
+	return (size);
+}
+
+/***********************************************************************************
+ **** HOMING GROUPS ****************************************************************
+ ***********************************************************************************/
+
+/*
+ *	Axes with the same homing group number ($xhg, $yhg...) are homed together. This is
+ *	the same clear / search / latch / zero backoff sequence as single axis homing, run
+ *	as multi-axis moves:
+ *
+ *	  0. Clear any closed switches in the group, repeating until all are open
+ *	  1. Search all axes towards their switches. The first switch to close holds the
+ *		 move; the axes that have not found their switch search again with their
+ *		 remaining travel until every axis is on its switch
+ *	  2. Latch all axes off their switches at latch velocity in one move. The switches
+ *		 don't hold this move; instead cm_homing_switch_latch() records the position of
+ *		 each axis as its switch opens
+ *	  3. Back off each axis from its latch position by its zero backoff and set zero
+ *
+ *	Each axis moves at no more than its own search or latch velocity. The latch position
+ *	is the position captured at the switch edge (see sw_get_edge_position()). If the edge
+ *	was missed it falls back to the runtime position, resolved to the segment.
+ *	Groups use the switch flag table and are not supported with __NEW_SWITCHES.
+ *
+ * cm_homing_switch_latch()		- called from the switch interrupt to record a group latch
+ *								  (or to stop a squared gantry motor - see GANTRY SQUARING)
+ *	_homing_group_start()		- set up every axis in the group
+ *	_homing_group_clear()		- move off switches that are closed at the start
+ *	_homing_group_search()		- search the axes that have not found their switch
+ *	_homing_group_found()		- mark the axes that found their switch, search again if needed
+ *	_homing_group_latch()		- latch all axes off their switches
+ *	_homing_group_zero_backoff()- backoff from the latch positions
+ *	_homing_group_set_zero()	- set zero and finish the group
+ *	_homing_group_move()		- helper that runs a group move, each axis at its own velocity
+ *	_homing_group_restore()		- restore jerk and end the group (also used by exits)
+ */
+
+uint8_t cm_homing_switch_latch(uint8_t sw_num)
+{
+#ifndef __NEW_SWITCHES
+	if (hm.square_pending != 0) {
+		uint8_t latched = 0;
+		uint8_t held = 0;
+		for (uint8_t motor=0; motor<MOTORS; motor++) {
+			if (hm.motor_switch[motor] != sw_num) continue;
+			if (hm.square_pending & (1<<motor)) {
+				latched |= (1<<motor);
+			} else if (hm.square_motors & (1<<motor)) {
+				held |= (1<<motor);
+			}
+		}
+		if ((latched == 0) && (held != 0)) return (true);	// bounce from a motor already stopped
+		if ((latched == 0) || (sw.state[sw_num] != hm.square_target)) return (false);
+		hm.square_pending &= ~latched;
+		st_set_motor_inhibit(st_pre.motor_inhibit | latched);
+		return (hm.square_pending != 0);					// the last motor holds the move
+	}
+#endif
+	if (hm.group_latch == false) return (false);
+	for (uint8_t axis=0; axis<HOMING_AXES; axis++) {
+		if ((hm.g[axis].state == HOMING_AXIS_LATCH) && (hm.g[axis].homing_switch == sw_num)) {
+			float position[AXES];
+			sw_get_edge_position(sw_num, position);			// the edge, or the runtime position if missed
+			hm.g[axis].latch_position = position[axis];
+			hm.g[axis].state = HOMING_AXIS_LATCHED;
+			return (true);
+		}
+	}
+	for (uint8_t axis=0; axis<HOMING_AXES; axis++) {		// swallow bounces from axes already latched
+		if ((hm.g[axis].state == HOMING_AXIS_LATCHED) && (hm.g[axis].homing_switch == sw_num)) {
+			return (true);
+		}
+	}
+	return (false);
+}
+
+#ifndef __NEW_SWITCHES
+
+static stat_t _homing_group_start(int8_t axis)
+{
+	uint8_t group = cm.a[axis].homing_group;
+	uint8_t count = 0;
+
+	hm.square_motors = 0;									// groups are homed without squaring
+
+	for (uint8_t i=0; i<HOMING_AXES; i++) {
+		hm.g[i].state = HOMING_AXIS_IDLE;
+		if ((fp_FALSE(cm.gf.target[i])) || (hm.axis_done[i] == true) ||
+			(cm.a[i].homing_group != group)) {
+			continue;
+		}
+		hm.axis_done[i] = true;
+		hm.g[i].saved_jerk = cm_get_axis_jerk(i);			// save before setup so any exit can restore it
+		stat_t status = _homing_axis_setup(i);
+		if (status == STAT_NOOP) continue;					// homing is disabled for the axis
+		if (status != STAT_OK) return (status);				// error exit has already run
+
+		hm.g[i].homing_switch = hm.homing_switch;
+		hm.g[i].limit_switch = hm.limit_switch;
+		hm.g[i].search_travel = hm.search_travel;
+		hm.g[i].search_velocity = hm.search_velocity;
+		hm.g[i].latch_velocity = hm.latch_velocity;
+		hm.g[i].latch_backoff = hm.latch_backoff;
+		hm.g[i].zero_backoff = hm.zero_backoff;
+		hm.g[i].state = HOMING_AXIS_SEARCH;
+		count++;
+	}
+	hm.axis = axis;
+	if (count == 0) {
+		return (_set_homing_func(_homing_axis_start));
+	}
+	for (uint8_t i=0; i<HOMING_AXES; i++) {					// all axes are good - switch to homing jerk
+		if (hm.g[i].state == HOMING_AXIS_IDLE) continue;
+		cm_set_axis_jerk(i, cm.a[i].jerk_homing);
+	}
+	hm.group_passes = 0;
+	return (_set_homing_func(_homing_group_clear));
+}
+
+static stat_t _homing_group_clear(int8_t axis)
+{
+	float travel[] = {0,0,0,0,0,0};
+	float velocity[] = {0,0,0,0,0,0};
+	uint8_t closed = false;
+
+	for (uint8_t i=0; i<HOMING_AXES; i++) {
+		if (hm.g[i].state == HOMING_AXIS_IDLE) continue;
+		velocity[i] = hm.g[i].search_velocity;
+		if (sw.state[hm.g[i].homing_switch] == SW_CLOSED) {
+			travel[i] = hm.g[i].latch_backoff;
+			closed = true;
+		} else if ((hm.g[i].limit_switch >= 0) && (sw.state[hm.g[i].limit_switch] == SW_CLOSED)) {
+			travel[i] = -hm.g[i].latch_backoff;
+			closed = true;
+		}
+	}
+	if (closed == false) {
+		return (_set_homing_func(_homing_group_search));
+	}
+	if (++hm.group_passes > HOMING_AXES) {					// each pass opens at least one switch
+		return (_set_homing_func(_homing_abort));
+	}
+	_homing_group_move(travel, velocity);
+	return (_set_homing_func(_homing_group_clear));			// clear again until all switches are open
+}
+
+static stat_t _homing_group_search(int8_t axis)
+{
+	float travel[] = {0,0,0,0,0,0};
+	float velocity[] = {0,0,0,0,0,0};
+
+	for (uint8_t i=0; i<HOMING_AXES; i++) {
+		if (hm.g[i].state != HOMING_AXIS_SEARCH) continue;
+		hm.g[i].position = mp_get_runtime_absolute_position(i);
+		travel[i] = hm.g[i].search_travel;
+		velocity[i] = hm.g[i].search_velocity;
+	}
+	_homing_group_move(travel, velocity);
+	return (_set_homing_func(_homing_group_found));
+}
+
+static stat_t _homing_group_found(int8_t axis)
+{
+	uint8_t found = false;
+	uint8_t searching = false;
+
+	for (uint8_t i=0; i<HOMING_AXES; i++) {
+		if (hm.g[i].state == HOMING_AXIS_IDLE) continue;
+		float position = mp_get_runtime_absolute_position(i);
+		cm_set_position(i, position);						// the move may have stopped on a feedhold
+		if (hm.g[i].state != HOMING_AXIS_SEARCH) continue;
+
+		hm.g[i].search_travel -= position - hm.g[i].position;
+		if (sw.state[hm.g[i].homing_switch] == SW_CLOSED) {
+			hm.g[i].state = HOMING_AXIS_LATCH;
+			found = true;
+		} else {
+			searching = true;
+		}
+	}
+	if (found == false) {									// search ran out or was held by something else
+		return (_set_homing_func(_homing_abort));
+	}
+	if (searching == true) {
+		return (_set_homing_func(_homing_group_search));
+	}
+	return (_set_homing_func(_homing_group_latch));
+}
+
+static stat_t _homing_group_latch(int8_t axis)
+{
+	float travel[] = {0,0,0,0,0,0};
+	float velocity[] = {0,0,0,0,0,0};
+
+	for (uint8_t i=0; i<HOMING_AXES; i++) {
+		if (hm.g[i].state == HOMING_AXIS_IDLE) continue;
+		travel[i] = hm.g[i].latch_backoff;
+		velocity[i] = hm.g[i].latch_velocity;
+		sw_clear_edge(hm.g[i].homing_switch);
+	}
+	hm.group_latch = true;									// switches now record instead of hold
+	_homing_group_move(travel, velocity);
+	return (_set_homing_func(_homing_group_zero_backoff));
+}
+
+static stat_t _homing_group_zero_backoff(int8_t axis)
+{
+	float travel[] = {0,0,0,0,0,0};
+	float velocity[] = {0,0,0,0,0,0};
+
+	hm.group_latch = false;
+	for (uint8_t i=0; i<HOMING_AXES; i++) {
+		if (hm.g[i].state == HOMING_AXIS_IDLE) continue;
+		float position = mp_get_runtime_absolute_position(i);
+		cm_set_position(i, position);
+		if (hm.g[i].state != HOMING_AXIS_LATCHED) {			// switch never opened - same as a
+			hm.g[i].latch_position = position;				// single axis latch running its full backoff
+		}
+		travel[i] = hm.g[i].latch_position + hm.g[i].zero_backoff - position;
+		velocity[i] = hm.g[i].search_velocity;
+	}
+	_homing_group_move(travel, velocity);
+	return (_set_homing_func(_homing_group_set_zero));
+}
+
+static stat_t _homing_group_set_zero(int8_t axis)
+{
+	for (uint8_t i=0; i<HOMING_AXES; i++) {
+		if (hm.g[i].state == HOMING_AXIS_IDLE) continue;
+		if (hm.set_coordinates != false) {
+			cm_set_position(i, 0);
+			cm.homed[i] = true;
+		} else {
+			cm_set_position(i, cm_get_work_position(RUNTIME, i));	// do not set axis if in G28.4 cycle
+		}
+	}
+	_homing_group_restore();
+	return (_set_homing_func(_homing_axis_start));
+}
+
+static stat_t _homing_group_move(float travel[], float velocity[])
+{
+	float vect[] = {0,0,0,0,0,0};
+	float flags[] = {false, false, false, false, false, false};
+	float length = 0;
+	float time = 0;
+
+	for (uint8_t i=0; i<HOMING_AXES; i++) {
+		if (fp_ZERO(travel[i])) continue;
+		vect[i] = travel[i];
+		flags[i] = true;
+		length += square(travel[i]);
+		time = max(time, fabs(travel[i]) / velocity[i]);	// slowest axis sets the move time
+	}
+	if (fp_ZERO(time)) return (STAT_NOOP);					// nothing to move
+	cm.gm.feed_rate = sqrt(length) / time;
+	mp_flush_planner();										// don't use cm_request_queue_flush() here
+	cm_request_cycle_start();
+	ritorno(cm_straight_feed(vect, flags));
+	return (STAT_EAGAIN);
+}
+
+#endif // __NEW_SWITCHES
+
+static void _homing_group_restore()
+{
+	hm.group_latch = false;
+	for (uint8_t i=0; i<HOMING_AXES; i++) {
+		if (hm.g[i].state == HOMING_AXIS_IDLE) continue;
+		cm_set_axis_jerk(i, hm.g[i].saved_jerk);
+		hm.g[i].state = HOMING_AXIS_IDLE;
+	}
+}
+
+/***********************************************************************************
+ **** GANTRY SQUARING **************************************************************
+ ***********************************************************************************/
+
+/*
+ *	A ganged axis (e.g. Y driven by motors 2 and 3) is squared during single axis homing
+ *	if any of its motors has its own homing switch ($2hs, $3hs...). Motors left at 0 use
+ *	the axis homing switch. The axis homes as usual, except that:
+ *
+ *	  - The search stops each motor as its switch closes (its step output is inhibited)
+ *		while the other motors keep searching. The last switch to close holds the move.
+ *	  - The latch stops each motor as its switch opens in the same way.
+ *	  - Each motor with a squaring offset ($2so, $3so...) is then moved by its offset on
+ *		its own to take out the difference between its switch and its true square
+ *		position. Positive offsets move away from the switch.
+ *
+ *	The zero backoff then runs with all motors together. If a motor does not find its
+ *	switch within the search travel, or does not come off it within the latch backoff,
+ *	the cycle is aborted. Groups are homed without squaring.
+ *
+ *	A held motor falls behind its commanded steps. The step position is reset to the
+ *	runtime position before every squaring move and when the inhibit is lifted, otherwise
+ *	step correction would nudge the motors back and the following error monitor would trip.
+ *
+ *	_homing_square_setup()	 - find the axis motors and their switches
+ *	_homing_square_pending() - return the axis motors whose switch is not in the target state
+ *	_homing_square_begin()	 - inhibit motors already in the target state, the rest are pending
+ */
+
+#ifndef __NEW_SWITCHES
+
+static stat_t _homing_square_setup(int8_t axis)
+{
+	uint8_t own_switch = false;
+
+	hm.square_motors = 0;
+	hm.square_pending = 0;
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		hm.motor_switch[motor] = -1;
+		if (st_cfg.mot[motor].motor_map != (uint8_t)axis) continue;
+		hm.square_motors |= (1<<motor);
+
+		uint8_t sw_num = st_cfg.mot[motor].homing_switch;
+		if (sw_num == 0) {									// 0 = use the axis homing switch
+			hm.motor_switch[motor] = hm.homing_switch;
+			continue;
+		}
+		if ((sw_num > NUM_SWITCHES) || (get_switch_mode(sw_num-1) == SW_MODE_DISABLED)) {
+			return (_homing_error_exit(axis, STAT_HOMING_ERROR_SWITCH_MISCONFIGURATION));
+		}
+		hm.motor_switch[motor] = sw_num-1;
+		if (hm.limit_switch == hm.motor_switch[motor]) {	// the input is a homing switch now
+			hm.limit_switch = -1;
+		}
+		own_switch = true;
+	}
+	if (own_switch == false) {
+		hm.square_motors = 0;								// nothing to square - home as one axis
+	}
+	return (STAT_OK);
+}
+
+static uint8_t _homing_square_pending(uint8_t target)
+{
+	uint8_t pending = 0;
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		if ((hm.square_motors & (1<<motor)) && (sw.state[hm.motor_switch[motor]] != target)) {
+			pending |= (1<<motor);
+		}
+	}
+	return (pending);
+}
+
+static uint8_t _homing_square_begin(uint8_t target)
+{
+	uint8_t pending = _homing_square_pending(target);
+	mp_set_steps_to_runtime_position();						// drop the lag of motors held by the last move
+	st_set_motor_inhibit(hm.square_motors & ~pending);		// inhibit before the switch hook can run
+	hm.square_target = target;
+	hm.square_pending = pending;
+	return (pending);
+}
+
+#endif // __NEW_SWITCHES
+
+/***********************************************************************************
+ **** Step Loss Calibration Cycle **************************************************
+ ***********************************************************************************/
+
+/*****************************************************************************
+ * cm_calibration_cycle_start() - find the jerk and velocity an axis can run without losing steps
+ *
+ *	Invoked as {"calx":1} (also caly, calz, cala). The axis must have a homing switch and
+ *	valid homing settings; this is checked before anything moves, and the homing error
+ *	status is returned if they are missing.
+ *
+ *	Calibration runs inside the homing state machine so it can use the homing switch
+ *	as its position reference. The axis is homed normally, then:
+ *
+ *	  0. Search back to the switch at latch velocity and record where the move stopped.
+ *		 This is the baseline. The normal latch and zero backoff then re-zero the axis.
+ *	  1. Run a trial: move away from the switch by half the axis travel and back again
+ *		 using the trial jerk and velocity.
+ *	  2. Search to the switch again and compare the stop position to the baseline. If it
+ *		 moved by more than CALIBRATION_TOLERANCE the trial lost steps. With __ENCODERS
+ *		 the peak following error of the axis motors is also checked. The latch and zero
+ *		 backoff re-zero the axis whatever the result.
+ *	  3. Repeat 1 and 2 with increasing jerk and velocity until a trial loses steps or
+ *		 the $ctr trials are done. The sweep runs linearly from CALIBRATION_START_SCALE
+ *		 of the axis' current $xjm and $xvm up to $cjl and $cvl times those values.
+ *
+ *	The highest jerk and velocity that held position are reported, and those values
+ *	times CALIBRATION_MARGIN are set as the new $xjm and $xvm, then persisted once the
+ *	cycle has ended (settings are not written while a cycle is running). Jerk and
+ *	velocity are swept together, so a failure is not attributed to one or the other.
+ *	Short axes may not reach the trial velocity in half their travel; the reported
+ *	velocity is the trial setting, not necessarily the speed that was reached.
+ */
+
+stat_t cm_calibration_cycle_start(uint8_t axis)
+{
+	if (axis >= HOMING_AXES) {
+		return (STAT_HOMING_ERROR_BAD_OR_NO_AXIS);
+	}
+	ritorno(_homing_axis_check(axis));						// the switch is the position reference
+	hm.saved_homing_state = cm.homing_state;
+	ritorno(cm_homing_cycle_start());
+	hm.calibrate = true;
+	hm.cal_axis = axis;
+	hm.trial = 0;
+	hm.step_loss = false;
+	hm.passed_jerk = 0;
+	hm.passed_velocity = 0;
+	hm.saved_velocity_max = cm.a[axis].velocity_max;
+	hm.saved_feedrate_max = cm.a[axis].feedrate_max;
+	return (STAT_OK);
+}
+
+/* Calibration moves - entered from _homing_axis_set_zero() each time the axis is zeroed
+ *	_calibrate_axis_sweep()		- set up the next trial and move away from the switch
+ *	_calibrate_axis_return()	- move back to zero at the trial settings
+ *	_calibrate_axis_search()	- search to the switch with the normal settings restored
+ *	_calibrate_axis_measure()	- compare the stop position to the baseline, then re-latch
+ *	_calibrate_restore_axis()	- restore the velocity settings changed by a trial
+ *	_calibrate_finalize_exit()	- end the cycle, then report and persist the results
+ */
+
+static stat_t _calibrate_axis_sweep(int8_t axis)
+{
+	if (hm.trial == 0) {									// baseline latch, no sweep
+		hm.cal_travel = fabs(cm.a[axis].travel_max - cm.a[axis].travel_min) / 2;
+		if (hm.search_travel > 0) hm.cal_travel = -hm.cal_travel;	// away from the switch
+		return (_set_homing_func(_calibrate_axis_search));
+	}
+	if ((hm.step_loss == true) || (hm.trial > cm.calibration_trials)) {
+		return (_set_homing_func(_homing_axis_start));		// done - axis is zeroed
+	}
+	float scale = 1;
+	if (cm.calibration_trials > 1) {
+		scale = (float)(hm.trial - 1) / (cm.calibration_trials - 1);
+	}
+	hm.trial_jerk = hm.saved_jerk * (CALIBRATION_START_SCALE +
+					scale * (cm.calibration_jerk_limit - CALIBRATION_START_SCALE));
+	hm.trial_velocity = hm.saved_velocity_max * (CALIBRATION_START_SCALE +
+					scale * (cm.calibration_velocity_limit - CALIBRATION_START_SCALE));
+
+	cm_set_axis_jerk(axis, hm.trial_jerk);
+	cm.a[axis].velocity_max = hm.trial_velocity;
+	cm.a[axis].feedrate_max = hm.trial_velocity;
+	_homing_axis_move(axis, hm.cal_travel, hm.trial_velocity);
+	return (_set_homing_func(_calibrate_axis_return));
+}
+
+static stat_t _calibrate_axis_return(int8_t axis)
+{
+	_homing_axis_move(axis, -hm.cal_travel, hm.trial_velocity);
+	return (_set_homing_func(_calibrate_axis_search));
+}
+
+static stat_t _calibrate_axis_search(int8_t axis)
+{
+	_calibrate_restore_axis(axis);
+	cm_set_axis_jerk(axis, cm.a[axis].jerk_homing);
+#ifdef __ENCODERS
+	en_reset_following_error();								// trial peaks are checked at the latch
+#endif
+	_homing_axis_move(axis, hm.search_travel, hm.latch_velocity);
+	return (_set_homing_func(_calibrate_axis_measure));
+}
 
+static stat_t _calibrate_axis_measure(int8_t axis)
+{
+#ifndef __NEW_SWITCHES
+	if (sw.state[hm.homing_switch] != SW_CLOSED)			// search ran out without finding the switch
+		return (_set_homing_func(_homing_abort));
+#else
+	if (read_switch(hm.homing_switch_axis, hm.homing_switch_position) != SW_CLOSED)
+		return (_set_homing_func(_homing_abort));
+#endif
+	float position = mp_get_runtime_absolute_position(axis);
+	cm_set_position(axis, position);						// the search stopped on a feedhold
+
+	if (hm.trial == 0) {
+		hm.latch_position = position;
+	} else {
+		if (fabs(position - hm.latch_position) > CALIBRATION_TOLERANCE) {
+			hm.step_loss = true;
+		}
+#ifdef __ENCODERS
+		for (uint8_t motor=0; motor<MOTORS; motor++) {
+			if ((st_cfg.mot[motor].motor_map == axis) &&
+				(en.fe.peak[motor] / st_cfg.mot[motor].steps_per_unit > CALIBRATION_TOLERANCE)) {
+				hm.step_loss = true;
+			}
+		}
 #endif
+		if (hm.step_loss == false) {
+			hm.passed_jerk = hm.trial_jerk;
+			hm.passed_velocity = hm.trial_velocity;
+		}
+	}
+	hm.trial++;
+	return (_set_homing_func(_homing_axis_latch));			// re-zero the axis from the switch
+}
+
+static void _calibrate_restore_axis(int8_t axis)
+{
+	if (hm.calibrate == false) return;
+	cm.a[axis].velocity_max = hm.saved_velocity_max;
+	cm.a[axis].feedrate_max = hm.saved_feedrate_max;
+}
+
+static stat_t _calibrate_finalize_exit(int8_t axis)
+{
+	char message[NV_MESSAGE_LEN];
+	axis = hm.cal_axis;
+	cm.homing_state = hm.saved_homing_state;
+	nv_reset_nv_list();
+
+	if (fp_ZERO(hm.passed_jerk)) {
+		sprintf_P(message, PSTR("Calibration error - %c axis lost steps at the lowest setting"),
+				  cm_get_axis_char(axis));
+		nv_add_conditional_message((char_t *)message);
+		nv_print_list(STAT_CALIBRATION_FAILED, TEXT_INLINE_VALUES, JSON_RESPONSE_FORMAT);
+		_homing_finalize_exit(axis);
+		return (STAT_CALIBRATION_FAILED);
+	}
+	sprintf_P(message, PSTR("%c axis held jerk %1.0f, velocity %1.0f"),
+			  cm_get_axis_char(axis), hm.passed_jerk, hm.passed_velocity);
+	nv_add_conditional_message((char_t *)message);
+
+	// write back the recommended values as if they had been entered as $xjm and $xvm.
+	// They are set while homing still holds the units in mm...
+	char_t token[] = "xjm";
+	token[0] = "xyzabc"[axis];
+	nvObj_t *jm, *vm;
+	if ((jm = nv_add_object(token)) != NULL) {
+		jm->value = hm.passed_jerk * CALIBRATION_MARGIN;
+		nv_set(jm);
+	}
+	token[1] = 'v';
+	if ((vm = nv_add_object(token)) != NULL) {
+		vm->value = hm.passed_velocity * CALIBRATION_MARGIN;
+		nv_set(vm);
+	}
+	_homing_finalize_exit(axis);
+	if (jm != NULL) nv_persist(jm);							// ...and persisted once the cycle is off
+	if (vm != NULL) nv_persist(vm);
+	nv_print_list(STAT_OK, TEXT_MULTILINE_FORMATTED, JSON_RESPONSE_FORMAT);
+	return (STAT_OK);
 }
 
 /*
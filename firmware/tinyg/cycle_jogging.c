@@ -118,6 +118,21 @@ stat_t cm_jogging_cycle_start(uint8_t axis)
 }
 
 
+/*
+ * cm_request_jogging_cancel() - stop a running jog (realtime jog cancel command)
+ *
+ *	A jog is queued as a series of moves, so cancelling it is a feedhold followed by a
+ *	queue flush. _jogging_finalize_exit() restores the saved state once the runtime has
+ *	stopped. Ignored if no jog is running.
+ */
+
+void cm_request_jogging_cancel(void)
+{
+	if (cm.cycle_state != CYCLE_JOG) return;
+	cm_request_feedhold();
+	cm_request_queue_flush();
+}
+
 /* Jogging axis moves - these execute in sequence for each axis
  * cm_jogging_callback() 		- main loop callback for running the jogging cycle
  *	_set_jogging_func()			- a convenience for setting the next dispatch vector and exiting
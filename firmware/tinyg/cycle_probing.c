@@ -34,6 +34,7 @@
 #include "switch.h"
 #include "util.h"
 #include "planner.h"
+#include "kinematics.h"
 
 /**** Probe singleton structure ****/
 
@@ -41,6 +42,7 @@
 
 struct pbProbingSingleton {						// persistent probing runtime variables
 	stat_t (*func)();							// binding for callback function state machine
+	uint8_t type;								// cmProbeType - G38.2 - G38.5
 
 	// switch configuration
 #ifndef __NEW_SWITCHES
@@ -57,8 +59,16 @@ struct pbProbingSingleton {						// persistent probing runtime variables
 	// state saved from gcode model
 	uint8_t saved_distance_mode;				// G90,G91 global setting
 	uint8_t saved_coord_system;					// G54 - G59 setting
+	uint8_t saved_units_mode;					// G20,G21 - grid probing runs in mm
+	uint8_t saved_feed_rate_mode;				// G93,G94 - grid probing runs in units per minute
+	float saved_feed_rate;						// F setting
 	float saved_jerk[AXES];						// saved and restored for each axis
 
+	// height map grid probing
+	uint8_t grid;								// true if running a height map grid
+	uint8_t point;								// grid point being probed, row major
+	float base_z;								// Z contact at the first point - heights are relative to it
+
 	// probe destination
 	float start_position[AXES];
 	float target[AXES];
@@ -68,12 +78,27 @@ static struct pbProbingSingleton pb;
 
 /**** NOTE: global prototypes and other .h info is located in canonical_machine.h ****/
 
+static int8_t _read_probe();
+static stat_t _probing_report();
+static void _probing_setup();
 static stat_t _probing_init();
 static stat_t _probing_start();
 static stat_t _probing_finish();
+static stat_t _probing_respond();
 static stat_t _probing_finalize_exit();
 static stat_t _probing_error_exit(int8_t axis);
 
+static stat_t _grid_init();
+static stat_t _grid_clearance();
+static stat_t _grid_position();
+static stat_t _grid_probe();
+static stat_t _grid_record();
+static stat_t _grid_store();
+static stat_t _grid_finish();
+static stat_t _grid_finalize_exit();
+static stat_t _grid_error_exit(const char *msg);
+static uint8_t _grid_slope_exceeded(void);
+
 
 /**** HELPERS ***************************************************************************
  * _set_pb_func() - a convenience for setting the next dispatch vector and exiting
@@ -85,10 +110,46 @@ uint8_t _set_pb_func(uint8_t (*func)())
 	return (STAT_EAGAIN);
 }
 
+/*
+ * _read_probe() - return SW_OPEN or SW_CLOSED for the probe input
+ */
+
+static int8_t _read_probe()
+{
+#ifndef __NEW_SWITCHES
+	return (sw.state[pb.probe_switch]);
+#else
+	return (read_switch(pb.probe_switch_axis, pb.probe_switch_position));
+#endif
+}
+
+/*
+ * _probing_report() - report the probe results as a response or as a streamed record ($prbr)
+ *
+ *	Returns STAT_EAGAIN while a streamed record waits for TX room - see rpt_probe_report()
+ */
+
+static stat_t _probing_report()
+{
+	if (cm.probe_report_enable == true) {
+		return (rpt_probe_report());
+	}
+	json_parser("{\"prb\":null}"); // TODO: verify that this is OK to do...
+	return (STAT_OK);
+}
+
 /****************************************************************************************
- * cm_probing_cycle_start()	- G38.2 homing cycle using limit switches
+ * cm_straight_probe()	- G38.2 - G38.5 probing cycle using the probe input ($prbs)
  * cm_probing_callback() 	- main loop callback for running the homing cycle
  *
+ *	G38.2 and G38.3 probe toward the workpiece and stop when the probe makes contact.
+ *	G38.4 and G38.5 probe away from the workpiece and stop when the probe loses contact.
+ *	G38.4 fails the cycle with STAT_PROBE_CYCLE_FAILED if the probe never loses contact.
+ *	G38.2 keeps its original behaviour and, like G38.3 and G38.5, only reports the
+ *	failure in "prbe", so existing programs that test prbe after a G38.2 still run.
+ *	Results are reported with the line number of the probe block - except when G38.4
+ *	fails without $prbr set, where the error is the only response to the line.
+ *
  *	--- Some further details ---
  *
  *	All cm_probe_cycle_start does is prevent any new commands from queueing to the
@@ -106,7 +167,7 @@ uint8_t _set_pb_func(uint8_t (*func)())
  *	to cm_get_runtime_busy() is about.
  */
 
-uint8_t cm_straight_probe(float target[], float flags[])
+uint8_t cm_straight_probe(float target[], float flags[], uint8_t type)
 {
 	// trap zero feed rate condition
 	if ((cm.gm.feed_rate_mode != INVERSE_TIME_MODE) && (fp_ZERO(cm.gm.feed_rate))) {
@@ -123,6 +184,9 @@ uint8_t cm_straight_probe(float target[], float flags[])
 	clear_vector(cm.probe_results);		// clear the old probe position.
 										// NOTE: relying on probe_result will not detect a probe to 0,0,0.
 
+	pb.type = type;
+	pb.grid = false;
+	cm.probe_linenum = cm.gm.linenum;
 	cm.probe_state = PROBE_WAITING;		// wait until planner queue empties before completing initialization
 	pb.func = _probing_init; 			// bind probing initialization function
 	return (STAT_OK);
@@ -154,10 +218,7 @@ static uint8_t _probing_init()
 	cm.probe_state = PROBE_FAILED;
 	cm.cycle_state = CYCLE_PROBE;
 
-	// initialize the axes - save the jerk settings & switch to the jerk_homing settings
 	for( uint8_t axis=0; axis<AXES; axis++ ) {
-		pb.saved_jerk[axis] = cm_get_axis_jerk(axis);	// save the max jerk value
-		cm_set_axis_jerk(axis, cm.a[axis].jerk_homing);	// use the homing jerk for probe
 		pb.start_position[axis] = cm_get_absolute_position(ACTIVE_MODEL, axis);
 	}
 
@@ -170,15 +231,33 @@ static uint8_t _probing_init()
 		if (fp_NE(pb.start_position[axis], pb.target[axis]))
 			_probing_error_exit(axis);
 	}
+	_probing_setup();
+	return (_set_pb_func(_probing_start));							// start the move
+}
+
+/*
+ * _probing_setup() - setup shared by G38.2 and grid probing
+ *
+ *	Saves the jerk, switch, coordinate system and distance mode settings that
+ *	_probe_restore_settings() puts back, and stops the spindle.
+ */
+
+static void _probing_setup()
+{
+	// initialize the axes - save the jerk settings & switch to the jerk_homing settings
+	for( uint8_t axis=0; axis<AXES; axis++ ) {
+		pb.saved_jerk[axis] = cm_get_axis_jerk(axis);	// save the max jerk value
+		cm_set_axis_jerk(axis, cm.a[axis].jerk_homing);	// use the homing jerk for probe
+	}
 
 	// initialize the probe switch
 
-    // switch the switch type mode for the probe
-    // FIXME: we should be able to use the homing switch at this point too,
-	// Can't because switch mode is global and our probe is NO, not NC.
+	// The probe input is selected by $prbs, so it may share a homing switch input.
+	// It is set to homing mode and NO for the cycle and restored after. With the old
+	// switch code the switch type is global, so NC switches read inverted while probing.
 
 #ifndef __NEW_SWITCHES	// old style switch code:
-	pb.probe_switch = SW_MIN_Z;										// FIXME: hardcoded...
+	pb.probe_switch = cm.probe_switch;								// $prbs
 	pb.saved_switch_mode = sw.mode[pb.probe_switch];
 
 	sw.mode[pb.probe_switch] = SW_MODE_HOMING;
@@ -186,8 +265,8 @@ static uint8_t _probing_init()
 	sw.switch_type = SW_TYPE_NORMALLY_OPEN;							// contact probes are NO switches... usually
 	switch_init();													// re-init to pick up new switch settings
 #else // new style switch code:
-	pb.probe_switch_axis = AXIS_Z;									// FIXME: hardcoded...
-	pb.probe_switch_position = SW_MIN;								// FIXME: hardcoded...
+	pb.probe_switch_axis = cm.probe_switch / SW_POSITIONS;			// $prbs in swNums order:
+	pb.probe_switch_position = cm.probe_switch % SW_POSITIONS;		// X min, X max, Y min...
 
 	pb.saved_switch_mode = sw.s[pb.probe_switch_axis][pb.probe_switch_position].mode;
 	sw.s[pb.probe_switch_axis][pb.probe_switch_position].mode = SW_MODE_HOMING;
@@ -204,7 +283,6 @@ static uint8_t _probing_init()
 	cm_set_coord_system(ABSOLUTE_COORDS);
 
 	cm_spindle_control(SPINDLE_OFF);
-	return (_set_pb_func(_probing_start));							// start the move
 }
 
 /*
@@ -213,41 +291,60 @@ static uint8_t _probing_init()
 
 static stat_t _probing_start()
 {
-	// initial probe state, don't probe if we're already contacted!
+	// initial probe state, don't probe if we're already contacted (or clear, probing away)!
+	int8_t contact = (pb.type & PROBE_AWAY_BIT) ? SW_OPEN : SW_CLOSED;
+
+    if( _read_probe() != contact ) {
 #ifndef __NEW_SWITCHES
-	int8_t probe = sw.state[pb.probe_switch];
-#else
-	int8_t probe = read_switch(pb.probe_switch_axis, pb.probe_switch_position);
+		sw_clear_edge(pb.probe_switch);							// capture the contact edge
 #endif
-
-    if( probe==SW_OPEN ) {
         ritorno(cm_straight_feed(pb.target, pb.flags));
     }
 	return (_set_pb_func(_probing_finish));
 }
 
 /*
- * _probing_finish()
+ * _probing_finish()  - record the probe results
+ * _probing_respond() - report them, once there is TX room for the report
  */
 
 static stat_t _probing_finish()
 {
+	int8_t contact = (pb.type & PROBE_AWAY_BIT) ? SW_OPEN : SW_CLOSED;
+	cm.probe_state = (_read_probe() == contact) ? PROBE_SUCCEEDED : PROBE_FAILED;
+
+	// the results are where the probe made contact, captured at the switch edge, if available
+	float edge_position[AXES];
+	uint8_t edge_captured = false;
 #ifndef __NEW_SWITCHES
-	int8_t probe = sw.state[pb.probe_switch];
-#else
-	int8_t probe = read_switch(pb.probe_switch_axis, pb.probe_switch_position);
+	if (cm.probe_state == PROBE_SUCCEEDED) {
+		edge_captured = sw_get_edge_position(pb.probe_switch, edge_position);
+	}
 #endif
-	cm.probe_state = (probe==SW_CLOSED) ? PROBE_SUCCEEDED : PROBE_FAILED;
-
 	for( uint8_t axis=0; axis<AXES; axis++ ) {
 		// if we got here because of a feed hold we need to keep the model position correct
 		cm_set_position(axis, mp_get_runtime_work_position(axis));
 
 		// store the probe results
-		cm.probe_results[axis] = cm_get_absolute_position(ACTIVE_MODEL, axis);
+		if (edge_captured == true) {
+			cm.probe_results[axis] = edge_position[axis];
+		} else {
+			cm.probe_results[axis] = cm_get_absolute_position(ACTIVE_MODEL, axis);
+		}
 	}
 
-	json_parser("{\"prb\":null}"); // TODO: verify that this is OK to do...
+	return (_set_pb_func(_probing_respond));
+}
+
+static stat_t _probing_respond()
+{
+	if ((cm.probe_state == PROBE_FAILED) && (pb.type == PROBE_AWAY_WITH_ERROR)) {
+		if (cm.probe_report_enable == true) {
+			ritorno(rpt_probe_report());		// a streamed record, not a second response
+		}
+		return (_probing_error_exit(-3));		// G38.4 fails the cycle
+	}
+	ritorno(_probing_report());
 	// printf_P(PSTR("{\"prb\":{\"e\":%i"), (int)cm.probe_state);
 	// if (pb.flags[AXIS_X]) printf_P(PSTR(",\"x\":%0.3f"), cm.probe_results[AXIS_X]);
 	// if (pb.flags[AXIS_Y]) printf_P(PSTR(",\"y\":%0.3f"), cm.probe_results[AXIS_Y]);
@@ -287,6 +384,11 @@ static void _probe_restore_settings()
 	// restore coordinate system and distance mode
 	cm_set_coord_system(pb.saved_coord_system);
 	cm_set_distance_mode(pb.saved_distance_mode);
+	if (pb.grid == true) {						// restore units and feed rate changed by grid probing
+		cm_set_units_mode(pb.saved_units_mode);
+		cm_set_feed_rate_mode(pb.saved_feed_rate_mode);
+		cm.gm.feed_rate = pb.saved_feed_rate;
+	}
 
 	// update the model with actual position
 	cm_set_motion_mode(MODEL, MOTION_MODE_CANCEL_MOTION_MODE);
@@ -304,17 +406,229 @@ static stat_t _probing_error_exit(int8_t axis)
 {
 	// Generate the warning message. Since the error exit returns via the probing callback
 	// - and not the main controller - it requires its own display processing
+	char message[NV_MESSAGE_LEN];
 	nv_reset_nv_list();
 	if (axis == -2) {
-		nv_add_conditional_message((const char_t *)"Probing error - invalid probe destination");
+		strcpy_P(message, PSTR("Probing error - invalid probe destination"));
+	} else if (axis == -3) {
+		strcpy_P(message, PSTR("Probing error - probe did not change state"));
 	} else {
-		char message[NV_MESSAGE_LEN];
 		sprintf_P(message, PSTR("Probing error - %c axis cannot move during probing"), cm_get_axis_char(axis));
-		nv_add_conditional_message((char_t *)message);
 	}
+	nv_add_conditional_message((char_t *)message);
 	nv_print_list(STAT_PROBE_CYCLE_FAILED, TEXT_INLINE_VALUES, JSON_RESPONSE_FORMAT);
 
 	// clean up and exit
 	_probe_restore_settings();
 	return (STAT_PROBE_CYCLE_FAILED);
 }
+
+
+/****************************************************************************************
+ * HEIGHT MAP GRID PROBING
+ *
+ * cm_probe_grid_start() - {"hmpr":1} probe the kin.map grid and load the height map
+ *
+ *	Probes columns x rows points, row major starting at the origin, in machine
+ *	coordinates. Each point is approached at the clearance height, then probed
+ *	down to the probe depth at the map feed rate. Heights are stored relative
+ *	to the first point so the map can be used with any work offset in Z.
+ *	Compensation is off while probing and is enabled (if $hmpe is set) once
+ *	the last point is recorded. Each point is reported as a "prb" result.
+ *
+ *	Any point that fails to make contact aborts the cycle and leaves the map empty.
+ *	So does a point that is too steep against its neighbours - see _grid_slope_exceeded().
+ */
+
+stat_t cm_probe_grid_start()
+{
+	kinHeightMap_t *map = &kin.map;
+
+	if ((map->columns < 2) || (map->rows < 2) || (map->columns * map->rows > HEIGHT_MAP_MAX_POINTS))
+		return (STAT_INPUT_VALUE_RANGE_ERROR);
+	if (fp_ZERO(map->spacing_x) || fp_ZERO(map->spacing_y) || (map->feed_rate < EPSILON))
+		return (STAT_INPUT_VALUE_RANGE_ERROR);
+	if (map->probe_depth >= map->clearance)
+		return (STAT_INPUT_VALUE_RANGE_ERROR);
+
+	map->points = 0;					// discard the old map and turn off compensation while probing
+	kin_height_map_update();
+
+	pb.type = PROBE_TOWARD_REPORTED;
+	pb.grid = true;
+	pb.point = 0;
+	cm.probe_linenum = cm.gm.linenum;
+	clear_vector(cm.probe_results);
+	cm.probe_state = PROBE_WAITING;		// wait until planner queue empties before completing initialization
+	pb.func = _grid_init;
+	return (STAT_OK);
+}
+
+/*
+ * _grid_move() - queue one move of the grid cycle in machine coordinates
+ *
+ *	The previous move may have ended on a probe contact, so flush the remains
+ *	of it and restart the cycle before queuing the next one.
+ */
+
+static stat_t _grid_move(uint8_t axis, float position, uint8_t traverse)
+{
+	float vect[] = {0,0,0,0,0,0};
+	float flags[] = {false, false, false, false, false, false};
+
+	vect[axis] = position;
+	flags[axis] = true;
+	mp_flush_planner();
+	cm_request_cycle_start();
+	if (traverse == true) {
+		return (cm_straight_traverse(vect, flags));
+	}
+	return (cm_straight_feed(vect, flags));
+}
+
+static stat_t _grid_init()
+{
+	cm.probe_state = PROBE_FAILED;
+	cm.cycle_state = CYCLE_PROBE;
+	_probing_setup();
+
+	// probe in mm at the map feed rate
+	pb.saved_units_mode = cm_get_units_mode(ACTIVE_MODEL);
+	pb.saved_feed_rate_mode = cm_get_feed_rate_mode(ACTIVE_MODEL);
+	pb.saved_feed_rate = cm_get_feed_rate(ACTIVE_MODEL);
+	cm_set_units_mode(MILLIMETERS);
+	cm_set_feed_rate_mode(UNITS_PER_MINUTE_MODE);
+	cm.gm.feed_rate = kin.map.feed_rate;
+	return (_set_pb_func(_grid_clearance));
+}
+
+static stat_t _grid_clearance()					// lift to the clearance height
+{
+	ritorno(_grid_move(AXIS_Z, kin.map.clearance, true));
+	return (_set_pb_func(_grid_position));
+}
+
+static stat_t _grid_position()					// traverse to the next point
+{
+	float vect[] = {0,0,0,0,0,0};
+	float flags[] = {true, true, false, false, false, false};
+
+	vect[AXIS_X] = kin.map.origin_x + (pb.point % kin.map.columns) * kin.map.spacing_x;
+	vect[AXIS_Y] = kin.map.origin_y + (pb.point / kin.map.columns) * kin.map.spacing_y;
+	ritorno(cm_straight_traverse(vect, flags));
+	return (_set_pb_func(_grid_probe));
+}
+
+static stat_t _grid_probe()						// probe down to the probe depth
+{
+	if (_read_probe() == SW_CLOSED) {
+		return (_grid_error_exit(PSTR("Probing error - probe closed before grid point")));
+	}
+#ifndef __NEW_SWITCHES
+	sw_clear_edge(pb.probe_switch);				// capture the contact edge
+#endif
+	ritorno(_grid_move(AXIS_Z, kin.map.probe_depth, false));
+	return (_set_pb_func(_grid_record));
+}
+
+static stat_t _grid_record()					// record the point
+{
+	if (_read_probe() != SW_CLOSED) {
+		return (_grid_error_exit(PSTR("Probing error - no contact at grid point")));
+	}
+
+	float edge_position[AXES];
+	uint8_t edge_captured = false;
+#ifndef __NEW_SWITCHES
+	edge_captured = sw_get_edge_position(pb.probe_switch, edge_position);
+#endif
+	for( uint8_t axis=0; axis<AXES; axis++ ) {
+		cm_set_position(axis, mp_get_runtime_absolute_position(axis));	// the move stopped on a feedhold
+		cm.probe_results[axis] = (edge_captured == true) ? edge_position[axis] :
+														   cm_get_absolute_position(ACTIVE_MODEL, axis);
+	}
+	cm.probe_state = PROBE_SUCCEEDED;
+	return (_set_pb_func(_grid_store));
+}
+
+static stat_t _grid_store()						// report the point, add it to the map and move on
+{
+	ritorno(_probing_report());					// report each point as it is probed
+
+	float z = cm.probe_results[AXIS_Z];
+	if (pb.point == 0) {
+		pb.base_z = z;
+	}
+	float height = (z - pb.base_z) * HEIGHT_MAP_SCALE;
+	if ((height > INT16_MAX) || (height < INT16_MIN)) {
+		return (_grid_error_exit(PSTR("Probing error - grid height out of range")));
+	}
+	kin.map.height[pb.point] = (int16_t)lround(height);
+	if (_grid_slope_exceeded() == true) {
+		return (_grid_error_exit(PSTR("Probing error - grid slope too steep to compensate")));
+	}
+
+	if (++pb.point < kin.map.columns * kin.map.rows) {
+		return (_set_pb_func(_grid_clearance));
+	}
+	return (_set_pb_func(_grid_finish));
+}
+
+static stat_t _grid_finish()					// retract and load the map
+{
+	ritorno(_grid_move(AXIS_Z, kin.map.clearance, true));
+	kin.map.points = pb.point;
+	return (_set_pb_func(_grid_finalize_exit));
+}
+
+static stat_t _grid_finalize_exit()
+{
+	_probe_restore_settings();
+	kin_height_map_update();					// turns on compensation if enabled
+	return (STAT_OK);
+}
+
+static stat_t _grid_error_exit(const char *msg)	// msg is a PROGMEM string
+{
+	char message[NV_MESSAGE_LEN];
+	strcpy_P(message, msg);
+	nv_reset_nv_list();
+	nv_add_conditional_message((char_t *)message);
+	nv_print_list(STAT_PROBE_CYCLE_FAILED, TEXT_INLINE_VALUES, JSON_RESPONSE_FORMAT);
+
+	cm.probe_state = PROBE_FAILED;
+	_probe_restore_settings();
+	kin.map.points = 0;
+	kin_height_map_update();
+	return (STAT_PROBE_CYCLE_FAILED);
+}
+
+/*
+ * _grid_slope_exceeded() - true if the last point is too steep against its X or Y neighbour
+ *
+ *	Z compensation is added in the inverse kinematics, after planning, so the Z motion
+ *	it adds is not seen by the planner's Z velocity and jerk limits. Within a cell Z
+ *	moves at the map slope times the XY velocity (and jerk); at a cell edge the slope
+ *	changes and Z takes a velocity step the planner doesn't know about. The slope is
+ *	held under HEIGHT_MAP_MAX_SLOPE and under the Z to XY ratio of the axis velocity and
+ *	jerk limits, which keeps both effects within the Z limits.
+ */
+
+static uint8_t _grid_slope_exceeded()
+{
+	float slope_max = min3(HEIGHT_MAP_MAX_SLOPE,
+		cm.a[AXIS_Z].velocity_max / max(cm.a[AXIS_X].velocity_max, cm.a[AXIS_Y].velocity_max),
+		cm.a[AXIS_Z].jerk_max / max(cm.a[AXIS_X].jerk_max, cm.a[AXIS_Y].jerk_max));
+	uint8_t column = pb.point % kin.map.columns;
+	const int16_t *h = &kin.map.height[pb.point];
+
+	if ((column > 0) &&
+		(fabs((h[0] - h[-1]) / (HEIGHT_MAP_SCALE * kin.map.spacing_x)) > slope_max)) {
+		return (true);
+	}
+	if ((pb.point >= kin.map.columns) &&
+		(fabs((h[0] - h[-kin.map.columns]) / (HEIGHT_MAP_SCALE * kin.map.spacing_y)) > slope_max)) {
+		return (true);
+	}
+	return (false);
+}
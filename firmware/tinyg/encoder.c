@@ -27,7 +27,13 @@
 
 #include "tinyg.h"
 #include "config.h"
+#include "settings.h"
+#include "stepper.h"
 #include "encoder.h"
+#include "hardware.h"
+#include "canonical_machine.h"
+#include "text_parser.h"
+#include "util.h"
 
 #ifdef __cplusplus
 extern "C"{
@@ -49,6 +55,17 @@ void encoder_init()
 {
 	memset(&en, 0, sizeof(en));		// clear all values, pointers and status
 	encoder_init_assertions();
+
+#if defined(__ENCODERS) && defined(__AVR)
+	ENCODER_PORT.DIRCLR = (3 << ENCODER_PIN_bp);				// phase A and B are inputs
+	*(&ENCODER_PORT.PIN0CTRL + ENCODER_PIN_bp) = PORT_ISC_LEVEL_gc;		// QDEC needs level sensing
+	*(&ENCODER_PORT.PIN0CTRL + ENCODER_PIN_bp + 1) = PORT_ISC_LEVEL_gc;
+	EVSYS.CH0MUX = ENCODER_EVSYS_CHMUX;						// phase A pin; B is the next pin up
+	EVSYS.CH0CTRL = EVSYS_QDEN_bm | EVSYS_DIGFILT_2SAMPLES_gc;
+	TIMER_5.CTRLD = TC_EVACT_QDEC_gc | TC_EVSEL_CH0_gc;		// count on the decoded events
+	TIMER_5.PER = 0xFFFF;
+	TIMER_5.CTRLA = TC_CLKSEL_DIV1_gc;
+#endif
 }
 
 /*
@@ -75,11 +92,31 @@ stat_t encoder_test_assertions()
  *	Sets the encoder_position steps. Takes floating point steps as input,
  *	writes integer steps. So it's not an exact representation of machine
  *	position except if the machine is at zero.
+ *
+ *	With __ENCODERS the base is taken from the live hardware count, not the count cached
+ *	at the last latch, so counts that arrived since then aren't lost. Interrupts are held
+ *	off so the loader can't latch part way through.
  */
 
 void en_set_encoder_steps(uint8_t motor, float steps)
 {
+#ifdef __AVR
+	uint8_t sreg = SREG;
+	cli();
+#endif
 	en.en[motor].encoder_steps = (int32_t)round(steps);
+#if defined(__ENCODERS) && defined(__AVR)
+	if (motor == ENCODER_MOTOR) {
+		uint16_t count = TIMER_5.CNT;
+		en.qd.counts += (int16_t)(count - en.qd.count_prev);
+		en.qd.count_prev = count;
+		en.qd.base_counts = en.qd.counts;
+		en.qd.base_steps = steps;
+	}
+#endif
+#ifdef __AVR
+	SREG = sreg;
+#endif
 }
 
 /*
@@ -96,12 +133,158 @@ float en_read_encoder(uint8_t motor)
 {
 	return((float)en.en[motor].encoder_steps);
 }
+
+/*
+ * en_latch_encoders() - latch hardware encoder counts (called from the loader)
+ *
+ *	Replaces the counted steps of ENCODER_MOTOR with the measured position. The 16 bit
+ *	hardware count is extended by adding the signed difference from the previous latch.
+ */
+
+void en_latch_encoders()
+{
+#if defined(__ENCODERS) && defined(__AVR)
+	uint16_t count = TIMER_5.CNT;
+	en.qd.counts += (int16_t)(count - en.qd.count_prev);
+	en.qd.count_prev = count;
+	en.en[ENCODER_MOTOR].encoder_steps = (int32_t)round(en.qd.base_steps +
+		(en.qd.counts - en.qd.base_counts) * ENCODER_STEPS_PER_COUNT);
+#endif
+}
+
+/*
+ * en_capture_steps() - snapshot the step position of every motor right now
+ *
+ *	Called from the switch pin interrupt to record where the motors were at the edge.
+ *	Adds the steps counted by the DDA in the running segment to the accumulated position,
+ *	so the result is exact to the step rather than to the segment. With __ENCODERS the
+ *	hardware count is read without disturbing the loader's latch. Interrupts are held off
+ *	so the DDA and the loader can't update the counts part way through.
+ */
+
+void en_capture_steps(int32_t steps[])
+{
+#ifdef __AVR
+	uint8_t sreg = SREG;
+	cli();
+#endif
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		steps[motor] = en.en[motor].encoder_steps + en.en[motor].steps_run;
+	}
+#if defined(__ENCODERS) && defined(__AVR)
+	int32_t counts = en.qd.counts + (int16_t)(TIMER_5.CNT - en.qd.count_prev);
+	steps[ENCODER_MOTOR] = (int32_t)round(en.qd.base_steps +
+		(counts - en.qd.base_counts) * ENCODER_STEPS_PER_COUNT);
+#endif
+#ifdef __AVR
+	SREG = sreg;
+#endif
+}
+
+/*
+ * FOLLOWING ERROR MONITOR
+ *
+ * en_monitor_following_error() - record one segment of following error (called from exec)
+ * en_reset_following_error()	- clear peaks and the alarm latch at the start of a cycle
+ * en_following_error_callback() - raise the alarm from the main loop
+ *
+ *	Each segment the absolute error of every motor goes into a short ring buffer. The RMS
+ *	is computed from the ring only when it's read for a report, so the exec interrupt only
+ *	pays for a store, a compare and a count. If a motor stays over the threshold for the
+ *	configured number of consecutive segments the alarm is posted once for the cycle.
+ *	$fen must be at least 1 - a setting of 1 alarms on the first segment over threshold.
+ *	It's raised from the main loop: a feedhold is requested and the machine is put in
+ *	soft alarm. With step counting the error is a numerical artifact well under a step,
+ *	so this is mostly useful with __ENCODERS.
+ */
+
+void en_monitor_following_error(const float following_error[])
+{
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		float error = fabs(following_error[motor]);
+		if (st_pre.motor_inhibit & (1<<motor)) {			// held by gantry squaring - not an error
+			error = 0;
+		}
+		en.fe.history[en.fe.index][motor] = (int16_t)min(error * FE_HISTORY_SCALE, 32767);
+		if (error > en.fe.peak[motor]) {
+			en.fe.peak[motor] = error;
+		}
+		if ((en.fe.threshold > 0) && (error > en.fe.threshold)) {
+			if ((++en.fe.count[motor] >= en.fe.segments) && (en.fe.alarm_latched == false)) {
+				en.fe.alarm_motor = motor+1;
+				en.fe.alarm_latched = true;
+			}
+		} else {
+			en.fe.count[motor] = 0;
+		}
+	}
+	if (++en.fe.index >= FE_HISTORY_LEN) {
+		en.fe.index = 0;
+	}
+}
+
+void en_reset_following_error()
+{
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		en.fe.peak[motor] = 0;
+		en.fe.count[motor] = 0;
+	}
+	en.fe.alarm_latched = false;
+}
+
+stat_t en_following_error_callback()
+{
+	if (en.fe.alarm_motor == 0)
+		return (STAT_NOOP);
+	en.fe.alarm_motor = 0;
+	cm_request_feedhold();
+	return (cm_soft_alarm(STAT_FOLLOWING_ERROR_EXCEEDED));
+}
 
 /***********************************************************************************
  * CONFIGURATION AND INTERFACE FUNCTIONS
  * Functions to get and set variables from the cfgArray table
  ***********************************************************************************/
 
+/*
+ * en_get_fer() - get RMS following error in steps over the history (fer1 - fer6)
+ * en_get_fep() - get peak following error in steps for the cycle (fep1 - fep6)
+ * en_set_fen() - set consecutive segments to alarm - zero is rejected
+ */
+
+static uint8_t _get_fe_motor(const nvObj_t *nv)
+{
+	return (nv->token[3] - '1');
+}
+
+stat_t en_get_fer(nvObj_t *nv)
+{
+	uint8_t motor = _get_fe_motor(nv);
+	float sum = 0;
+
+	for (uint8_t i=0; i<FE_HISTORY_LEN; i++) {
+		sum += square((float)en.fe.history[i][motor]);
+	}
+	nv->value = sqrt(sum / FE_HISTORY_LEN) / FE_HISTORY_SCALE;
+	nv->precision = GET_TABLE_WORD(precision);
+	nv->valuetype = TYPE_FLOAT;
+	return (STAT_OK);
+}
+
+stat_t en_get_fep(nvObj_t *nv)
+{
+	nv->value = en.fe.peak[_get_fe_motor(nv)];
+	nv->precision = GET_TABLE_WORD(precision);
+	nv->valuetype = TYPE_FLOAT;
+	return (STAT_OK);
+}
+
+stat_t en_set_fen(nvObj_t *nv)
+{
+	if (nv->value < 1) { return (STAT_INPUT_LESS_THAN_MIN_VALUE);}
+	return (set_ui8(nv));
+}
+
 /***********************************************************************************
  * TEXT MODE SUPPORT
  * Functions to print variables from the cfgArray table
@@ -109,6 +292,16 @@ float en_read_encoder(uint8_t motor)
 
 #ifdef __TEXT_MODE
 
+static const char fmt_fer[] PROGMEM = "Motor %c RMS following error:%8.2f steps\n";
+static const char fmt_fep[] PROGMEM = "Motor %c peak following error:%7.2f steps\n";
+static const char fmt_fet[] PROGMEM = "[fet] following error threshold%8.2f steps\n";
+static const char fmt_fen[] PROGMEM = "[fen] following error segments%6d\n";
+
+void en_print_fer(nvObj_t *nv) { fprintf_P(stderr, fmt_fer, nv->token[3], nv->value);}
+void en_print_fep(nvObj_t *nv) { fprintf_P(stderr, fmt_fep, nv->token[3], nv->value);}
+void en_print_fet(nvObj_t *nv) { text_print_flt(nv, fmt_fet);}
+void en_print_fen(nvObj_t *nv) { text_print_ui8(nv, fmt_fen);}
+
 #endif // __TEXT_MODE
 
 #ifdef __cplusplus
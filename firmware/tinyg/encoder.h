@@ -27,10 +27,20 @@
 /*
  * ENCODERS
  *
- *	Calling this file "encoders" is kind of a lie, at least for now. There are no encoders.
- *	Instead the steppers count steps to provide a "truth" reference for position. In the
- *	future when we have real encoders we'll stop counting steps and actually measure the
- *	position. Which should be a lot easier than how this module currently works.
+ *	By default there are no encoders. Instead the steppers count steps to provide a
+ *	"truth" reference for position.
+ *
+ *	With __ENCODERS one motor (ENCODER_MOTOR) is read from a real quadrature encoder.
+ *	On the Xmega the A/B phases go to two adjacent pins of ENCODER_PORT, and the event
+ *	system's quadrature decoder counts them into TIMER_5 with no CPU involvement. The
+ *	16 bit count is latched once per segment in the loader, when the steps for the previous
+ *	segment have completed, so it lines up with the counted steps of the other motors.
+ *	Counts are scaled to motor steps by ENCODER_STEPS_PER_COUNT, which is negative if the
+ *	encoder counts the opposite way to the motor. The count must not change by more than
+ *	32767 in one segment. Platforms without the decoder keep counting steps.
+ *
+ *	The result flows through following_error into the __STEP_CORRECTION path in
+ *	st_prep_line(), so lost steps are nudged back over the next few segments.
  *
  *	*** Measuring position ***
  *
@@ -94,6 +104,9 @@ extern "C"{
 
 /**** Configs and Constants ****/
 
+#define FE_HISTORY_LEN		8		// segments of following error kept for the RMS
+#define FE_HISTORY_SCALE	16		// history is stored in 1/16 steps (saturates at 2047 steps)
+
 /**** Macros ****/
 // used to abstract the encoder code out of the stepper so it can be managed in one place
 
@@ -101,6 +114,15 @@ extern "C"{
 #define INCREMENT_ENCODER(m)		en.en[m].steps_run += en.en[m].step_sign;
 #define ACCUMULATE_ENCODER(m)		en.en[m].encoder_steps += en.en[m].steps_run; en.en[m].steps_run = 0;
 
+#if defined(__ENCODERS) && defined(__AVR)
+#ifdef __DISPATCH_PROFILE
+#error "__ENCODERS and __DISPATCH_PROFILE both use TIMER_5"
+#endif
+#define LATCH_ENCODERS()			en_latch_encoders();	// call after ACCUMULATE_ENCODER()
+#else
+#define LATCH_ENCODERS()
+#endif
+
 /**** Structures ****/
 
 typedef struct enEncoder { 			// one real or virtual encoder per controlled motor
@@ -109,9 +131,32 @@ typedef struct enEncoder { 			// one real or virtual encoder per controlled moto
 	int32_t encoder_steps;			// counted encoder position	in steps
 } enEncoder_t;
 
+typedef struct enQuadrature {		// hardware quadrature decoder state (__ENCODERS only)
+	uint16_t count_prev;			// hardware count at the previous latch
+	int32_t counts;					// extended count
+	int32_t base_counts;			// extended count when the encoder was last set...
+	float base_steps;				// ...and the step position it was set to
+} enQuadrature_t;
+
+typedef struct enFollowingError {	// following error monitor
+	float threshold;				// $fet - steps of error to alarm on, 0 disables
+	uint8_t segments;				// $fen - consecutive segments over threshold to alarm
+
+	int16_t history[FE_HISTORY_LEN][MOTORS];// recent |following error| in 1/FE_HISTORY_SCALE steps
+	uint8_t index;					// next history slot to write
+	float peak[MOTORS];				// peak |following error| in steps since the cycle started
+	uint8_t count[MOTORS];			// consecutive segments over threshold
+	uint8_t alarm_motor;			// motor number (1-n) that tripped, 0 if none pending
+	uint8_t alarm_latched;			// set once per cycle so the alarm is not repeated
+} enFollowingError_t;
+
 typedef struct enEncoders {
 	magic_t magic_start;
 	enEncoder_t en[MOTORS];			// runtime encoder structures
+	enFollowingError_t fe;
+#ifdef __ENCODERS
+	enQuadrature_t qd;
+#endif
 	magic_t magic_end;
 } enEncoders_t;
 
@@ -126,6 +171,28 @@ stat_t encoder_test_assertions(void);
 
 void en_set_encoder_steps(uint8_t motor, float steps);
 float en_read_encoder(uint8_t motor);
+void en_latch_encoders(void);
+void en_capture_steps(int32_t steps[]);
+
+void en_monitor_following_error(const float following_error[]);
+void en_reset_following_error(void);
+stat_t en_following_error_callback(void);
+
+stat_t en_get_fer(nvObj_t *nv);
+stat_t en_get_fep(nvObj_t *nv);
+stat_t en_set_fen(nvObj_t *nv);
+
+#ifdef __TEXT_MODE
+	void en_print_fer(nvObj_t *nv);
+	void en_print_fep(nvObj_t *nv);
+	void en_print_fet(nvObj_t *nv);
+	void en_print_fen(nvObj_t *nv);
+#else
+	#define en_print_fer tx_print_stub
+	#define en_print_fep tx_print_stub
+	#define en_print_fet tx_print_stub
+	#define en_print_fen tx_print_stub
+#endif // __TEXT_MODE
 
 #endif	// End of include guard: ENCODER_H_ONCE
 
@@ -290,6 +290,9 @@ static stat_t _parse_gcode_block(char_t *buf)
 				case 38: {
 					switch (_point(value)) {
 						case 2: SET_NON_MODAL (next_action, NEXT_ACTION_STRAIGHT_PROBE);
+						case 3: SET_NON_MODAL (next_action, NEXT_ACTION_STRAIGHT_PROBE_NO_ERROR);
+						case 4: SET_NON_MODAL (next_action, NEXT_ACTION_STRAIGHT_PROBE_AWAY);
+						case 5: SET_NON_MODAL (next_action, NEXT_ACTION_STRAIGHT_PROBE_AWAY_NO_ERROR);
 						default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
 					}
 					break;
@@ -479,7 +482,10 @@ static stat_t _execute_gcode_block()
 		case NEXT_ACTION_SET_ABSOLUTE_ORIGIN: { status = cm_set_absolute_origin(cm.gn.target, cm.gf.target); break;}// G28.3
 		case NEXT_ACTION_HOMING_NO_SET: { status = cm_homing_cycle_start_no_set(); break;}							// G28.4
 
-		case NEXT_ACTION_STRAIGHT_PROBE: { status = cm_straight_probe(cm.gn.target, cm.gf.target); break;}			// G38.2
+		case NEXT_ACTION_STRAIGHT_PROBE: { status = cm_straight_probe(cm.gn.target, cm.gf.target, PROBE_TOWARD_REPORTED); break;}	// G38.2
+		case NEXT_ACTION_STRAIGHT_PROBE_NO_ERROR: { status = cm_straight_probe(cm.gn.target, cm.gf.target, PROBE_TOWARD); break;}	// G38.3
+		case NEXT_ACTION_STRAIGHT_PROBE_AWAY: { status = cm_straight_probe(cm.gn.target, cm.gf.target, PROBE_AWAY_WITH_ERROR); break;}	// G38.4
+		case NEXT_ACTION_STRAIGHT_PROBE_AWAY_NO_ERROR: { status = cm_straight_probe(cm.gn.target, cm.gf.target, PROBE_AWAY); break;}	// G38.5
 
 		case NEXT_ACTION_SET_COORD_DATA: { status = cm_set_coord_offsets(cm.gn.parameter, cm.gn.target, cm.gf.target); break;}
 		case NEXT_ACTION_SET_ORIGIN_OFFSETS: { status = cm_set_origin_offsets(cm.gn.target, cm.gf.target); break;}
@@ -31,6 +31,7 @@
 #include "json_parser.h"
 #include "text_parser.h"
 #include "canonical_machine.h"
+#include "gcode_parser.h"
 #include "report.h"
 #include "util.h"
 #include "xio.h"					// for char definitions
@@ -46,8 +47,14 @@ jsSingleton_t js;
 /**** local scope stuff ****/
 
 static stat_t _json_parser_kernal(char_t *str);
+static stat_t _json_parser_streaming(char_t *str);
+static stat_t _json_stream_run(void);
+static void _json_stream_flush(void);
+static stat_t _json_validate_streaming(const char_t *str);
 static stat_t _get_nv_pair(nvObj_t *nv, char_t **pstr, int8_t *depth);
 static stat_t _normalize_json_string(char_t *str, uint16_t size);
+static void _filter_response_nv(nvObj_t *nv);
+static char_t *_write_footer_values(char_t *f, stat_t status);
 
 /****************************************************************************
  * json_parser() - exposed part of JSON parser
@@ -89,11 +96,38 @@ static stat_t _normalize_json_string(char_t *str, uint16_t size);
 
 void json_parser(char_t *str)
 {
-	stat_t status = _json_parser_kernal(str);
-	nv_print_list(status, TEXT_NO_PRINT, JSON_RESPONSE_FORMAT);
+	json_flush_pending();							// the parsers reuse cs.out_buf
+	_json_stream_flush();							// finish any streamed response first
+	if (js.json_streaming == JSON_MODE_STREAMING) {
+		_json_parser_streaming(str);				// prints its own response as it goes
+	} else {
+		stat_t status = _json_parser_kernal(str);
+		nv_print_list(status, TEXT_NO_PRINT, JSON_RESPONSE_FORMAT);
+	}
 	sr_request_status_report(SR_IMMEDIATE_REQUEST); // generate incremental status report to show any changes
 }
 
+/*
+ * json_parse_gcode() - run a bare Gcode block received in JSON mode
+ *
+ *	Equivalent to json_parser() on {"gc":"<block>"} - same execution, same response -
+ *	but the block is run in place in the input buffer. It is not wrapped into a JSON
+ *	string, parsed back out of it, or copied into the nv string pool. The gc echo
+ *	points at the block, which the Gcode parser has normalized in place as before.
+ */
+void json_parse_gcode(char_t *block)
+{
+	nvObj_t *nv = nv_reset_nv_list();				// get a fresh nvObj list
+	strcpy(nv->token, "gc");
+	nv->index = nv_get_index((const char_t *)"", nv->token);
+	nv->stringp = (char_t (*)[])block;				// echo from the input buffer, no copy
+	nv->valuetype = TYPE_STRING;
+
+	stat_t status = gc_gcode_parser(block);
+	nv_print_list(status, TEXT_NO_PRINT, JSON_RESPONSE_FORMAT);
+	sr_request_status_report(SR_IMMEDIATE_REQUEST);
+}
+
 static stat_t _json_parser_kernal(char_t *str)
 {
 	stat_t status;
@@ -142,6 +176,323 @@ static stat_t _json_parser_kernal(char_t *str)
 	return (STAT_OK);								// only successful commands exit through this point
 }
 
+/****************************************************************************
+ * _json_parser_streaming() - parse, execute and respond one pair at a time ($jm=1)
+ * _stream_write()			- write a response fragment and fold it into the checksum
+ * _stream_write_name()		- write a "name": in the current syntax mode
+ * _stream_write_pair()		- serialize an executed pair (and anything it added) as a fragment
+ *
+ *	The list parser builds the entire command in the nv list before executing it,
+ *	which limits a command to NV_BODY_LEN pairs and the response to the output buffer.
+ *	The streaming parser instead executes each name/value pair as soon as it is
+ *	tokenized and writes its part of the response immediately. The nv list is reset
+ *	for every pair, so there is no limit on pairs per command and no limit on response
+ *	length. The exceptions are group GETs, which expand into the list as before, and
+ *	parents whose set function needs all of its children at once (e.g. sr), which are
+ *	collected into the list up to NV_BODY_LEN. Plain groups (x, 1, g54...) are not
+ *	collected - each child is executed on its own, as set_grp() would do.
+ *
+ *	Forms accepted are the same as the list parser, but with any number of pairs:
+ *	  {"xvm":16000,"yvm":16000,"zvm":1200, ... }
+ *	  {"x":{"vm":16000,"fr":16000, ... },"y":{"vm":16000, ... }, ... }
+ *	  {"x":null}								(group GETs expand as before)
+ *
+ *	The response has the same shape and footer (including checksum) as the list parser.
+ *	The checksum is accumulated as fragments are written so the response never has to
+ *	be held in memory. The whole command is checked for syntax and names before anything
+ *	is executed, and a command that fails the check gets the list parser's error response
+ *	(including the "err" echo for syntax errors). Pairs are committed as they are executed;
+ *	if a later pair fails to execute processing stops there, earlier pairs stay set, and
+ *	the footer carries the error. Sets are persisted individually, as in the list parser.
+ *
+ *	The response doesn't block on the host. Before each pair the streamer checks for TX
+ *	room (STREAM_TX_RESERVE, see report.h). If there isn't enough it keeps its place and
+ *	returns, and the controller continues it from _sync_to_tx_buffer() before reading
+ *	another command. The planner and cycle callbacks keep running in the meantime.
+ */
+
+static struct jsStream {						// a streamed response, kept across calls while it waits for TX
+	char_t *str;								// next pair in the command (in place in the input buffer)
+	stat_t status;								// execution status
+	stat_t parse;								// parser status - STAT_EAGAIN while pairs remain
+	int8_t depth;
+	char_t group[GROUP_LEN+1];					// group identifier - NUL if none
+	uint8_t in_group;
+	uint8_t need_a_comma;
+	uint8_t silent;
+	uint8_t flush;								// write without waiting for TX room
+	uint32_t hash;								// running checksum of the streamed response
+} st;
+
+static void _stream_write(const char_t *str)
+{
+	for (const char_t *c = str; *c != NUL; c++) {
+		st.hash = 31 * st.hash + *c;			// same hash as compute_checksum()
+	}
+	fprintf(stderr, "%s", (char *)str);
+}
+
+static void _stream_write_name(const char_t *name)
+{
+	char_t buf[GROUP_LEN+TOKEN_LEN+5];
+	char_t *str = buf;
+
+	if (js.json_syntax == JSON_SYNTAX_STRICT) { *str++ = '"';}
+	strcpy(str, name);
+	str += strlen(name);
+	if (js.json_syntax == JSON_SYNTAX_STRICT) { *str++ = '"';}
+	*str++ = ':';
+	*str = NUL;
+	_stream_write(buf);
+}
+
+static uint8_t _stream_write_pair(nvObj_t *nv, uint8_t need_a_comma)
+{
+	int16_t len = json_serialize(nv, cs.out_buf, sizeof(cs.out_buf)); // yields {<fragment>}\n
+	if (len < 3) { return (need_a_comma);}		// overrun (-1) or nothing serialized
+	cs.out_buf[len-2] = NUL;					// strip the closing curly and newline...
+	if (cs.out_buf[1] == NUL) { return (need_a_comma);} // ...which may leave nothing at all
+	if (need_a_comma) { _stream_write((const char_t *)",");}
+	_stream_write(&cs.out_buf[1]);				// ...and the opening curly
+	return (true);
+}
+
+/*
+ * _stream_tx_ready() - true if the next pair (or the footer) can be written without waiting
+ *
+ *	Uses the report reservation check, so a streamed response waits for the host the same
+ *	way reports do. A single pair larger than STREAM_TX_RESERVE (a group GET) still relies
+ *	on xio to wait for the rest of its room.
+ */
+static uint8_t _stream_tx_ready()
+{
+	if ((st.silent == true) || (st.flush == true)) { return (true);}
+#ifdef __AVR
+	return (xio_get_tx_free() >= min((uint16_t)STREAM_TX_RESERVE, (uint16_t)TX_BUFFER_SIZE));
+#else
+	return (true);
+#endif
+}
+
+static stat_t _json_parser_streaming(char_t *str)
+{
+	stat_t status;
+
+	if ((status = _normalize_json_string(str, JSON_OUTPUT_STRING_MAX)) == STAT_OK) {
+		status = _json_validate_streaming(str);
+	}
+	if (status != STAT_OK) {					// nothing was executed - respond as the list parser does
+		nv_print_list(status, TEXT_NO_PRINT, JSON_RESPONSE_FORMAT);
+		return (status);
+	}
+
+	memset(&st, 0, sizeof(st));					// group is NUL, not in a group, no comma owed
+	st.str = str;
+	st.status = STAT_OK;
+	st.parse = STAT_EAGAIN;
+	st.silent = (js.json_verbosity == JV_SILENT);
+	if (!st.silent) {							// _sync_to_tx_buffer() left room for the header
+		_stream_write((const char_t *)"{");
+		_stream_write_name((const char_t *)"r");
+		_stream_write((const char_t *)"{");
+	}
+	js.tx_streaming = true;
+	_json_stream_run();
+	return (st.status);
+}
+
+/*
+ * _json_stream_run()		- run pairs until the command is done or TX room runs short
+ * json_write_streaming()	- continue a streamed response; returns STAT_EAGAIN until it's done
+ * _json_stream_flush()		- finish a streamed response now, letting xio wait for room
+ *
+ *	Returns STAT_EAGAIN if it stopped to wait for TX room. The wait is only ever taken
+ *	before a pair is run, so a pair is never left half executed or half written.
+ *	Reports are held while js.tx_streaming is set, so they can't land inside the response.
+ */
+static stat_t _json_stream_run()
+{
+	nvObj_t *nv;
+
+	while (st.parse == STAT_EAGAIN) {
+		if (_stream_tx_ready() == false) { return (STAT_EAGAIN);}
+		nv = nv_reset_nv_list();				// reclaims the shared string with each pair
+		if (st.in_group) {						// set up the parent so the child gets the right depth
+			nv->valuetype = TYPE_PARENT;
+			nv = nv->nx;
+		}
+		if ((st.parse = _get_nv_pair(nv, &st.str, &st.depth)) > STAT_EAGAIN) { st.status = st.parse; break;}
+		if (st.group[0] != NUL) {
+			strncpy(nv->group, st.group, GROUP_LEN);	// copy the parent's group to this child
+		}
+		if ((nv->index = nv_get_index(nv->group, nv->token)) == NO_MATCH) {
+			st.status = STAT_UNRECOGNIZED_NAME;
+			break;
+		}
+
+		if (nv->valuetype == TYPE_PARENT) {
+			st.depth = 1;
+			if ((fptrCmd)GET_TABLE_WORD(set) == set_grp) {	// open a group - children are executed as they arrive
+				if (nv_group_is_prefixed(nv->token)) { strncpy(st.group, nv->token, GROUP_LEN);}
+				st.in_group = true;
+				if (!st.silent) {
+					if (st.need_a_comma) { _stream_write((const char_t *)",");}
+					_stream_write_name(nv->token);
+					_stream_write((const char_t *)"{");
+				}
+				st.need_a_comma = false;
+				continue;
+			}
+			nvObj_t *child = nv;				// other parents (e.g. sr) need all their children at once
+			while ((st.parse == STAT_EAGAIN) && (st.depth > 0)) {
+				if ((child = child->nx) == NULL) { st.parse = STAT_JSON_TOO_MANY_PAIRS; break;}
+				if ((st.parse = _get_nv_pair(child, &st.str, &st.depth)) > STAT_EAGAIN) { break;}
+				if ((child->index = nv_get_index(child->group, child->token)) == NO_MATCH) {
+					st.parse = STAT_UNRECOGNIZED_NAME;
+					break;
+				}
+			}
+			if (st.parse > STAT_EAGAIN) { st.status = st.parse; break;}
+		}
+
+		// execute the pair
+		if (nv->valuetype == TYPE_NULL) {		// means GET the value
+			if ((st.status = nv_get(nv)) != STAT_OK) { break;}
+		} else {
+			if (cm.machine_state == MACHINE_ALARM) {
+				st.status = STAT_MACHINE_ALARMED;
+				break;
+			}
+			if ((st.status = nv_set(nv)) != STAT_OK) { break;}
+			nv_persist(nv);
+		}
+
+		// respond to the pair
+		if (!st.silent) {
+			if (cm.machine_state != MACHINE_INITIALIZING) { _filter_response_nv(nv);}
+			if (st.in_group) { nv->nx = NULL;}	// group children are always single values
+			st.need_a_comma = _stream_write_pair(nv, st.need_a_comma);
+		}
+
+		// close a group
+		if (st.in_group && (st.depth < 1)) {
+			st.in_group = false;
+			st.group[0] = NUL;
+			st.need_a_comma = true;
+			if (!st.silent) { _stream_write((const char_t *)"}");}
+		}
+	}
+	st.parse = STAT_OK;							// no pairs left to run, even if an error stopped them
+	if (st.silent) {
+		js.tx_streaming = false;
+		return (STAT_OK);
+	}
+	if (_stream_tx_ready() == false) { return (STAT_EAGAIN);}	// wait for room for the footer
+	js.tx_streaming = false;
+	if (st.in_group) {							// close a group left open by an error
+		_stream_write((const char_t *)"}");
+		st.need_a_comma = true;
+	}
+
+	// footer - mirrors json_print_response() so hosts can't tell the difference
+	char_t footer[NV_FOOTER_LEN+8];
+	char_t *f = footer;
+	if (js.json_footer_depth == 0) {			// footer is a peer to 'r'
+		*f++ = '}';
+		*f++ = ',';
+	} else if (st.need_a_comma) {				// footer is a child of 'r'
+		*f++ = ',';
+	}
+	if (js.json_syntax == JSON_SYNTAX_STRICT) { *f++ = '"';}
+	*f++ = 'f';
+	if (js.json_syntax == JSON_SYNTAX_STRICT) { *f++ = '"';}
+	*f++ = ':'; *f++ = '[';
+	f = _write_footer_values(f, st.status);
+	*f = NUL;
+	_stream_write(footer);
+
+	f = footer;									// checksum covers everything up to here
+	*f++ = ',';
+	f += inttoa(f, (uint16_t)(st.hash % HASHMASK));
+	*f++ = ']';
+	if (js.json_footer_depth != 0) { *f++ = '}';}
+	*f++ = '}'; *f++ = '\n'; *f = NUL;
+	fprintf(stderr, "%s", (char *)footer);
+	return (STAT_OK);
+}
+
+stat_t json_write_streaming()
+{
+	if (js.tx_streaming == false) { return (STAT_OK);}
+	return (_json_stream_run());
+}
+
+static void _json_stream_flush()
+{
+	if (js.tx_streaming == false) { return;}
+	st.flush = true;
+	_json_stream_run();
+	st.flush = false;
+}
+
+/*
+ * _json_validate_streaming() - check the syntax and names of a whole command before streaming it
+ *
+ *	Tokenizes the command the same way _json_parser_streaming() does but executes nothing.
+ *	The tokenizer terminates names and strings in place, so it works on a copy in the
+ *	output buffer, which is free until the response is written. On error the nv list holds
+ *	the offending pair for the error response.
+ */
+
+static stat_t _json_validate_streaming(const char_t *str)
+{
+	char_t *scan = cs.out_buf;
+	stat_t parse = STAT_EAGAIN;
+	nvObj_t *nv;
+	int8_t depth = 0;
+	char_t group[GROUP_LEN+1] = {""};
+	uint8_t in_group = false;
+
+	if (strlen(str) >= sizeof(cs.out_buf)) { return (STAT_INPUT_EXCEEDS_MAX_LENGTH);}
+	strcpy(scan, str);
+
+	while (parse == STAT_EAGAIN) {
+		nv = nv_reset_nv_list();
+		if (in_group) {
+			nv->valuetype = TYPE_PARENT;
+			nv = nv->nx;
+		}
+		if ((parse = _get_nv_pair(nv, &scan, &depth)) > STAT_EAGAIN) { return (parse);}
+		if (group[0] != NUL) {
+			strncpy(nv->group, group, GROUP_LEN);
+		}
+		if ((nv->index = nv_get_index(nv->group, nv->token)) == NO_MATCH) {
+			return (STAT_UNRECOGNIZED_NAME);
+		}
+		if (nv->valuetype == TYPE_PARENT) {
+			depth = 1;
+			if ((fptrCmd)GET_TABLE_WORD(set) == set_grp) {
+				if (nv_group_is_prefixed(nv->token)) { strncpy(group, nv->token, GROUP_LEN);}
+				in_group = true;
+				continue;
+			}
+			nvObj_t *child = nv;
+			while ((parse == STAT_EAGAIN) && (depth > 0)) {
+				if ((child = child->nx) == NULL) { return (STAT_JSON_TOO_MANY_PAIRS);}
+				if ((parse = _get_nv_pair(child, &scan, &depth)) > STAT_EAGAIN) { return (parse);}
+				if ((child->index = nv_get_index(child->group, child->token)) == NO_MATCH) {
+					return (STAT_UNRECOGNIZED_NAME);
+				}
+			}
+		}
+		if (in_group && (depth < 1)) {
+			in_group = false;
+			group[0] = NUL;
+		}
+	}
+	return (STAT_OK);
+}
+
 /*
  * _normalize_json_string - normalize a JSON string in place
  *
@@ -353,6 +704,21 @@ static stat_t _get_nv_pair(nvObj_t *nv, char_t **pstr, int8_t *depth)
 
 #define BUFFER_MARGIN 8			// safety margin to avoid buffer overruns during footer checksum generation
 
+/*
+ * _json_puts() - copy a RAM string into the output, stopping short of str_max
+ *
+ *	The serializer writes directly into the output buffer with these helpers and the
+ *	number formatters in util.c. No sprintf is used - see fntoa() for why.
+ *	Returns a pointer to the NUL terminating the copied string.
+ */
+
+static char_t *_json_puts(char_t *str, const char_t *src, const char_t *str_max)
+{
+	while ((*src != NUL) && (str < str_max)) { *str++ = *src++; }
+	*str = NUL;
+	return (str);
+}
+
 uint16_t json_serialize(nvObj_t *nv, char_t *out_buf, uint16_t size)
 {
 #ifdef __SILENCE_JSON_RESPONSES
@@ -371,10 +737,13 @@ uint16_t json_serialize(nvObj_t *nv, char_t *out_buf, uint16_t size)
 			if (need_a_comma) { *str++ = ',';}
 			need_a_comma = true;
 			if (js.json_syntax == JSON_SYNTAX_RELAXED) {		// write name
-				str += sprintf((char *)str, "%s:", nv->token);
+				str = _json_puts(str, nv->token, str_max);
 			} else {
-				str += sprintf((char *)str, "\"%s\":", nv->token);
+				*str++ = '"';
+				str = _json_puts(str, nv->token, str_max);
+				*str++ = '"';
 			}
+			*str++ = ':';
 
 			// check for illegal float values
 			if (nv->valuetype == TYPE_FLOAT) {
@@ -382,23 +751,30 @@ uint16_t json_serialize(nvObj_t *nv, char_t *out_buf, uint16_t size)
 			}
 
 			// serialize output value
-			if		(nv->valuetype == TYPE_NULL)		{ str += (char_t)sprintf((char *)str, "null");} // Note that that "" is NOT null.
-			else if (nv->valuetype == TYPE_INTEGER)	{
-				str += (char_t)sprintf((char *)str, "%1.0f", (double)nv->value);
-			}
+			if		(nv->valuetype == TYPE_NULL)	{ str = _json_puts(str, (const char_t *)"null", str_max);} // Note that that "" is NOT null.
+			else if (nv->valuetype == TYPE_INTEGER)	{ str += fntoa(str, nv->value, 0);}
 			else if (nv->valuetype == TYPE_DATA)	{
 				uint32_t *v = (uint32_t*)&nv->value;
-				str += (char_t)sprintf((char *)str, "\"0x%lx\"", *v);
+				*str++ = '"'; *str++ = '0'; *str++ = 'x';
+				str += hextoa(str, *v);
+				*str++ = '"';
+			}
+			else if (nv->valuetype == TYPE_STRING)	{
+				*str++ = '"';
+				str = _json_puts(str, *nv->stringp, str_max);
+				*str++ = '"';
+			}
+			else if (nv->valuetype == TYPE_ARRAY)	{
+				*str++ = '[';
+				str = _json_puts(str, *nv->stringp, str_max);
+				*str++ = ']';
 			}
-			else if (nv->valuetype == TYPE_STRING)	{ str += (char_t)sprintf((char *)str, "\"%s\"",(char *)*nv->stringp);}
-			else if (nv->valuetype == TYPE_ARRAY)	{ str += (char_t)sprintf((char *)str, "[%s]",  (char *)*nv->stringp);}
 			else if (nv->valuetype == TYPE_FLOAT)	{ preprocess_float(nv);
-//													  str += fntoa((char *)str, nv->value, nv->precision);
 													  str += fntoa(str, nv->value, nv->precision);
 			}
 			else if (nv->valuetype == TYPE_BOOL) {
-				if (fp_FALSE(nv->value)) { str += sprintf((char *)str, "false");}
-				else { str += (char_t)sprintf((char *)str, "true"); }
+				if (fp_FALSE(nv->value)) { str = _json_puts(str, (const char_t *)"false", str_max);}
+				else { str = _json_puts(str, (const char_t *)"true", str_max); }
 			}
 			if (nv->valuetype == TYPE_PARENT) {
 				*str++ = '{';
@@ -417,7 +793,9 @@ uint16_t json_serialize(nvObj_t *nv, char_t *out_buf, uint16_t size)
 
 	// closing curlies and NEWLINE
 	while (prev_depth-- > initial_depth) { *str++ = '}';}
-	str += sprintf((char *)str, "}\n");	// using sprintf for this last one ensures a NUL termination
+	*str++ = '}';
+	*str++ = '\n';
+	*str = NUL;
 	if (str > out_buf + size) { return (-1);}
 	return (str - out_buf);
 #endif
@@ -436,8 +814,9 @@ void json_print_object(nvObj_t *nv)
 	return;
 #endif
 
+	json_flush_pending();
 	json_serialize(nv, cs.out_buf, sizeof(cs.out_buf));
-	fprintf(stderr, "%s", (char *)cs.out_buf);
+	json_write_output();
 }
 
 /*
@@ -480,6 +859,7 @@ void json_print_response(uint8_t status)
 #endif
 
 	if (js.json_verbosity == JV_SILENT) return;			// silent responses
+	json_flush_pending();								// cs.out_buf is about to be reused
 
 	// Body processing
 	nvObj_t *nv = nv_body;
@@ -488,30 +868,9 @@ void json_print_response(uint8_t status)
 		nv_add_string((const char_t *)"err", escape_string(cs.in_buf, cs.saved_buf));
 
 	} else if (cm.machine_state != MACHINE_INITIALIZING) {	// always do full echo during startup
-		uint8_t nv_type;
 		do {
-			if ((nv_type = nv_get_type(nv)) == NV_TYPE_NULL) break;
-
-			if (nv_type == NV_TYPE_GCODE) {
-				if (js.echo_json_gcode_block == false) {	// kill command echo if not enabled
-					nv->valuetype = TYPE_EMPTY;
-				}
-
-//++++		} else if (nv_type == NV_TYPE_CONFIG) {			// kill config echo if not enabled
-//fix me		if (js.echo_json_configs == false) {
-//					nv->valuetype = TYPE_EMPTY;
-//				}
-
-			} else if (nv_type == NV_TYPE_MESSAGE) {		// kill message echo if not enabled
-				if (js.echo_json_messages == false) {
-					nv->valuetype = TYPE_EMPTY;
-				}
-
-			} else if (nv_type == NV_TYPE_LINENUM) {		// kill line number echo if not enabled
-				if ((js.echo_json_linenum == false) || (fp_ZERO(nv->value))) { // do not report line# 0
-					nv->valuetype = TYPE_EMPTY;
-				}
-			}
+			if (nv_get_type(nv) == NV_TYPE_NULL) break;
+			_filter_response_nv(nv);
 		} while ((nv = nv->nx) != NULL);
 	}
 
@@ -523,8 +882,9 @@ void json_print_response(uint8_t status)
 		}
 	}
 	char_t footer_string[NV_FOOTER_LEN];
-	sprintf((char *)footer_string, "%d,%d,%d,0", FOOTER_REVISION, status, cs.linelen);
-	cs.linelen = 0;											// reset linelen so it's only reported once
+	char_t *f = _write_footer_values(footer_string, status);
+	*f++ = ',';
+	*f++ = '0'; *f = NUL;									// checksum placeholder
 
 	nv_copy_string(nv, footer_string);						// link string to nv object
 //	nv->depth = 0;											// footer 'f' is a peer to response 'r' (hard wired to 0)
@@ -544,8 +904,112 @@ void json_print_response(uint8_t status)
 	strcpy(tail, cs.out_buf + strcount + 1);				// save the json termination
 
 	while (cs.out_buf[strcount2] != ',') { strcount2--; }// find start of checksum
-	sprintf((char *)cs.out_buf + strcount2 + 1, "%d%s", compute_checksum(cs.out_buf, strcount2), tail);
-	fprintf(stderr, "%s", cs.out_buf);
+	char_t *str = cs.out_buf + strcount2 + 1;
+	str += inttoa(str, compute_checksum(cs.out_buf, strcount2));
+	strcpy(str, tail);
+	json_write_output();
+}
+
+/*
+ * json_write_output()	- write the JSON string in cs.out_buf, or hold it until it fits
+ * json_write_pending() - write a held string once it fits; returns STAT_EAGAIN until then
+ * json_flush_pending() - write a held string now, letting xio wait for room if need be
+ *
+ *	Responses and reports reserve their TX space up front rather than sleeping in xio
+ *	while the host catches up. A string that doesn't fit the active TX channel stays in
+ *	cs.out_buf and the controller sends it from _sync_to_tx_buffer() before reading the
+ *	next command. Anything about to reuse cs.out_buf flushes a held string first, so
+ *	output is never lost or reordered. A string longer than the TX buffer is sent once
+ *	the buffer is empty - xio's sleep remains the backstop for the overflow.
+ */
+void json_write_output()
+{
+	js.tx_pending = strlen((char *)cs.out_buf);
+	json_write_pending();
+}
+
+stat_t json_write_pending()
+{
+	if (js.tx_pending == 0) { return (STAT_OK);}
+#ifdef __AVR
+	buffer_t tx_free = xio_get_tx_free();
+	if ((tx_free < js.tx_pending + 2) && (tx_free < TX_BUFFER_SIZE)) {	// +2 allows for CRLF expansion
+		return (STAT_EAGAIN);
+	}
+#endif
+	json_flush_pending();
+	return (STAT_OK);
+}
+
+void json_flush_pending()
+{
+	if (js.tx_pending == 0) { return;}
+#ifdef __AVR
+	xio_write_block(xio_get_stderr(), (char *)cs.out_buf, js.tx_pending);
+#else
+	fprintf(stderr, "%s", (char *)cs.out_buf);
+#endif
+	js.tx_pending = 0;
+}
+
+/*
+ * _write_footer_values() - write the footer array values that precede the checksum
+ *
+ *	Revision 1 footer: [1,status,linelen,checksum]
+ *	Revision 2 footer: [2,status,linelen,rx_bytes,rx_lines,checksum] in credit flow control
+ *
+ *	rx_bytes and rx_lines are the receive credits at the time the response is sent -
+ *	the host may have that many bytes and complete lines in flight. Returns a pointer
+ *	to the end of the values (not terminated).
+ */
+static char_t *_write_footer_values(char_t *f, stat_t status)
+{
+#ifdef __AVR
+	uint8_t credits = (cfg.enable_flow_control == FLOW_CONTROL_CREDIT);
+#else
+	uint8_t credits = false;								// no RX credits on ARM
+#endif
+	f += inttoa(f, (credits) ? FOOTER_REVISION_CREDITS : FOOTER_REVISION); *f++ = ',';
+	f += inttoa(f, status); *f++ = ',';
+	f += inttoa(f, cs.linelen);
+	cs.linelen = 0;											// reset linelen so it's only reported once
+#ifdef __AVR
+	if (credits) {
+		*f++ = ','; f += inttoa(f, xio_get_usb_rx_credits());
+		*f++ = ','; f += inttoa(f, xio_get_usb_line_credits());
+	}
+#endif
+	return (f);
+}
+
+/*
+ * _filter_response_nv() - empty an nvObj that the JSON verbosity says should not be echoed
+ */
+
+static void _filter_response_nv(nvObj_t *nv)
+{
+	uint8_t nv_type = nv_get_type(nv);
+
+	if (nv_type == NV_TYPE_GCODE) {
+		if (js.echo_json_gcode_block == false) {	// kill command echo if not enabled
+			nv->valuetype = TYPE_EMPTY;
+		}
+
+//++++	} else if (nv_type == NV_TYPE_CONFIG) {			// kill config echo if not enabled
+//fix me	if (js.echo_json_configs == false) {
+//				nv->valuetype = TYPE_EMPTY;
+//			}
+
+	} else if (nv_type == NV_TYPE_MESSAGE) {		// kill message echo if not enabled
+		if (js.echo_json_messages == false) {
+			nv->valuetype = TYPE_EMPTY;
+		}
+
+	} else if (nv_type == NV_TYPE_LINENUM) {		// kill line number echo if not enabled
+		if ((js.echo_json_linenum == false) || (fp_ZERO(nv->value))) { // do not report line# 0
+			nv->valuetype = TYPE_EMPTY;
+		}
+	}
 }
 
 /***********************************************************************************
@@ -597,11 +1061,13 @@ static const char fmt_ej[] PROGMEM = "[ej]  enable json mode%13d [0=text,1=JSON]
 static const char fmt_jv[] PROGMEM = "[jv]  json verbosity%15d [0=silent,1=footer,2=messages,3=configs,4=linenum,5=verbose]\n";
 static const char fmt_js[] PROGMEM = "[js]  json serialize style%9d [0=relaxed,1=strict]\n";
 static const char fmt_fs[] PROGMEM = "[fs]  footer style%17d [0=new,1=old]\n";
+static const char fmt_jm[] PROGMEM = "[jm]  json parser mode%13d [0=list,1=streaming]\n";
 
 void js_print_ej(nvObj_t *nv) { text_print_ui8(nv, fmt_ej);}
 void js_print_jv(nvObj_t *nv) { text_print_ui8(nv, fmt_jv);}
 void js_print_js(nvObj_t *nv) { text_print_ui8(nv, fmt_js);}
 void js_print_fs(nvObj_t *nv) { text_print_ui8(nv, fmt_fs);}
+void js_print_jm(nvObj_t *nv) { text_print_ui8(nv, fmt_jm);}
 
 #endif // __TEXT_MODE
 
@@ -39,6 +39,7 @@ extern "C"{
 // if you add these make sure there are no collisions w/present or past numbers
 
 #define FOOTER_REVISION 1
+#define FOOTER_REVISION_CREDITS 2		// footer carries RX credits - see _write_footer_values()
 
 #define JSON_OUTPUT_STRING_MAX (OUTPUT_BUFFER_LEN)
 
@@ -62,6 +63,11 @@ enum jsonSyntaxMode {
 	JSON_SYNTAX_STRICT				// requires quotes on names
 };
 
+enum jsonParserMode {
+	JSON_MODE_LIST = 0,				// parse the whole command into the nv list, then execute it
+	JSON_MODE_STREAMING				// execute and respond to each pair as it is parsed
+};
+
 typedef struct jsSingleton {
 
 	/*** config values (PUBLIC) ***/
@@ -69,6 +75,7 @@ typedef struct jsSingleton {
 	uint8_t json_footer_depth;		// 0=footer is peer to response 'r', 1=child of response 'r'
 //	uint8_t json_footer_style;		// select footer style
 	uint8_t json_syntax;			// 0=relaxed syntax, 1=strict syntax
+	uint8_t json_streaming;			// 0=list parser, 1=streaming parser
 
 	uint8_t echo_json_footer;		// flags for JSON responses serialization
 	uint8_t echo_json_messages;
@@ -77,6 +84,8 @@ typedef struct jsSingleton {
 	uint8_t echo_json_gcode_block;
 
 	/*** runtime values (PRIVATE) ***/
+	uint16_t tx_pending;			// length of a JSON string held in cs.out_buf for TX space; 0 if none
+	uint8_t tx_streaming;			// a streamed response is part way out, waiting for TX space
 
 } jsSingleton_t;
 
@@ -87,10 +96,15 @@ extern jsSingleton_t js;
 /**** Function Prototypes ****/
 
 void json_parser(char_t *str);
+void json_parse_gcode(char_t *block);
 uint16_t json_serialize(nvObj_t *nv, char_t *out_buf, uint16_t size);
 void json_print_object(nvObj_t *nv);
 void json_print_response(uint8_t status);
 void json_print_list(stat_t status, uint8_t flags);
+void json_write_output(void);
+stat_t json_write_pending(void);
+stat_t json_write_streaming(void);
+void json_flush_pending(void);
 
 stat_t json_set_jv(nvObj_t *nv);
 
@@ -100,6 +114,7 @@ stat_t json_set_jv(nvObj_t *nv);
 	void js_print_jv(nvObj_t *nv);
 	void js_print_js(nvObj_t *nv);
 	void js_print_fs(nvObj_t *nv);
+	void js_print_jm(nvObj_t *nv);
 
 #else
 
@@ -107,6 +122,7 @@ stat_t json_set_jv(nvObj_t *nv);
 	#define js_print_jv tx_print_stub
 	#define js_print_js tx_print_stub
 	#define js_print_fs tx_print_stub
+	#define js_print_jm tx_print_stub
 
 #endif // __TEXT_MODE
 
@@ -28,20 +28,42 @@
 #include "tinyg.h"
 #include "config.h"
 #include "canonical_machine.h"
+#include "planner.h"
 #include "stepper.h"
 #include "kinematics.h"
+#include "text_parser.h"
+#include "util.h"
 
 #ifdef __cplusplus
 extern "C"{
 #endif
 
-//static void _inverse_kinematics(float travel[], float joint[]);
+kin_t kin;
+
+static void _ik_cartesian(const float travel[], float joint[]);
+static void _ik_corexy(const float travel[], float joint[]);
+static void _ik_delta(const float travel[], float joint[]);
+static void _fk_cartesian(const float joint[], float travel[]);
+static void _fk_corexy(const float joint[], float travel[]);
+static void _fk_delta(const float joint[], float travel[]);
+static float _height_map_offset(const float travel[]);
+
+// inverse kinematics functions indexed by kinType. H-bot uses the CoreXY transform
+static void (*const _inverse_kinematics[])(const float travel[], float joint[]) = {
+	_ik_cartesian, _ik_corexy, _ik_corexy, _ik_delta
+};
+
+// forward kinematics functions, same indexing
+static void (*const _forward_kinematics[])(const float joint[], float travel[]) = {
+	_fk_cartesian, _fk_corexy, _fk_corexy, _fk_delta
+};
 
 /*
  * ik_kinematics() - wrapper routine for inverse kinematics
  *
  *	Calls kinematics function(s).
- *	Performs axis mapping & conversion of length units to steps (and deals with inhibited axes)
+ *	Performs axis mapping & conversion of length units to steps using the motor map table.
+ *	Inhibited axes and unmapped motors have a zero steps per unit in the table.
  *
  *	The reason steps are returned as floats (as opposed to, say, uint32_t) is to accommodate
  *	fractional DDA steps. The DDA deals with fractional step values as fixed-point binary in
@@ -51,58 +73,353 @@ extern "C"{
 
 void ik_kinematics(const float travel[], float steps[])
 {
+	float position[AXES];
 	float joint[AXES];
 
-//	_inverse_kinematics(travel, joint);				// you can insert inverse kinematics transformations here
-	memcpy(joint, travel, sizeof(float)*AXES);		//...or just do a memcpy for Cartesian machines
+	memcpy(position, travel, sizeof(float)*AXES);
+	position[AXIS_Z] += _height_map_offset(travel);	// Z compensation, 0 if not active
+	_inverse_kinematics[kin.type](position, joint);	// type is range checked when set
 
 	// Map motors to axes and convert length units to steps
-	// Most of the conversion math has already been done in during config in steps_per_unit()
-	// which takes axis travel, step angle and microsteps into account.
-	for (uint8_t axis=0; axis<AXES; axis++) {
-		if (cm.a[axis].axis_mode == AXIS_INHIBITED) { joint[axis] = 0;}
-		if (st_cfg.mot[MOTOR_1].motor_map == axis) { steps[MOTOR_1] = joint[axis] * st_cfg.mot[MOTOR_1].steps_per_unit;}
-		if (st_cfg.mot[MOTOR_2].motor_map == axis) { steps[MOTOR_2] = joint[axis] * st_cfg.mot[MOTOR_2].steps_per_unit;}
-		if (st_cfg.mot[MOTOR_3].motor_map == axis) { steps[MOTOR_3] = joint[axis] * st_cfg.mot[MOTOR_3].steps_per_unit;}
-		if (st_cfg.mot[MOTOR_4].motor_map == axis) { steps[MOTOR_4] = joint[axis] * st_cfg.mot[MOTOR_4].steps_per_unit;}
-#if (MOTORS >= 5)
-		if (st_cfg.mot[MOTOR_5].motor_map == axis) { steps[MOTOR_5] = joint[axis] * st_cfg.mot[MOTOR_5].steps_per_unit;}
-#endif
-#if (MOTORS >= 6)
-		if (st_cfg.mot[MOTOR_6].motor_map == axis) { steps[MOTOR_6] = joint[axis] * st_cfg.mot[MOTOR_6].steps_per_unit;}
-#endif
+	// The table is rebuilt by kin_update_motor_map() whenever an input to it changes.
+	// Two motors mapped to one axis (ganged) need nothing special.
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		steps[motor] = joint[kin.motor_axis[motor]] * kin.motor_steps_per_unit[motor];
 	}
+}
 
-/* The above is a loop unrolled version of this:
-	for (uint8_t axis=0; axis<AXES; axis++) {
-		for (uint8_t motor=0; motor<MOTORS; motor++) {
-			if (st_cfg.mot[motor].motor_map == axis) {
-				steps[motor] = joint[axis] * st_cfg.mot[motor].steps_per_unit;
-			}
+/*
+ * fk_kinematics() - wrapper routine for forward kinematics
+ *
+ *	Converts motor step positions back to axis positions. This is not used for motion;
+ *	it turns step counts captured at a switch edge into a position (see switch.c).
+ *	travel[] must hold a nearby position on entry - normally the runtime position.
+ *	Joints that have no motor are taken from it, and it is left unchanged if the
+ *	joints have no solution. Where motors are ganged the first motor is used.
+ *	Z compensation is taken back out, so the result is in the same terms as travel.
+ */
+
+void fk_kinematics(const float steps[], float travel[])
+{
+	float position[AXES];
+	float joint[AXES];
+
+	memcpy(position, travel, sizeof(float)*AXES);
+	position[AXIS_Z] += _height_map_offset(travel);
+	_inverse_kinematics[kin.type](position, joint);
+	for (int8_t motor=MOTORS-1; motor>=0; motor--) {	// descending so the first motor wins
+		if (fp_NOT_ZERO(kin.motor_steps_per_unit[motor])) {
+			joint[kin.motor_axis[motor]] = steps[motor] / kin.motor_steps_per_unit[motor];
 		}
 	}
-*/
+	_forward_kinematics[kin.type](joint, position);
+	position[AXIS_Z] -= _height_map_offset(position);
+	memcpy(travel, position, sizeof(float)*AXES);
 }
 
 /*
- * _inverse_kinematics() - inverse kinematics - example is for a cartesian machine
+ * kin_update_motor_map() - rebuild the motor to axis mapping table
  *
- *	You can glue in inverse kinematics here, but be aware of time budget constrants.
- *	This function is run during the _exec() portion of the cycle and will therefore
- *	be run once per interpolation segment. The total time for the segment load,
- *	including the inverse kinematics transformation cannot exceed the segment time,
- *	and ideally should be no more than 25-50% of the segment time. Currently segments
- *	run avery 5 ms, but this might be lowered. To profile this time look at the
- *	time it takes to complete the mp_exec_move() function.
+ *	Must be called when a motor map ($1ma), axis mode ($xam) or a steps per unit input
+ *	($1sa, $1tr, $1mi) changes. Most of the conversion math has already been done in
+ *	steps_per_unit() which takes axis travel, step angle and microsteps into account.
  */
+
+void kin_update_motor_map()
+{
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		uint8_t axis = st_cfg.mot[motor].motor_map;
+		if ((axis < AXES) && (cm.a[axis].axis_mode != AXIS_INHIBITED)) {
+			kin.motor_axis[motor] = axis;
+			kin.motor_steps_per_unit[motor] = st_cfg.mot[motor].steps_per_unit;
+		} else {
+			kin.motor_axis[motor] = 0;
+			kin.motor_steps_per_unit[motor] = 0;
+		}
+	}
+}
+
 /*
-static void _inverse_kinematics(float travel[], float joint[])
+ * _inverse_kinematics[] - transform axis positions (travel) into joint positions
+ *
+ *	Be aware of time budget constraints. These functions run during the _exec() portion
+ *	of the cycle and will therefore be run once per interpolation segment. The total time
+ *	for the segment load, including the inverse kinematics transformation cannot exceed
+ *	the segment time, and ideally should be no more than 25-50% of the segment time.
+ *	Currently segments run every 5 ms, but this might be lowered. To profile this time
+ *	look at the time it takes to complete the mp_exec_move() function.
+ *
+ *	Everything that can be is precomputed when the settings change. Per segment cost:
+ *	  - cartesian:	memcpy
+ *	  - CoreXY:		memcpy, 2 adds
+ *	  - delta:		memcpy, 3 sqrt, 9 multiplies (about 1.5K cycles with avr-libc)
+ *	  - Z compensation adds 4 int16 loads, 8 int/float conversions, 4 float compares
+ *		and about 14 float adds and multiplies (about 2.5K cycles with avr-libc, or 1.5%
+ *		of a 5 ms segment on the Xmega). See tests/host/kinematics_timing.c
+ *
+ *	Joint positions are absolute, so the step deltas computed in _exec_aline_segment()
+ *	are correct for any of these. Between segment endpoints the joints move linearly,
+ *	which for delta means the path is only exact at the endpoints.
+ */
+
+static void _ik_cartesian(const float travel[], float joint[])
+{
+	memcpy(joint, travel, sizeof(float)*AXES);
+}
+
+static void _ik_corexy(const float travel[], float joint[])
 {
-	for (uint8_t i=0; i<AXES; i++) {
-		joint[i] = travel[i];
+	memcpy(joint, travel, sizeof(float)*AXES);
+	joint[AXIS_X] = travel[AXIS_X] + travel[AXIS_Y];
+	joint[AXIS_Y] = travel[AXIS_X] - travel[AXIS_Y];
+}
+
+static void _ik_delta(const float travel[], float joint[])
+{
+	memcpy(joint, travel, sizeof(float)*AXES);		// ABC pass through
+	for (uint8_t tower=0; tower<DELTA_TOWERS; tower++) {
+		float dx = kin.tower_x[tower] - travel[AXIS_X];
+		float dy = kin.tower_y[tower] - travel[AXIS_Y];
+		float height_sq = kin.arm_length_sq - dx*dx - dy*dy;
+		// out of reach positions are trapped by soft limits. Clamp rather than take sqrt of a negative
+		joint[AXIS_X + tower] = travel[AXIS_Z] + ((height_sq > 0) ? sqrt(height_sq) : 0);
 	}
 }
-*/
+
+/*
+ * _forward_kinematics[] - transform joint positions into axis positions (travel)
+ *
+ *	These only run on switch events, so there is no per-segment time budget.
+ *	Delta intersects the three arm spheres centered on the carriages. Subtracting the
+ *	first sphere from the other two gives X and Y as linear functions of Z; putting
+ *	those back into the first sphere leaves a quadratic in Z. The effector is below
+ *	the carriages, so the lower root is taken.
+ */
+
+static void _fk_cartesian(const float joint[], float travel[])
+{
+	memcpy(travel, joint, sizeof(float)*AXES);
+}
+
+static void _fk_corexy(const float joint[], float travel[])
+{
+	memcpy(travel, joint, sizeof(float)*AXES);
+	travel[AXIS_X] = (joint[AXIS_X] + joint[AXIS_Y]) / 2;
+	travel[AXIS_Y] = (joint[AXIS_X] - joint[AXIS_Y]) / 2;
+}
+
+static void _fk_delta(const float joint[], float travel[])
+{
+	float x[DELTA_TOWERS], y[DELTA_TOWERS], z[DELTA_TOWERS], r_sq[DELTA_TOWERS];
+
+	for (uint8_t tower=0; tower<DELTA_TOWERS; tower++) {
+		x[tower] = kin.tower_x[tower];
+		y[tower] = kin.tower_y[tower];
+		z[tower] = joint[AXIS_X + tower];
+		r_sq[tower] = x[tower]*x[tower] + y[tower]*y[tower] + z[tower]*z[tower];
+	}
+	// a*X + b*Y = c + d*Z for towers 2 and 3 relative to tower 1
+	float a2 = 2*(x[1]-x[0]), b2 = 2*(y[1]-y[0]), c2 = r_sq[1]-r_sq[0], d2 = -2*(z[1]-z[0]);
+	float a3 = 2*(x[2]-x[0]), b3 = 2*(y[2]-y[0]), c3 = r_sq[2]-r_sq[0], d3 = -2*(z[2]-z[0]);
+	float det = a2*b3 - a3*b2;
+	if (fp_ZERO(det)) return;							// towers not set up
+
+	// X = ex + fx*Z, Y = ey + fy*Z, offset to tower 1
+	float ex = (c2*b3 - c3*b2) / det - x[0];
+	float fx = (d2*b3 - d3*b2) / det;
+	float ey = (a2*c3 - a3*c2) / det - y[0];
+	float fy = (a2*d3 - a3*d2) / det;
+
+	float qa = fx*fx + fy*fy + 1;
+	float qb = 2*(ex*fx + ey*fy - z[0]);
+	float qc = ex*ex + ey*ey + z[0]*z[0] - kin.arm_length_sq;
+	float disc = qb*qb - 4*qa*qc;
+	if (disc < 0) return;								// joints are out of reach of each other
+
+	memcpy(travel, joint, sizeof(float)*AXES);			// ABC pass through
+	travel[AXIS_Z] = (-qb - sqrt(disc)) / (2*qa);
+	travel[AXIS_X] = ex + x[0] + fx * travel[AXIS_Z];
+	travel[AXIS_Y] = ey + y[0] + fy * travel[AXIS_Z];
+}
+
+/*
+ * _height_map_offset() - bilinear interpolation of the height map at the X and Y of travel
+ *
+ *	Returns 0 if Z compensation is not active. Outside the probed area the height of the
+ *	nearest edge is used. Segments are straight lines between their endpoints, so between
+ *	endpoints the tool follows the chord of the surface; at 5 ms segments that's well
+ *	inside the probing accuracy for the gentle surfaces this is meant for.
+ */
+
+static float _height_map_offset(const float travel[])
+{
+	if (kin.map.active == false) return (0);
+
+	float u = (travel[AXIS_X] - kin.map.origin_x) * kin.map.inv_spacing_x;
+	float v = (travel[AXIS_Y] - kin.map.origin_y) * kin.map.inv_spacing_y;
+	uint8_t last_column = kin.map.columns - 1;
+	uint8_t last_row = kin.map.rows - 1;
+
+	if (u < 0) { u = 0;} else if (u > last_column) { u = last_column;}
+	if (v < 0) { v = 0;} else if (v > last_row) { v = last_row;}
+	uint8_t i = min((uint8_t)u, last_column - 1);		// cell containing the point
+	uint8_t j = min((uint8_t)v, last_row - 1);
+	u -= i;
+	v -= j;
+
+	const int16_t *h = &kin.map.height[j * kin.map.columns + i];
+	float z0 = h[0] + (h[1] - h[0]) * u;
+	float z1 = h[kin.map.columns] + (h[kin.map.columns + 1] - h[kin.map.columns]) * u;
+	return ((z0 + (z1 - z0) * v) * ((float)1 / HEIGHT_MAP_SCALE));	// multiply - a soft-float divide is ~500 cycles
+}
+
+/*
+ * kin_height_map_update() - recompute cached terms and (de)activate Z compensation
+ *
+ *	Call after the map settings or the probed points change. Compensation changes the
+ *	joint positions of the current runtime position, so the step counters are rewritten
+ *	when it turns on or off (same as changing kinematics). The logical position does not
+ *	move; it is shifted by the map height at the current XY - which is zero at the origin
+ *	point, so set Z zero there after probing.
+ */
+
+void kin_height_map_update()
+{
+	kinHeightMap_t *map = &kin.map;
+
+	map->inv_spacing_x = (fp_ZERO(map->spacing_x)) ? 0 : 1 / map->spacing_x;
+	map->inv_spacing_y = (fp_ZERO(map->spacing_y)) ? 0 : 1 / map->spacing_y;
+
+	uint8_t active = ((map->enable == true) && (map->columns >= 2) && (map->rows >= 2) &&
+					  (map->points == map->columns * map->rows));
+	if (active != map->active) {
+		map->active = active;
+		mp_set_steps_to_runtime_position();
+	}
+}
+
+/***********************************************************************************
+ * CONFIGURATION AND INTERFACE FUNCTIONS
+ * Functions to get and set variables from the cfgArray table
+ ***********************************************************************************/
+
+/*
+ * _kin_update() - recompute cached terms and resync the runtime step position
+ *
+ *	The joint positions of the current runtime position change with the kinematics,
+ *	so the step counters must be rewritten or the next move would jump to catch up.
+ */
+static void _kin_update()
+{
+	static const float tower_angle[DELTA_TOWERS] = { 210, 330, 90 };	// degrees
+
+	for (uint8_t tower=0; tower<DELTA_TOWERS; tower++) {
+		kin.tower_x[tower] = kin.delta_radius * cos(tower_angle[tower] * M_PI / 180);
+		kin.tower_y[tower] = kin.delta_radius * sin(tower_angle[tower] * M_PI / 180);
+	}
+	kin.arm_length_sq = square(kin.delta_arm_length);
+	mp_set_steps_to_runtime_position();
+}
+
+stat_t kin_set_kin(nvObj_t *nv)
+{
+	if (cm.cycle_state != CYCLE_OFF)
+		return (STAT_COMMAND_NOT_ACCEPTED);				// don't change kinematics under motion
+	if ((uint8_t)nv->value > KIN_TYPE_MAX)
+		return (STAT_INPUT_VALUE_RANGE_ERROR);
+	set_ui8(nv);
+	_kin_update();
+	return (STAT_OK);
+}
+
+stat_t kin_set_delta(nvObj_t *nv)
+{
+	if (cm.cycle_state != CYCLE_OFF)
+		return (STAT_COMMAND_NOT_ACCEPTED);
+	set_flu(nv);
+	_kin_update();
+	return (STAT_OK);
+}
+
+/*
+ * kin_set_hmp()  - set a height map origin or spacing. Discards the probed map
+ * kin_set_hmpn() - set the height map columns or rows. Discards the probed map
+ * kin_set_hmpe() - enable or disable Z compensation
+ */
+
+stat_t kin_set_hmp(nvObj_t *nv)
+{
+	if (cm.cycle_state != CYCLE_OFF)
+		return (STAT_COMMAND_NOT_ACCEPTED);				// don't change the map under motion
+	set_flu(nv);
+	kin.map.points = 0;
+	kin_height_map_update();
+	return (STAT_OK);
+}
+
+stat_t kin_set_hmpn(nvObj_t *nv)
+{
+	if (cm.cycle_state != CYCLE_OFF)
+		return (STAT_COMMAND_NOT_ACCEPTED);
+	if ((nv->value < 2) || (nv->value > HEIGHT_MAP_MAX_POINTS / 2))
+		return (STAT_INPUT_VALUE_RANGE_ERROR);			// columns * rows is checked when probing
+	set_ui8(nv);
+	kin.map.points = 0;
+	kin_height_map_update();
+	return (STAT_OK);
+}
+
+stat_t kin_set_hmpe(nvObj_t *nv)
+{
+	if (cm.cycle_state != CYCLE_OFF)
+		return (STAT_COMMAND_NOT_ACCEPTED);
+	ritorno(set_01(nv));
+	kin_height_map_update();
+	return (STAT_OK);
+}
+
+/***********************************************************************************
+ * TEXT MODE SUPPORT
+ * Functions to print variables from the cfgArray table
+ ***********************************************************************************/
+
+#ifdef __TEXT_MODE
+
+extern const char *const msg_units[];				// units strings in canonical_machine.c, used by GET_UNITS()
+
+static const char fmt_kin[] PROGMEM = "[kin] kinematics%20d [0=cartesian,1=CoreXY,2=H-bot,3=delta]\n";
+static const char fmt_dla[] PROGMEM = "[dla] delta arm length%17.3f%s\n";
+static const char fmt_dtr[] PROGMEM = "[dtr] delta radius%21.3f%s\n";
+
+void kin_print_kin(nvObj_t *nv) { text_print_ui8(nv, fmt_kin);}
+void kin_print_dla(nvObj_t *nv) { text_print_flt_units(nv, fmt_dla, GET_UNITS(ACTIVE_MODEL));}
+void kin_print_dtr(nvObj_t *nv) { text_print_flt_units(nv, fmt_dtr, GET_UNITS(ACTIVE_MODEL));}
+
+static const char fmt_hmpx[] PROGMEM = "[hmpx] height map origin X%13.3f%s\n";
+static const char fmt_hmpy[] PROGMEM = "[hmpy] height map origin Y%13.3f%s\n";
+static const char fmt_hmpi[] PROGMEM = "[hmpi] height map X spacing%12.3f%s\n";
+static const char fmt_hmpj[] PROGMEM = "[hmpj] height map Y spacing%12.3f%s\n";
+static const char fmt_hmpn[] PROGMEM = "[hmpn] height map columns%14d\n";
+static const char fmt_hmpm[] PROGMEM = "[hmpm] height map rows%17d\n";
+static const char fmt_hmpd[] PROGMEM = "[hmpd] height map probe depth%10.3f%s\n";
+static const char fmt_hmph[] PROGMEM = "[hmph] height map clearance%12.3f%s\n";
+static const char fmt_hmpf[] PROGMEM = "[hmpf] height map probe feed rate%6.0f%s/min\n";
+static const char fmt_hmpe[] PROGMEM = "[hmpe] Z compensation%18d [0=off,1=on]\n";
+static const char fmt_hmpv[] PROGMEM = "[hmpv] height map points probed%8d\n";
+
+void kin_print_hmpx(nvObj_t *nv) { text_print_flt_units(nv, fmt_hmpx, GET_UNITS(ACTIVE_MODEL));}
+void kin_print_hmpy(nvObj_t *nv) { text_print_flt_units(nv, fmt_hmpy, GET_UNITS(ACTIVE_MODEL));}
+void kin_print_hmpi(nvObj_t *nv) { text_print_flt_units(nv, fmt_hmpi, GET_UNITS(ACTIVE_MODEL));}
+void kin_print_hmpj(nvObj_t *nv) { text_print_flt_units(nv, fmt_hmpj, GET_UNITS(ACTIVE_MODEL));}
+void kin_print_hmpn(nvObj_t *nv) { text_print_ui8(nv, fmt_hmpn);}
+void kin_print_hmpm(nvObj_t *nv) { text_print_ui8(nv, fmt_hmpm);}
+void kin_print_hmpd(nvObj_t *nv) { text_print_flt_units(nv, fmt_hmpd, GET_UNITS(ACTIVE_MODEL));}
+void kin_print_hmph(nvObj_t *nv) { text_print_flt_units(nv, fmt_hmph, GET_UNITS(ACTIVE_MODEL));}
+void kin_print_hmpf(nvObj_t *nv) { text_print_flt_units(nv, fmt_hmpf, GET_UNITS(ACTIVE_MODEL));}
+void kin_print_hmpe(nvObj_t *nv) { text_print_ui8(nv, fmt_hmpe);}
+void kin_print_hmpv(nvObj_t *nv) { text_print_ui8(nv, fmt_hmpv);}
+
+#endif // __TEXT_MODE
 
 #ifdef __cplusplus
 }
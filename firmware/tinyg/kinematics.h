@@ -32,11 +32,123 @@
 extern "C"{
 #endif
 
+/*
+ * Kinematics types and settings
+ *
+ *	CoreXY and H-bot drive X and Y with two motors mapped to the X and Y axes:
+ *	motor "X" moves X+Y and motor "Y" moves X-Y. The belt paths differ but the math
+ *	is the same. Linear delta drives three towers with the motors mapped to X, Y and Z.
+ *	Towers are at 210, 330 and 90 degrees around the center of the bed, in that order.
+ *
+ *	Feed rate, velocity and jerk limits stay in cartesian (axis) space.
+ */
+enum kinType {
+	KIN_CARTESIAN = 0,					// joint = travel (default)
+	KIN_COREXY,							// CoreXY belt arrangement
+	KIN_HBOT,							// H-bot belt arrangement
+	KIN_DELTA							// linear delta
+};
+#define KIN_TYPE_MAX KIN_DELTA
+
+#define DELTA_TOWERS 3
+
+/*
+ * Height map (Z compensation)
+ *
+ *	A grid of surface heights probed by the grid probing cycle ({"hmpr":1}, see
+ *	cycle_probing.c). When enabled ($hmpe) the height under the tool is added to Z
+ *	on the way into the inverse kinematics, so every segment follows the surface.
+ *	Heights are relative to the first (origin) point and held as int16 microns to
+ *	keep the map small; the map itself is not persisted.
+ *
+ *	The offset is applied after planning, so the planner's Z velocity and jerk limits
+ *	don't see it. Grid probing rejects maps steeper than HEIGHT_MAP_MAX_SLOPE (or the
+ *	Z to XY ratio of the axis limits) to keep the added Z motion within bounds.
+ */
+#define HEIGHT_MAP_MAX_POINTS 49		// e.g. 7 x 7
+#define HEIGHT_MAP_SCALE 1000			// stored heights per mm (+/- 32 mm range)
+#define HEIGHT_MAP_MAX_SLOPE 0.05		// steepest map slope accepted (Z mm per XY mm)
+
+typedef struct kinHeightMap {
+	uint8_t enable;						// $hmpe - apply Z compensation if the map is complete
+	uint8_t active;						// map is enabled and complete - read once per segment
+	uint8_t points;						// $hmpv - points probed so far. Complete at columns * rows
+	uint8_t columns;					// $hmpn - points along X
+	uint8_t rows;						// $hmpm - points along Y
+	float origin_x;						// $hmpx - machine X of the first point
+	float origin_y;						// $hmpy - machine Y of the first point
+	float spacing_x;					// $hmpi - X distance between points (may be negative)
+	float spacing_y;					// $hmpj - Y distance between points (may be negative)
+	float probe_depth;					// $hmpd - machine Z to probe down to
+	float clearance;					// $hmph - machine Z to travel between points
+	float feed_rate;					// $hmpf - probing feed rate
+	float inv_spacing_x;				// precomputed from the settings above
+	float inv_spacing_y;
+	int16_t height[HEIGHT_MAP_MAX_POINTS];// row major, X varies fastest
+} kinHeightMap_t;
+
+typedef struct kinSingleton {
+	uint8_t type;						// kinType - selected with $kin
+	float delta_arm_length;				// diagonal rod length (mm)
+	float delta_radius;					// horizontal distance from center to rod joint on the carriage (mm)
+
+	float tower_x[DELTA_TOWERS];		// precomputed from the settings above
+	float tower_y[DELTA_TOWERS];
+	float arm_length_sq;
+
+	uint8_t motor_axis[MOTORS];			// joint (axis) index driving each motor
+	float motor_steps_per_unit[MOTORS];	// steps per unit, or 0 if the motor is unmapped or its axis inhibited
+
+	kinHeightMap_t map;					// Z compensation
+} kin_t;
+extern kin_t kin;
+
 /*
  * Global Scope Functions
  */
 
 void ik_kinematics(const float travel[], float steps[]);
+void fk_kinematics(const float steps[], float travel[]);
+void kin_update_motor_map(void);
+void kin_height_map_update(void);
+
+stat_t kin_set_kin(nvObj_t *nv);
+stat_t kin_set_delta(nvObj_t *nv);
+stat_t kin_set_hmp(nvObj_t *nv);
+stat_t kin_set_hmpn(nvObj_t *nv);
+stat_t kin_set_hmpe(nvObj_t *nv);
+
+#ifdef __TEXT_MODE
+	void kin_print_kin(nvObj_t *nv);
+	void kin_print_dla(nvObj_t *nv);
+	void kin_print_dtr(nvObj_t *nv);
+	void kin_print_hmpx(nvObj_t *nv);
+	void kin_print_hmpy(nvObj_t *nv);
+	void kin_print_hmpi(nvObj_t *nv);
+	void kin_print_hmpj(nvObj_t *nv);
+	void kin_print_hmpn(nvObj_t *nv);
+	void kin_print_hmpm(nvObj_t *nv);
+	void kin_print_hmpd(nvObj_t *nv);
+	void kin_print_hmph(nvObj_t *nv);
+	void kin_print_hmpf(nvObj_t *nv);
+	void kin_print_hmpe(nvObj_t *nv);
+	void kin_print_hmpv(nvObj_t *nv);
+#else
+	#define kin_print_kin tx_print_stub
+	#define kin_print_dla tx_print_stub
+	#define kin_print_dtr tx_print_stub
+	#define kin_print_hmpx tx_print_stub
+	#define kin_print_hmpy tx_print_stub
+	#define kin_print_hmpi tx_print_stub
+	#define kin_print_hmpj tx_print_stub
+	#define kin_print_hmpn tx_print_stub
+	#define kin_print_hmpm tx_print_stub
+	#define kin_print_hmpd tx_print_stub
+	#define kin_print_hmph tx_print_stub
+	#define kin_print_hmpf tx_print_stub
+	#define kin_print_hmpe tx_print_stub
+	#define kin_print_hmpv tx_print_stub
+#endif // __TEXT_MODE
 
 //#ifdef __UNIT_TESTS
 //void ik_unit_tests(void);
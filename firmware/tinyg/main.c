@@ -302,8 +302,8 @@ static const char stat_110[] PROGMEM = "Input value range error";
 static const char stat_111[] PROGMEM = "JSON syntax error";
 static const char stat_112[] PROGMEM = "JSON input has too many pairs";
 static const char stat_113[] PROGMEM = "JSON string too long";
-static const char stat_114[] PROGMEM = "114";
-static const char stat_115[] PROGMEM = "115";
+static const char stat_114[] PROGMEM = "Config snapshot format error";
+static const char stat_115[] PROGMEM = "Config snapshot checksum error";
 static const char stat_116[] PROGMEM = "116";
 static const char stat_117[] PROGMEM = "117";
 static const char stat_118[] PROGMEM = "118";
@@ -403,7 +403,7 @@ static const char stat_202[] PROGMEM = "Move less than minimum time";
 static const char stat_203[] PROGMEM = "Machine is alarmed - Command not processed";	// current longest message 43 chars (including NUL)
 static const char stat_204[] PROGMEM = "Limit switch hit - Shutdown occurred";
 static const char stat_205[] PROGMEM = "Trapezoid planner failed to converge";
-static const char stat_206[] PROGMEM = "206";
+static const char stat_206[] PROGMEM = "Following error exceeded";
 static const char stat_207[] PROGMEM = "207";
 static const char stat_208[] PROGMEM = "208";
 static const char stat_209[] PROGMEM = "209";
@@ -447,7 +447,7 @@ static const char stat_243[] PROGMEM = "Homing Error - Latch velocity is zero";
 static const char stat_244[] PROGMEM = "Homing Error - Travel min & max are the same";
 static const char stat_245[] PROGMEM = "Homing Error - Negative latch backoff";
 static const char stat_246[] PROGMEM = "Homing Error - Homing switches misconfigured";
-static const char stat_247[] PROGMEM = "247";
+static const char stat_247[] PROGMEM = "Calibration cycle failed";
 static const char stat_248[] PROGMEM = "248";
 static const char stat_249[] PROGMEM = "249";
 
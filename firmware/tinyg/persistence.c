@@ -27,8 +27,12 @@
 #include "tinyg.h"
 #include "persistence.h"
 #include "report.h"
+#include "controller.h"
+#include "config_app.h"
+#include "json_parser.h"
 #include "canonical_machine.h"
 #include "util.h"
+#include "xio.h"
 
 #ifdef __AVR
 #include "xmega/xmega_eeprom.h"
@@ -44,6 +48,10 @@ nvmSingleton_t nvm;
  **** GENERIC STATIC FUNCTIONS AND VARIABLES ***************************************
  ***********************************************************************************/
 
+#ifdef __AVR
+static void _log_init(void);
+static void _log_reset(void);
+#endif
 
 /***********************************************************************************
  **** CODE *************************************************************************
@@ -54,10 +62,323 @@ void persistence_init()
 #ifdef __AVR
 	nvm.base_addr = NVM_BASE_ADDR;
 	nvm.profile_base = 0;
+	nvm.page_addr = NVM_NO_PAGE;
+	nvm.log_page_addr = NVM_NO_PAGE;
+	_log_init();
 #endif
+	nvm.snapshot_state = SNAPSHOT_OFF;
 	return;
 }
 
+/************************************************************************************
+ * NVM LAYOUT AND CACHING (AVR)
+ *
+ *	Values live at fixed addresses: profile_base + index * NVM_VALUE_LEN. Writes to
+ *	this area go through a one page RAM write-back cache, so a run of writes that land
+ *	in the same page (a JSON group, $defa, a snapshot load) costs one page erase
+ *	instead of one erase per byte. The cache is written back when a write lands in a
+ *	different page, or by nvm_flush(). The controller flushes after every command,
+ *	so nothing stays dirty across commands. Written-back pages go to a short queue
+ *	of page operations that nvm_write_callback() performs from the controller loop,
+ *	so a command that changes settings does not wait for the EEPROM. Reads look in the
+ *	caches and the queue before going to the EEPROM.
+ *
+ *	Values flagged F_LOG (the G10 coordinate offsets) change far more often than the
+ *	rest and would wear out their pages. They are appended to a log in the top
+ *	NVM_LOG_PAGES of NVM instead. Each record is index(2), generation(2), value(4).
+ *	Appending into a page that has already been started is a split write with no
+ *	erase; a page is only erased when the log first moves into it. When the log is
+ *	full the newest value of each logged index is folded into the fixed area and the
+ *	log starts over from its first page with the next generation number. The first
+ *	page is erased at that point so the old records cannot be replayed. So each log
+ *	page is erased once per pass through the log, whichever offsets are being
+ *	changed.
+ *
+ *	The log is valid from record 0 up to the first erased record or the first record
+ *	from another generation. A value is read from its newest log record, if it has
+ *	one, else from the fixed area. If power fails during a fold the log is still
+ *	intact, and replaying it gives the same result.
+ *
+ *	A full rewrite ($defa, a snapshot commit) writes more logged values than the log
+ *	holds. It resets the log first - the erased first record marks the reset - and
+ *	logged values then go straight to the fixed area until the next nvm_flush().
+ */
+
+#ifdef __AVR
+
+static uint8_t _is_logged(nvObj_t *nv)
+{
+	return ((nvm.log_enabled == true) && (nvm.log_bypass == false) && (GET_TABLE_BYTE(flags) & F_LOG));
+}
+
+/*
+ * _nvm_write_next() - perform the oldest queued page operation
+ * _nvm_queue()		 - queue a page operation, merging it with the newest one if for the same page
+ * _nvm_read()		 - read NVM through the caches and the write queue
+ */
+
+static void _nvm_write_next()
+{
+	nvmWrite_t *w = &nvm.wq[nvm.wq_head];
+
+	switch (w->op) {
+		case NVM_OP_WRITE: { (void)EEPROM_WritePage(w->address, w->page); break; }
+		case NVM_OP_PROGRAM: {
+			EEPROM_FlushBuffer();
+			EEPROM_LoadPage((const uint8_t *)w->page);
+			EEPROM_SplitWritePage(w->address / NVM_PAGE_SIZE);
+			break;
+		}
+		case NVM_OP_ERASE: { EEPROM_ErasePage(w->address / NVM_PAGE_SIZE); break; }
+	}
+	if (++nvm.wq_head == NVM_WRITE_QUEUE_LEN) nvm.wq_head = 0;
+	nvm.wq_count--;
+}
+
+static void _nvm_queue(uint8_t op, uint16_t address, const int8_t *page)
+{
+	nvmWrite_t *w = NULL;
+
+	if (nvm.wq_count > 0) {					// merge with the newest entry only, to keep the write order
+		w = &nvm.wq[(nvm.wq_head + nvm.wq_count - 1) % NVM_WRITE_QUEUE_LEN];
+		if (w->address != address) {
+			w = NULL;
+		} else if ((op == NVM_OP_PROGRAM) && (w->op != NVM_OP_PROGRAM)) {
+			op = NVM_OP_WRITE;				// programming a freshly erased page is a full write
+		}
+	}
+	if (w == NULL) {
+		if (nvm.wq_count == NVM_WRITE_QUEUE_LEN) {
+			_nvm_write_next();				// queue is full - make room the slow way
+		}
+		w = &nvm.wq[(nvm.wq_head + nvm.wq_count++) % NVM_WRITE_QUEUE_LEN];
+		w->address = address;
+	}
+	w->op = op;
+	if (op == NVM_OP_ERASE) {
+		memset(w->page, 0xFF, NVM_PAGE_SIZE);	// so reads see the erased page
+	} else {
+		memcpy(w->page, page, NVM_PAGE_SIZE);
+	}
+}
+
+static void _nvm_read(uint16_t address, int8_t *buf, uint8_t size)
+{
+	uint16_t page = address & ~(NVM_PAGE_SIZE-1);
+
+	if (page == nvm.page_addr) {
+		memcpy(buf, &nvm.page[address - page], size);
+		return;
+	}
+	if (page == nvm.log_page_addr) {
+		memcpy(buf, &nvm.log_page[address - page], size);
+		return;
+	}
+	for (uint8_t i = nvm.wq_count; i > 0; i--) {	// newest queued image of the page wins
+		nvmWrite_t *w = &nvm.wq[(nvm.wq_head + i - 1) % NVM_WRITE_QUEUE_LEN];
+		if (w->address == page) {
+			memcpy(buf, &w->page[address - page], size);
+			return;
+		}
+	}
+	(void)EEPROM_ReadBytes(address, buf, size);
+}
+
+static void _nvm_flush_page()
+{
+	if (nvm.page_dirty == true) {
+		_nvm_queue(NVM_OP_WRITE, nvm.page_addr, nvm.page);
+		nvm.page_dirty = false;
+	}
+}
+
+static void _nvm_write_value(index_t index, float value)
+{
+	uint16_t address = nvm.profile_base + (index * NVM_VALUE_LEN);
+	uint16_t page = address & ~(NVM_PAGE_SIZE-1);
+
+	if (page != nvm.page_addr) {
+		_nvm_flush_page();
+		_nvm_read(page, nvm.page, NVM_PAGE_SIZE);
+		nvm.page_addr = page;
+	}
+	memcpy(&nvm.page[address - page], &value, NVM_VALUE_LEN);
+	nvm.page_dirty = true;
+}
+
+/*
+ * _log_init()		 - find the log generation and the end of the log on startup
+ * _log_reset()		 - discard the log without folding it
+ * _log_flush()		 - write the log tail page back to NVM
+ * _log_find()		 - get the newest logged value for an index
+ * _log_fold()		 - fold the log into the fixed area and start a new generation
+ * _log_append()	 - add a record to the log
+ */
+
+static void _log_read(uint16_t record, uint16_t *index, uint16_t *gen, float *value)
+{
+	int8_t buf[NVM_LOG_RECORD_LEN];
+
+	_nvm_read(NVM_LOG_ADDR + (record * NVM_LOG_RECORD_LEN), buf, NVM_LOG_RECORD_LEN);
+	memcpy(index, &buf[0], 2);
+	memcpy(gen, &buf[2], 2);
+	memcpy(value, &buf[4], NVM_VALUE_LEN);
+}
+
+static void _log_init()
+{
+	uint16_t index, gen;
+	float value;
+	index_t i;
+
+	// the log can only be used if the fixed area stops short of it
+	for (i=0; nv_index_is_single(i); i++);
+	nvm.log_enabled = (NVM_BASE_ADDR + (i * NVM_VALUE_LEN) <= NVM_LOG_ADDR);
+
+	_log_read(0, &index, &gen, &value);
+	if (index == NVM_LOG_EMPTY) {			// log was reset: start past any generation left in later pages
+		nvm.log_gen = 0;
+		for (uint16_t r=NVM_LOG_RECORDS_PER_PAGE; r<NVM_LOG_RECORDS; r+=NVM_LOG_RECORDS_PER_PAGE) {
+			_log_read(r, &index, &gen, &value);
+			if ((index != NVM_LOG_EMPTY) && (gen >= nvm.log_gen)) {
+				nvm.log_gen = gen+1;
+			}
+		}
+		nvm.log_next = 0;
+		return;
+	}
+	nvm.log_gen = gen;
+	for (nvm.log_next=1; nvm.log_next < NVM_LOG_RECORDS; nvm.log_next++) {
+		_log_read(nvm.log_next, &index, &gen, &value);
+		if ((index == NVM_LOG_EMPTY) || (gen != nvm.log_gen)) break;
+	}
+}
+
+static void _log_flush()
+{
+	if (nvm.log_dirty == false)
+		return;
+	if (nvm.log_erase == true) {			// first write into this page since the log entered it
+		_nvm_queue(NVM_OP_WRITE, nvm.log_page_addr, nvm.log_page);
+		nvm.log_erase = false;
+	} else {								// page already holds this generation - program without erase
+		_nvm_queue(NVM_OP_PROGRAM, nvm.log_page_addr, nvm.log_page);
+	}
+	nvm.log_dirty = false;
+}
+
+static void _log_reset()
+{
+	_nvm_queue(NVM_OP_ERASE, NVM_LOG_ADDR, NULL);	// an erased first record invalidates the log
+	nvm.log_gen++;
+	nvm.log_next = 0;
+	nvm.log_page_addr = NVM_NO_PAGE;		// discard the tail page, dirty or not
+	nvm.log_dirty = false;
+}
+
+static uint8_t _log_find(index_t index, float *value)
+{
+	uint16_t rec_index, gen;
+	float rec_value;
+	uint8_t found = false;
+
+	for (uint16_t r=0; r < nvm.log_next; r++) {
+		_log_read(r, &rec_index, &gen, &rec_value);
+		if (rec_index == index) {
+			*value = rec_value;				// keep going - the newest record wins
+			found = true;
+		}
+	}
+	return (found);
+}
+
+static void _log_fold()
+{
+	uint16_t index, gen;
+	float value;
+
+	for (uint16_t r=0; r < nvm.log_next; r++) {
+		_log_read(r, &index, &gen, &value);
+		_nvm_write_value(index, value);
+	}
+	_nvm_flush_page();
+	_log_reset();
+}
+
+static void _log_append(index_t index, float value)
+{
+	uint16_t address, page;
+
+	if (nvm.log_next == NVM_LOG_RECORDS)
+		_log_fold();
+	address = NVM_LOG_ADDR + (nvm.log_next * NVM_LOG_RECORD_LEN);
+	page = address & ~(NVM_PAGE_SIZE-1);
+	if (page != nvm.log_page_addr) {
+		_log_flush();
+		if (address == page) {				// entering a page - it may hold an older generation
+			memset(nvm.log_page, 0xFF, NVM_PAGE_SIZE);
+			nvm.log_erase = true;
+		} else {							// resuming a partly written page after a restart
+			_nvm_read(page, nvm.log_page, NVM_PAGE_SIZE);
+			nvm.log_erase = false;
+		}
+		nvm.log_page_addr = page;
+	}
+	memcpy(&nvm.log_page[address - page], &index, 2);
+	memcpy(&nvm.log_page[address - page + 2], &nvm.log_gen, 2);
+	memcpy(&nvm.log_page[address - page + 4], &value, NVM_VALUE_LEN);
+	nvm.log_dirty = true;
+	nvm.log_next++;
+}
+
+#endif // __AVR
+
+/*
+ * nvm_flush() 			- queue anything held in the NVM caches for writing
+ * nvm_reset_log()		- discard logged values; used when all values are about to be rewritten.
+ *						  Logged values are written in place until the rewrite is flushed.
+ * nvm_write_callback() - perform queued NVM page operations from the controller loop
+ *
+ *	nvm_write_callback() issues at most one page operation per controller pass, and only
+ *	when the NVM controller is free, the machine is not in a cycle and the serial port is
+ *	quiet - the AVR1008 workaround masks mid and low level interrupts (including serial
+ *	RX) while a page operation runs. When it can't write it returns STAT_OK, not
+ *	STAT_EAGAIN, so it never holds up command dispatch or status reports, which run
+ *	later in the controller loop.
+ */
+
+stat_t nvm_flush()
+{
+#ifdef __AVR
+	_nvm_flush_page();
+	_log_flush();
+	nvm.log_bypass = false;
+#endif
+	return (STAT_OK);
+}
+
+void nvm_reset_log()
+{
+#ifdef __AVR
+	_log_reset();
+	nvm.log_bypass = true;
+#endif
+}
+
+stat_t nvm_write_callback()
+{
+#ifdef __AVR
+	if (nvm.wq_count == 0)
+		return (STAT_NOOP);
+	if ((cm.cycle_state != CYCLE_OFF) || (xio_isbusy() == true) || (EEPROM_IsBusy() == true))
+		return (STAT_OK);					// try again on a later pass
+	_nvm_write_next();
+	return (STAT_OK);
+#else
+	return (STAT_NOOP);
+#endif
+}
+
 /************************************************************************************
  * read_persistent_value()	- return value (as float) by index
  * write_persistent_value() - write to NVM by index, but only if the value has changed
@@ -68,8 +389,10 @@ void persistence_init()
 #ifdef __AVR
 stat_t read_persistent_value(nvObj_t *nv)
 {
+	if (_is_logged(nv) && _log_find(nv->index, &nv->value))
+		return (STAT_OK);
 	nvm.address = nvm.profile_base + (nv->index * NVM_VALUE_LEN);
-	(void)EEPROM_ReadBytes(nvm.address, nvm.byte_array, NVM_VALUE_LEN);
+	_nvm_read(nvm.address, nvm.byte_array, NVM_VALUE_LEN);
 	memcpy(&nv->value, &nvm.byte_array, NVM_VALUE_LEN);
 	return (STAT_OK);
 }
@@ -98,9 +421,11 @@ stat_t write_persistent_value(nvObj_t *nv)
 	nvm.tmp_value = nv->value;
 	ritorno(read_persistent_value(nv));
 	if ((isnan((double)nv->value)) || (isinf((double)nv->value)) || (fp_NE(nv->value, nvm.tmp_value))) {
-		memcpy(&nvm.byte_array, &nvm.tmp_value, NVM_VALUE_LEN);
-		nvm.address = nvm.profile_base + (nv->index * NVM_VALUE_LEN);
-		(void)EEPROM_WriteBytes(nvm.address, nvm.byte_array, NVM_VALUE_LEN);
+		if (_is_logged(nv)) {
+			_log_append(nv->index, nvm.tmp_value);
+		} else {
+			_nvm_write_value(nv->index, nvm.tmp_value);
+		}
 	}
 	nv->value =nvm.tmp_value;		// always restore value
 	return (STAT_OK);
@@ -123,6 +448,372 @@ stat_t write_persistent_value(nvObj_t *nv)
 }
 #endif // __ARM
 
+/************************************************************************************
+ * CONFIGURATION SNAPSHOTS
+ *
+ *	A snapshot is a binary image of all persistent settings that can be dumped from
+ *	one board and loaded into another in one transaction - instead of sending hundreds
+ *	of $xxx=nnn commands, each with its own parse, table lookup and EEPROM write.
+ *
+ *	Settings are keyed by a 32 bit FNV-1a hash of their token (e.g. "xvm", "1ma")
+ *	rather than by cfgArray index, so a snapshot taken on one firmware build can be
+ *	loaded into another. Records for tokens the running build does not know are
+ *	skipped. Read-only persistent values (fb, fv) are not part of a snapshot. Values
+ *	are the 4 byte internal (little endian) representation in canonical mm units.
+ *
+ *	The binary image is carried as hex lines so it passes through the normal line
+ *	oriented input, in the manner of Intel HEX. Each line is:
+ *
+ *	  ':' <type> <payload...> <sum>		- every byte as 2 hex digits
+ *
+ *	where <sum> makes all bytes in the line add up to zero (mod 256). Line types are:
+ *
+ *	  SNAPSHOT_HEADER	version(1), record count(2), firmware build(4) of the exporter
+ *	  SNAPSHOT_DATA		1 to NVM_SNAPSHOT_RECORDS records of token hash(4), value(4)
+ *	  SNAPSHOT_END		CRC-16/CCITT of all data records in order(2)
+ *
+ *	$snap prints a snapshot. It is loaded by sending the printed lines back; the
+ *	controller passes lines starting with ':' to nvm_load_snapshot().
+ *
+ *	Values are applied to the running config as data lines arrive - after the line
+ *	checksum and the setting's own set function have validated them - but nothing is
+ *	written to NVM until the END line verifies the record count and CRC. NVM is then
+ *	written in page-sized bursts, erasing only pages whose contents changed. If any line
+ *	fails the load is aborted and the running config is reloaded from NVM.
+ *
+ *	Communications settings (ej, ec, ee, ex, jv, js, jm, fd) would change the link mode
+ *	while the host is still streaming the snapshot, so they are held back and applied
+ *	only once the snapshot has been committed. An aborted load never touches them.
+ */
+
+static uint8_t _snapshot_is_comm(nvObj_t *nv)
+{
+	float *target = (float *)GET_TABLE_WORD(target);
+
+	return ((target == (float *)&cfg.comm_mode) || (target == (float *)&cfg.enable_cr) ||
+			(target == (float *)&cfg.enable_echo) || (target == (float *)&cfg.enable_flow_control) ||
+			(target == (float *)&js.json_verbosity) || (target == (float *)&js.json_syntax) ||
+			(target == (float *)&js.json_streaming) || (target == (float *)&js.json_footer_depth));
+}
+
+static uint8_t _snapshot_member(nvObj_t *nv)
+{
+	if ((GET_TABLE_BYTE(flags) & F_PERSIST) == 0)
+		return (false);
+	return ((fptrCmd)GET_TABLE_WORD(set) != set_nul);	// read-only values are not exported
+}
+
+static uint32_t _snapshot_hash(const char_t *token)
+{
+	uint32_t hash = 2166136261UL;				// FNV-1a offset basis
+	while (*token != NUL) {
+		hash = (hash ^ (uint8_t)*token++) * 16777619UL;
+	}
+	return (hash);
+}
+
+static uint16_t _snapshot_crc(uint16_t crc, const uint8_t *buf, uint8_t len)
+{
+	while (len--) {
+		crc ^= (uint16_t)*buf++ << 8;
+		for (uint8_t i=0; i<8; i++) {
+			crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+		}
+	}
+	return (crc);
+}
+
+static uint32_t _snapshot_get_u32(const uint8_t *buf)
+{
+	return ((uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24));
+}
+
+static void _snapshot_put_u32(uint8_t *buf, uint32_t value)
+{
+	for (uint8_t i=0; i<4; i++) {
+		buf[i] = value & 0xFF;
+		value >>= 8;
+	}
+}
+
+/*
+ * _snapshot_print_line() - add the line checksum and print a line as hex
+ * _snapshot_read_line()  - convert a hex line to bytes and verify the line checksum
+ *
+ *	<len> counts the type byte and payload but not the checksum
+ */
+
+static void _snapshot_print_line(uint8_t *line, uint8_t len)
+{
+	char_t out[NVM_SNAPSHOT_LINE_MAX*2 + 2];
+	char_t *str = out;
+	uint8_t sum = 0;
+
+	for (uint8_t i=0; i<len; i++) {
+		sum += line[i];
+	}
+	line[len++] = -sum;
+
+	*str++ = ':';
+	for (uint8_t i=0; i<len; i++) {
+		*str++ = "0123456789ABCDEF"[line[i] >> 4];
+		*str++ = "0123456789ABCDEF"[line[i] & 0x0F];
+	}
+	*str = NUL;
+	fprintf_P(stderr, PSTR("%s\n"), out);
+}
+
+static int8_t _snapshot_hex_digit(char_t c)
+{
+	if ((c >= '0') && (c <= '9')) return (c - '0');
+	if ((c >= 'A') && (c <= 'F')) return (c - 'A' + 10);
+	if ((c >= 'a') && (c <= 'f')) return (c - 'a' + 10);
+	return (-1);
+}
+
+static stat_t _snapshot_read_line(char_t *buf, uint8_t *line, uint8_t *len)
+{
+	int8_t hi, lo;
+	uint8_t sum = 0;
+	uint8_t n = 0;
+
+	for (buf++; *buf != NUL; buf += 2) {		// skip the leading ':'
+		if (n == NVM_SNAPSHOT_LINE_MAX)
+			return (STAT_INPUT_EXCEEDS_MAX_LENGTH);
+		if (((hi = _snapshot_hex_digit(buf[0])) < 0) || ((lo = _snapshot_hex_digit(buf[1])) < 0))
+			return (STAT_SNAPSHOT_FORMAT_ERROR);	// also catches an odd number of digits
+		line[n] = (hi << 4) | lo;
+		sum += line[n++];
+	}
+	if (n < 2)
+		return (STAT_SNAPSHOT_FORMAT_ERROR);
+	if (sum != 0)
+		return (STAT_SNAPSHOT_CHECKSUM_ERROR);
+	*len = n-1;
+	return (STAT_OK);
+}
+
+/*
+ * nvm_print_snapshot() - print all persistent settings as a snapshot ($snap)
+ */
+
+stat_t nvm_print_snapshot(nvObj_t *nv)
+{
+	nvObj_t snap;								// scratch object - the caller's nv is left alone
+	uint8_t line[NVM_SNAPSHOT_LINE_MAX];
+	uint8_t len = 1;
+	uint16_t count = 0;
+	uint16_t crc = 0xFFFF;
+	char_t token[TOKEN_LEN+1];
+
+	nv = &snap;									// nv is required by the GET_TABLE macros
+	for (nv->index=0; nv_index_is_single(nv->index); nv->index++) {
+		if (_snapshot_member(nv)) count++;
+	}
+	line[0] = SNAPSHOT_HEADER;
+	line[1] = NVM_SNAPSHOT_VERSION;
+	line[2] = count & 0xFF;
+	line[3] = count >> 8;
+	memcpy(&line[4], &cs.fw_build, NVM_VALUE_LEN);
+	_snapshot_print_line(line, 4 + NVM_VALUE_LEN);
+
+	line[0] = SNAPSHOT_DATA;
+	for (nv->index=0; nv_index_is_single(nv->index); nv->index++) {
+		if (_snapshot_member(nv) == false)
+			continue;
+		strncpy_P(token, cfgArray[nv->index].token, TOKEN_LEN+1);
+		nv_get(nv);
+		_snapshot_put_u32(&line[len], _snapshot_hash(token));
+		memcpy(&line[len+4], &nv->value, NVM_VALUE_LEN);
+		crc = _snapshot_crc(crc, &line[len], NVM_SNAPSHOT_RECORD_LEN);
+		if ((len += NVM_SNAPSHOT_RECORD_LEN) == NVM_SNAPSHOT_LINE_MAX-1) {
+			_snapshot_print_line(line, len);
+			len = 1;
+		}
+	}
+	if (len > 1)
+		_snapshot_print_line(line, len);
+
+	line[0] = SNAPSHOT_END;
+	line[1] = crc & 0xFF;
+	line[2] = crc >> 8;
+	_snapshot_print_line(line, 3);
+	return (STAT_OK);
+}
+
+/*
+ * nvm_load_snapshot() - process one snapshot line from the controller
+ *
+ *	_snapshot_find()   - find the setting for a token hash. Searches from the last match
+ *						 so a snapshot from the same build resolves without rescanning.
+ *	_snapshot_defer()  - hold back a communications setting until the commit
+ *	_snapshot_abort()  - end a failed load and reload the touched settings from NVM
+ *	_snapshot_commit() - write all persistent settings to NVM a page at a time, then
+ *						 apply the held back communications settings
+ */
+
+static uint8_t _snapshot_find(nvObj_t *nv, uint32_t hash)
+{
+	if (nv_index_is_single(nvm.snapshot_hint) == false)
+		nvm.snapshot_hint = 0;
+	nv->index = nvm.snapshot_hint;
+	do {
+		if (_snapshot_member(nv)) {
+			strncpy_P(nv->token, cfgArray[nv->index].token, TOKEN_LEN+1);
+			if (_snapshot_hash(nv->token) == hash) {
+				nvm.snapshot_hint = nv->index + 1;
+				return (true);
+			}
+		}
+		if (nv_index_is_single(++nv->index) == false)
+			nv->index = 0;
+	} while (nv->index != nvm.snapshot_hint);
+	return (false);
+}
+
+static stat_t _snapshot_defer(nvObj_t *nv)
+{
+	uint8_t i;
+
+	for (i=0; i<nvm.snapshot_deferred; i++) {	// a repeated record replaces the earlier one
+		if (nvm.deferred_index[i] == nv->index) break;
+	}
+	if (i == NVM_SNAPSHOT_DEFERRED)
+		return (STAT_SNAPSHOT_FORMAT_ERROR);
+	if (i == nvm.snapshot_deferred)
+		nvm.snapshot_deferred++;
+	nvm.deferred_index[i] = nv->index;
+	nvm.deferred_value[i] = nv->value;
+	return (STAT_OK);
+}
+
+static void _snapshot_abort()
+{
+#ifdef __AVR
+	nvObj_t snap;
+	nvObj_t *nv = &snap;
+
+	for (nv->index=0; nv_index_is_single(nv->index); nv->index++) {
+		if (_snapshot_member(nv) && (_snapshot_is_comm(nv) == false)) {
+			strncpy_P(nv->token, cfgArray[nv->index].token, TOKEN_LEN+1);
+			read_persistent_value(nv);
+			nv_set(nv);
+		}
+	}
+#endif // __AVR
+	cm_set_units_mode(nvm.snapshot_units);
+	nvm.snapshot_deferred = 0;					// held back settings are dropped
+	nvm.snapshot_state = SNAPSHOT_OFF;
+}
+
+static void _snapshot_commit()
+{
+	nvObj_t snap;
+	nvObj_t *nv = &snap;
+
+	nvm_reset_log();							// every logged value is rewritten below
+
+	for (nv->index=0; nv_index_is_single(nv->index); nv->index++) {
+		if (_snapshot_member(nv)) {
+			nv_get(nv);
+			for (uint8_t i=0; i<nvm.snapshot_deferred; i++) {
+				if (nvm.deferred_index[i] == nv->index)
+					nv->value = nvm.deferred_value[i];
+			}
+			write_persistent_value(nv);		// lands in the page cache or the log
+		}
+	}
+	nvm_flush();
+
+	for (uint8_t i=0; i<nvm.snapshot_deferred; i++) {
+		nv->index = nvm.deferred_index[i];
+		strncpy_P(nv->token, cfgArray[nv->index].token, TOKEN_LEN+1);
+		nv->value = nvm.deferred_value[i];
+		nv->valuetype = TYPE_FLOAT;
+		nv_set(nv);
+	}
+	nvm.snapshot_deferred = 0;
+}
+
+static stat_t _snapshot_header(uint8_t *line, uint8_t len)
+{
+	if (cm.cycle_state != CYCLE_OFF)
+		return (STAT_COMMAND_NOT_ACCEPTED);		// can't write NVM when machine is moving
+	if ((len != 4 + NVM_VALUE_LEN) || (line[1] != NVM_SNAPSHOT_VERSION))
+		return (STAT_SNAPSHOT_FORMAT_ERROR);
+	if (nvm.snapshot_state == SNAPSHOT_LOADING)
+		_snapshot_abort();						// a new header restarts the load
+
+	nvm.snapshot_count = line[2] | ((uint16_t)line[3] << 8);
+	nvm.snapshot_received = 0;
+	nvm.snapshot_crc = 0xFFFF;
+	nvm.snapshot_hint = 0;
+	nvm.snapshot_deferred = 0;
+	nvm.snapshot_units = cm_get_units_mode(MODEL);
+	cm_set_units_mode(MILLIMETERS);				// snapshot values are in canonical units
+	nvm.snapshot_state = SNAPSHOT_LOADING;
+	return (STAT_OK);
+}
+
+static stat_t _snapshot_data(uint8_t *line, uint8_t len)
+{
+	nvObj_t snap;
+
+	if ((nvm.snapshot_state != SNAPSHOT_LOADING) || (len == 1) || ((len-1) % NVM_SNAPSHOT_RECORD_LEN != 0))
+		return (STAT_SNAPSHOT_FORMAT_ERROR);
+	nvm.snapshot_crc = _snapshot_crc(nvm.snapshot_crc, &line[1], len-1);
+
+	for (uint8_t *rec = &line[1]; rec < &line[len]; rec += NVM_SNAPSHOT_RECORD_LEN) {
+		if (++nvm.snapshot_received > nvm.snapshot_count)
+			return (STAT_SNAPSHOT_FORMAT_ERROR);
+		if (_snapshot_find(&snap, _snapshot_get_u32(rec)) == false)
+			continue;							// not a setting in this build
+		memcpy(&snap.value, &rec[4], NVM_VALUE_LEN);
+		if (_snapshot_is_comm(&snap)) {
+			ritorno(_snapshot_defer(&snap));
+			continue;
+		}
+		ritorno(nv_set(&snap));
+	}
+	return (STAT_OK);
+}
+
+static stat_t _snapshot_end(uint8_t *line, uint8_t len)
+{
+	if ((nvm.snapshot_state != SNAPSHOT_LOADING) || (len != 3) ||
+		(nvm.snapshot_received != nvm.snapshot_count))
+		return (STAT_SNAPSHOT_FORMAT_ERROR);
+	if ((line[1] | ((uint16_t)line[2] << 8)) != nvm.snapshot_crc)
+		return (STAT_SNAPSHOT_CHECKSUM_ERROR);
+	if (cm.cycle_state != CYCLE_OFF)
+		return (STAT_COMMAND_NOT_ACCEPTED);
+
+	_snapshot_commit();
+	cm_set_units_mode(nvm.snapshot_units);
+	nvm.snapshot_state = SNAPSHOT_OFF;
+	sr_init_status_report();					// status report list may have changed
+	return (STAT_OK);
+}
+
+stat_t nvm_load_snapshot(char_t *buf)
+{
+	uint8_t line[NVM_SNAPSHOT_LINE_MAX];
+	uint8_t len;
+	stat_t status;
+
+	if ((status = _snapshot_read_line(buf, line, &len)) == STAT_OK) {
+		switch (line[0]) {
+			case SNAPSHOT_HEADER: { status = _snapshot_header(line, len); break; }
+			case SNAPSHOT_DATA:   { status = _snapshot_data(line, len); break; }
+			case SNAPSHOT_END:    { status = _snapshot_end(line, len); break; }
+			default: { status = STAT_SNAPSHOT_FORMAT_ERROR; }
+		}
+	}
+	if ((status != STAT_OK) && (nvm.snapshot_state == SNAPSHOT_LOADING))
+		_snapshot_abort();						// any failure ends the transaction
+	return (status);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -32,6 +32,47 @@
 
 #define NVM_VALUE_LEN 4					// NVM value length (float, fixed length)
 #define NVM_BASE_ADDR 0x0000			// base address of usable NVM
+#define NVM_SIZE 2048					// xmega192A3 EEPROM size (the 256A3 has 4096)
+#define NVM_PAGE_SIZE 32				// must match EEPROM_PAGESIZE
+#define NVM_NO_PAGE 0xFFFF				// page address of an empty cache
+
+#define NVM_LOG_PAGES 8					// pages at the top of NVM used for the value log
+#define NVM_LOG_ADDR (NVM_SIZE - (NVM_LOG_PAGES * NVM_PAGE_SIZE))
+#define NVM_LOG_RECORD_LEN 8			// index(2), generation(2), value(4)
+#define NVM_LOG_RECORDS_PER_PAGE (NVM_PAGE_SIZE / NVM_LOG_RECORD_LEN)
+#define NVM_LOG_RECORDS (NVM_LOG_PAGES * NVM_LOG_RECORDS_PER_PAGE)
+#define NVM_LOG_EMPTY 0xFFFF			// index field of an erased log record
+
+#define NVM_WRITE_QUEUE_LEN 4			// page operations waiting for nvm_write_callback()
+
+enum nvmPageOp {
+	NVM_OP_WRITE = 0,					// erase and write the page
+	NVM_OP_PROGRAM,						// write the page without erasing (can only clear bits)
+	NVM_OP_ERASE						// erase the page
+};
+
+typedef struct nvmWrite {				// a queued page operation
+	uint16_t address;					// NVM address of the page
+	uint8_t op;							// see nvmPageOp
+	int8_t page[NVM_PAGE_SIZE];			// page contents after the operation
+} nvmWrite_t;
+
+#define NVM_SNAPSHOT_VERSION 1			// config snapshot format version - change if the record layout changes
+#define NVM_SNAPSHOT_RECORDS 8			// token/value records per snapshot data line
+#define NVM_SNAPSHOT_RECORD_LEN 8		// 4 byte token hash + 4 byte value
+#define NVM_SNAPSHOT_LINE_MAX (1 + NVM_SNAPSHOT_RECORDS * NVM_SNAPSHOT_RECORD_LEN + 1) // type + records + line checksum
+#define NVM_SNAPSHOT_DEFERRED 8			// communications settings held back until the snapshot commits
+
+enum nvmSnapshotLineType {				// first byte of every snapshot line
+	SNAPSHOT_DATA = 0,					// up to NVM_SNAPSHOT_RECORDS token/value records
+	SNAPSHOT_HEADER,					// version, record count, firmware build
+	SNAPSHOT_END						// CRC over all data records - commits the snapshot
+};
+
+enum nvmSnapshotState {
+	SNAPSHOT_OFF = 0,					// no snapshot load in progress
+	SNAPSHOT_LOADING					// header received, receiving data lines
+};
 
 //**** persistence singleton ****
 
@@ -41,6 +82,33 @@ typedef struct nvmSingleton {
 	uint16_t address;
 	float tmp_value;
 	int8_t byte_array[NVM_VALUE_LEN];
+
+	uint16_t page_addr;					// NVM address of the page in the write-back cache
+	uint8_t page_dirty;					// cached page has changes not yet written
+	int8_t page[NVM_PAGE_SIZE];			// write-back cache for the fixed value area
+
+	uint8_t log_enabled;				// false if the fixed area would overlap the log
+	uint8_t log_bypass;					// log was reset for a full rewrite - write logged values in place
+	uint8_t log_dirty;					// log tail page has records not yet written
+	uint8_t log_erase;					// log tail page must be erased when written
+	uint16_t log_gen;					// generation of the records in the current log
+	uint16_t log_next;					// next free record in the log
+	uint16_t log_page_addr;				// NVM address of the log tail page
+	int8_t log_page[NVM_PAGE_SIZE];		// image of the log tail page
+
+	uint8_t wq_head;					// oldest queued page operation
+	uint8_t wq_count;					// number of queued page operations
+	nvmWrite_t wq[NVM_WRITE_QUEUE_LEN];	// page operations waiting to be performed
+
+	uint8_t snapshot_state;				// see nvmSnapshotState
+	uint8_t snapshot_units;				// units mode to restore when the load finishes
+	uint16_t snapshot_count;			// number of records announced by the header
+	uint16_t snapshot_received;			// number of records received so far
+	uint16_t snapshot_crc;				// running CRC of received data records
+	index_t snapshot_hint;				// index to start the next token hash search from
+	uint8_t snapshot_deferred;			// number of communications settings held back
+	index_t deferred_index[NVM_SNAPSHOT_DEFERRED];	// ...their cfgArray indexes
+	float deferred_value[NVM_SNAPSHOT_DEFERRED];	// ...and their values
 } nvmSingleton_t;
 
 //**** persistence function prototypes ****
@@ -48,5 +116,11 @@ typedef struct nvmSingleton {
 void persistence_init(void);
 stat_t read_persistent_value(nvObj_t *nv);
 stat_t write_persistent_value(nvObj_t *nv);
+stat_t nvm_flush(void);
+void nvm_reset_log(void);
+stat_t nvm_write_callback(void);
+
+stat_t nvm_print_snapshot(nvObj_t *nv);
+stat_t nvm_load_snapshot(char_t *buf);
 
 #endif // End of include guard: PERSISTENCE_H_ONCE
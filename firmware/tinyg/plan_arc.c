@@ -36,6 +36,7 @@ arc_t arc;
 static stat_t _compute_arc(void);
 static stat_t _compute_arc_offsets_from_radius(void);
 static void _estimate_arc_time(void);
+static float _get_arc_velocity_max(void);
 //static stat_t _test_arc_soft_limits(void);
 
 /*****************************************************************************
@@ -61,6 +62,10 @@ void cm_arc_init()
  *
  * Generates an arc by queuing line segments to the move buffer. The arc is
  * approximated by generating a large number of tiny, linear arc_segments.
+ *
+ * With __PLANNER_ARCS the arc is instead queued as a single MOVE_TYPE_ARC block
+ * and interpolated by the runtime. See mp_arc(). Arcs too short to plan as a block,
+ * or that arrive when every arc geometry record is in use, are still segmented.
  */
 stat_t cm_arc_feed(float target[], float flags[],       // arc endpoints
 				   float i, float j, float k,           // raw arc offsets
@@ -175,6 +180,18 @@ stat_t cm_arc_feed(float target[], float flags[],       // arc endpoints
     	return (cm_soft_alarm(status));
 	}
 */
+#ifdef __PLANNER_ARCS
+	if ((arc.arc_time >= MIN_BLOCK_TIME) && (mp_get_arc_record() >= 0)) {
+		mpArc_t geometry = { arc.center_0, arc.center_1, arc.radius, arc.angular_travel / arc.length,
+							 arc.plane_axis_0, arc.plane_axis_1 };
+		copy_vector(arc.gm.target, cm.gm.target);	// the block runs to the arc endpoint...
+		arc.gm.move_time = arc.arc_time;			// ...in the time estimated for the whole arc
+		cm_cycle_start();					// if not already started
+		stat_t status = mp_arc(&arc.gm, &geometry, arc.length);
+		cm_finalize_move();
+		return (status);
+	}
+#endif
 	cm_cycle_start();						// if not already started
 	arc.run_state = MOVE_RUN;				// enable arc to be run from the callback
 	cm_finalize_move();
@@ -187,6 +204,12 @@ stat_t cm_arc_feed(float target[], float flags[],       // arc endpoints
  *	cm_arc_callback() is called from the controller main loop. Each time it's called it
  *	queues as many arc segments (lines) as it can before it blocks, then returns.
  *
+ *	Segment endpoints are found by rotating the radius vector through arc_segment_theta
+ *	using the sin and cos computed once in _compute_arc(), which avoids two soft-float
+ *	trig calls per segment. Rounding error accumulates in the recurrence, so every
+ *	ARC_ANCHOR_SEGMENTS segments, and on the last segment, the vector is re-anchored
+ *	from the exact angle. The arc endpoint is therefore computed the same way as before.
+ *
  *  Parts of this routine were originally sourced from the grbl project.
  */
 
@@ -198,10 +221,20 @@ stat_t cm_arc_callback()
 	if (mp_get_planner_buffers_available() < PLANNER_BUFFER_HEADROOM)
         return (STAT_EAGAIN);
 
-	arc.theta += arc.arc_segment_theta;
-	arc.gm.target[arc.plane_axis_0] = arc.center_0 + sin(arc.theta) * arc.radius;
-	arc.gm.target[arc.plane_axis_1] = arc.center_1 + cos(arc.theta) * arc.radius;
+	int32_t segment = (int32_t)arc.arc_segments - arc.arc_segment_count + 1;	// 1 to arc_segments
+	if (((segment % ARC_ANCHOR_SEGMENTS) == 0) || (arc.arc_segment_count == 1)) {
+		float theta = arc.theta + segment * arc.arc_segment_theta;	// exact angle - no accumulated sum
+		arc.radius_0 = sin(theta) * arc.radius;
+		arc.radius_1 = cos(theta) * arc.radius;
+	} else {
+		float radius_0 = arc.radius_0 * arc.arc_segment_cos + arc.radius_1 * arc.arc_segment_sin;
+		arc.radius_1   = arc.radius_1 * arc.arc_segment_cos - arc.radius_0 * arc.arc_segment_sin;
+		arc.radius_0   = radius_0;
+	}
+	arc.gm.target[arc.plane_axis_0] = arc.center_0 + arc.radius_0;
+	arc.gm.target[arc.plane_axis_1] = arc.center_1 + arc.radius_1;
 	arc.gm.target[arc.linear_axis] += arc.arc_segment_linear_travel;
+	arc.gm.move_time = arc.arc_minimum_time / arc.arc_segments;	// limit time floor - mp_aline() overwrites it
 	mp_aline(&arc.gm);								// run the line
 	copy_vector(arc.position, arc.gm.target);		// update arc current position
 
@@ -319,12 +352,16 @@ static stat_t _compute_arc()
 							      arc_segments_for_minimum_time));
 
 	arc.arc_segments = max(arc.arc_segments, 1);            //...but is at least 1 arc_segment
- 	arc.gm.move_time = arc.arc_time / arc.arc_segments;     // gcode state struct gets arc_segment_time, not arc time
+ 	arc.gm.move_time = arc.arc_minimum_time / arc.arc_segments;// segments carry their share of the limit time
 	arc.arc_segment_count = (int32_t)arc.arc_segments;
 	arc.arc_segment_theta = arc.angular_travel / arc.arc_segments;
 	arc.arc_segment_linear_travel = arc.linear_travel / arc.arc_segments;
-    arc.center_0 = arc.position[arc.plane_axis_0] - sin(arc.theta) * arc.radius;
-    arc.center_1 = arc.position[arc.plane_axis_1] - cos(arc.theta) * arc.radius;
+	arc.arc_segment_sin = sin(arc.arc_segment_theta);
+	arc.arc_segment_cos = cos(arc.arc_segment_theta);
+	arc.radius_0 = sin(arc.theta) * arc.radius;				// arc.theta stays at the start angle
+	arc.radius_1 = cos(arc.theta) * arc.radius;
+    arc.center_0 = arc.position[arc.plane_axis_0] - arc.radius_0;
+    arc.center_1 = arc.position[arc.plane_axis_1] - arc.radius_1;
 	arc.gm.target[arc.linear_axis] = arc.position[arc.linear_axis];	// initialize the linear target
 	return (STAT_OK);
 }
@@ -451,6 +488,14 @@ static stat_t _compute_arc_offsets_from_radius()
  *	dimension, but the comparison assumes that the arc will have at least one segment
  *	where the unit vector is 1 in that dimension. This is not true for any arbitrary arc,
  *	with the result that the time returned may be less than optimal.
+ *
+ *	The feed rate override is applied to the feed time, as _calc_move_times() does for
+ *	lines, before the axis and radius limits. The time is also stretched so the planar
+ *	velocity stays under the limit set by the arc radius. See _get_arc_velocity_max().
+ *
+ *	The limit time on its own is kept in arc_minimum_time. Segmented arcs hand each
+ *	segment its share as gm.move_time, which _calc_move_times() uses as a floor for arc
+ *	segments, so the radius cap holds after mp_aline() recomputes the segment time.
  */
 static void _estimate_arc_time ()
 {
@@ -462,13 +507,44 @@ static void _estimate_arc_time ()
 	} else {
 		arc.arc_time = arc.length / cm.gm.feed_rate;
 	}
+	arc.arc_time = cm_apply_feed_override(arc.arc_time);	// M50.1 or realtime, as for lines
 
-	// Downgrade the time if there is a rate-limiting axis
-	arc.arc_time = max(arc.arc_time, arc.planar_travel/cm.a[arc.plane_axis_0].feedrate_max);
-	arc.arc_time = max(arc.arc_time, arc.planar_travel/cm.a[arc.plane_axis_1].feedrate_max);
+	// Find the time needed by the rate-limiting axis
+	arc.arc_minimum_time = max(fabs(arc.planar_travel/cm.a[arc.plane_axis_0].feedrate_max),
+							   fabs(arc.planar_travel/cm.a[arc.plane_axis_1].feedrate_max));
 	if (fabs(arc.linear_travel) > 0) {
-		arc.arc_time = max(arc.arc_time, fabs(arc.linear_travel/cm.a[arc.linear_axis].feedrate_max));
+		arc.arc_minimum_time = max(arc.arc_minimum_time, fabs(arc.linear_travel/cm.a[arc.linear_axis].feedrate_max));
+	}
+
+	// ...or by the radius, if it is too tight to run the planar travel at speed
+	if (fabs(arc.planar_travel) > 0) {
+		arc.arc_minimum_time = max(arc.arc_minimum_time, fabs(arc.planar_travel) / _get_arc_velocity_max());
+	}
+
+	// Downgrade the time if either limit is slower than the feed rate
+	arc.arc_time = max(arc.arc_time, arc.arc_minimum_time);
+}
+
+/*
+ * _get_arc_velocity_max() - maximum planar velocity for the arc radius
+ *
+ *	Running a circle of radius R at velocity v takes a centripetal acceleration of
+ *	v^2/R, and the acceleration vector turns at v/R, so the jerk is v^3/R^2. Each
+ *	plane axis sees the full value once per revolution. The velocity is therefore
+ *	limited to the lower of:
+ *
+ *		sqrt(a * R)		a = arc centripetal acceleration setting ($ca, 0 = not used)
+ *		cbrt(J * R^2)	J = the lower jerk_max of the two plane axes
+ */
+static float _get_arc_velocity_max()
+{
+	float jerk = min(cm.a[arc.plane_axis_0].jerk_max, cm.a[arc.plane_axis_1].jerk_max) * JERK_MULTIPLIER;
+	float velocity = cbrt(jerk * square(arc.radius));
+
+	if (cm.arc_acceleration > 0) {
+		velocity = min(velocity, sqrt(cm.arc_acceleration * arc.radius));
 	}
+	return (velocity);
 }
 
 /*
@@ -25,6 +25,10 @@
 #define ARC_RADIUS_ERROR_MAX    ((float)1.0)        // max allowable mm between start and end radius
 #define ARC_RADIUS_ERROR_MIN    ((float)0.005)      // min mm where 1% rule applies
 #define ARC_RADIUS_TOLERANCE    ((float)0.001)      // 0.1% radius variance test
+
+// Segments are generated by rotating the radius vector. Every ARC_ANCHOR_SEGMENTS segments
+// (and on the last segment) the vector is recomputed exactly from theta to bound drift
+#define ARC_ANCHOR_SEGMENTS     16
 
 // See planner.h for MM_PER_ARC_SEGMENT and other arc setting #defines
 
@@ -50,12 +54,17 @@ typedef struct arArcSingleton {	    // persistent planner and runtime variables
 	uint8_t linear_axis;            // linear axis (normal to plane)
 
 	float arc_time;					// total running time for arc (derived)
+	float arc_minimum_time;			// arc time at the axis and radius velocity limits
 	float arc_segments;				// number of segments in arc or blend
 	int32_t arc_segment_count;		// count of running segments
 	float arc_segment_theta;		// angular motion per segment
 	float arc_segment_linear_travel;// linear motion per segment
+	float arc_segment_sin;			// sin and cos of arc_segment_theta for the rotation recurrence
+	float arc_segment_cos;
 	float center_0;				    // center of circle at plane axis 0 (e.g. X for G17)
 	float center_1;				    // center of circle at plane axis 1 (e.g. Y for G17)
+	float radius_0;					// radius vector from center to current segment endpoint
+	float radius_1;
 
 	GCodeState_t gm;			    // Gcode state struct is passed for each arc segment. Usage:
 //	uint32_t linenum;			    // line number of the arc feed move - same for each segment
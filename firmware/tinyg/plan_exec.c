@@ -29,6 +29,7 @@
 #include "tinyg.h"
 #include "config.h"
 #include "planner.h"
+#include "plan_arc.h"
 #include "kinematics.h"
 #include "stepper.h"
 #include "encoder.h"
@@ -44,6 +45,11 @@ static stat_t _exec_aline_head(void);
 static stat_t _exec_aline_body(void);
 static stat_t _exec_aline_tail(void);
 static stat_t _exec_aline_segment(void);
+#ifdef __PLANNER_ARCS
+static void _get_arc_point(const float distance, float point[]);
+static void _next_arc_point(const float segment_length, float point[]);
+static void _set_arc_radius(const float point[]);
+#endif
 
 #ifndef __JERK_EXEC
 static void _init_forward_diffs(float Vi, float Vt);
@@ -65,7 +71,7 @@ stat_t mp_exec_move()
 		return (STAT_NOOP);
 	}
 	// Manage cycle and motion state transitions
-	if (bf->move_type == MOVE_TYPE_ALINE) { 			// cycle auto-start for lines only
+	if ((bf->move_type == MOVE_TYPE_ALINE) || (bf->move_type == MOVE_TYPE_ARC)) { // cycle auto-start for moves only
 		if (cm.motion_state == MOTION_STOP) cm_set_motion_state(MOTION_RUN);
 	}
 	if (bf->bf_func == NULL)
@@ -175,6 +181,7 @@ stat_t mp_exec_aline(mpBuf_t *bf)
 		}
 		bf->move_state = MOVE_RUN;
 		mr.move_state = MOVE_RUN;
+		mr.move_type = bf->move_type;
 		mr.section = SECTION_HEAD;
 		mr.section_state = SECTION_NEW;
 		mr.jerk = bf->jerk;
@@ -198,6 +205,20 @@ stat_t mp_exec_aline(mpBuf_t *bf)
 			mr.waypoint[SECTION_BODY][axis] = mr.position[axis] + mr.unit[axis] * (mr.head_length + mr.body_length);
 			mr.waypoint[SECTION_TAIL][axis] = mr.position[axis] + mr.unit[axis] * (mr.head_length + mr.body_length + mr.tail_length);
 		}
+#ifdef __PLANNER_ARCS
+		// arcs start from wherever the runtime is - which is mid-arc if the buffer was split by a feedhold
+		if (mr.move_type == MOVE_TYPE_ARC) {
+			memcpy(&mr.arc, &mb.arc[bf->move_code], sizeof(mpArc_t));
+			mr.arc_theta = atan2(mr.position[mr.arc.plane_axis_0] - mr.arc.center_0,
+								 mr.position[mr.arc.plane_axis_1] - mr.arc.center_1);
+			mr.arc_distance = 0;
+			mr.arc_anchor_count = ARC_ANCHOR_SEGMENTS;
+			_set_arc_radius(mr.position);
+			_get_arc_point(mr.head_length, mr.waypoint[SECTION_HEAD]);
+			_get_arc_point(mr.head_length + mr.body_length, mr.waypoint[SECTION_BODY]);
+			copy_vector(mr.waypoint[SECTION_TAIL], mr.target);	// end exactly on the programmed endpoint
+		}
+#endif
 	}
 	// NB: from this point on the contents of the bf buffer do not affect execution
 
@@ -702,18 +723,30 @@ static stat_t _exec_aline_segment()
 	if ((--mr.segment_count == 0) && (mr.section_state == SECTION_2nd_HALF) &&
 		(cm.motion_state == MOTION_RUN) && (cm.cycle_state == CYCLE_MACHINING)) {
 		copy_vector(mr.gm.target, mr.waypoint[mr.section]);
+#ifdef __PLANNER_ARCS
+		if (mr.move_type == MOVE_TYPE_ARC) {
+			mr.arc_distance = mr.head_length;					// path distance at the waypoint
+			if (mr.section != SECTION_HEAD) mr.arc_distance += mr.body_length;
+			if (mr.section == SECTION_TAIL) mr.arc_distance += mr.tail_length;
+			_set_arc_radius(mr.gm.target);						// the recurrence continues from the waypoint
+		}
+#endif
 	} else {
 		float segment_length = mr.segment_velocity * mr.segment_time;
 		for (i=0; i<AXES; i++) {
 			mr.gm.target[i] = mr.position[i] + (mr.unit[i] * segment_length);
 		}
+#ifdef __PLANNER_ARCS
+		if (mr.move_type == MOVE_TYPE_ARC) {					// plane axes follow the circle
+			_next_arc_point(segment_length, mr.gm.target);
+		}
+#endif
 	}
 
 	// Convert target position to steps
 	// Bucket-brigade the old target down the chain before getting the new target from kinematics
 	//
-	// NB: The direct manipulation of steps to compute travel_steps only works for Cartesian kinematics.
-	//	   Other kinematics may require transforming travel distance as opposed to simply subtracting steps.
+	// NB: Kinematics return absolute joint positions, so subtracting steps works for all kinematics types.
 
 	for (i=0; i<MOTORS; i++) {
 		mr.commanded_steps[i] = mr.position_steps[i];		// previous segment's position, delayed by 1 segment
@@ -721,6 +754,7 @@ static stat_t _exec_aline_segment()
 		mr.encoder_steps[i] = en_read_encoder(i);			// get current encoder position (time aligns to commanded_steps)
 		mr.following_error[i] = mr.encoder_steps[i] - mr.commanded_steps[i];
 	}
+	en_monitor_following_error(mr.following_error);
 	ik_kinematics(mr.gm.target, mr.target_steps);			// now determine the target steps...
 	for (i=0; i<MOTORS; i++) {								// and compute the distances to be traveled
 		travel_steps[i] = mr.target_steps[i] - mr.position_steps[i];
@@ -736,3 +770,56 @@ static stat_t _exec_aline_segment()
 	if (mr.segment_count == 0) return (STAT_OK);			// this section has run all its segments
 	return (STAT_EAGAIN);									// this section still has more segments to run
 }
+
+#ifdef __PLANNER_ARCS
+/*
+ * _get_arc_point()	  - set the plane axes of point[] to the arc position at a path distance
+ * _next_arc_point()  - advance the arc position by one segment and set it in point[]
+ * _set_arc_radius()  - set the running radius vector from a point on the arc
+ *
+ *	Distance is measured from the start of the running block. Other axes are left as-is.
+ *	_get_arc_point() recomputes the angle from the distance, so it carries no accumulated
+ *	error. It is used for the section waypoints and to re-anchor the recurrence.
+ *
+ *	_next_arc_point() rotates the radius vector through the segment angle rather than
+ *	calling sin() and cos() for every segment - the same recurrence cm_arc_callback()
+ *	uses. Segment lengths change through the head and tail, so the sin and cos of the
+ *	segment angle come from short series, good to better than 1e-6 up to
+ *	ARC_SERIES_MAX_THETA. Larger angles, and every ARC_ANCHOR_SEGMENTS segments, are
+ *	computed exactly. The vector is also re-set at each waypoint.
+ */
+static void _get_arc_point(const float distance, float point[])
+{
+	float theta = mr.arc_theta + mr.arc.theta_per_mm * distance;
+
+	point[mr.arc.plane_axis_0] = mr.arc.center_0 + sin(theta) * mr.arc.radius;
+	point[mr.arc.plane_axis_1] = mr.arc.center_1 + cos(theta) * mr.arc.radius;
+}
+
+static void _next_arc_point(const float segment_length, float point[])
+{
+	float theta = mr.arc.theta_per_mm * segment_length;
+
+	mr.arc_distance += segment_length;
+	if ((--mr.arc_anchor_count == 0) || (fabs(theta) > ARC_SERIES_MAX_THETA)) {
+		_get_arc_point(mr.arc_distance, point);
+		_set_arc_radius(point);
+		return;
+	}
+	float theta_2 = square(theta);
+	float sin_theta = theta * (1 - theta_2/6 * (1 - theta_2/20));
+	float cos_theta = 1 - theta_2/2 * (1 - theta_2/12);
+	float radius_0 = mr.arc_radius_0 * cos_theta + mr.arc_radius_1 * sin_theta;
+	mr.arc_radius_1 = mr.arc_radius_1 * cos_theta - mr.arc_radius_0 * sin_theta;
+	mr.arc_radius_0 = radius_0;
+	point[mr.arc.plane_axis_0] = mr.arc.center_0 + mr.arc_radius_0;
+	point[mr.arc.plane_axis_1] = mr.arc.center_1 + mr.arc_radius_1;
+}
+
+static void _set_arc_radius(const float point[])
+{
+	mr.arc_radius_0 = point[mr.arc.plane_axis_0] - mr.arc.center_0;
+	mr.arc_radius_1 = point[mr.arc.plane_axis_1] - mr.arc.center_1;
+	mr.arc_anchor_count = ARC_ANCHOR_SEGMENTS;
+}
+#endif
@@ -39,6 +39,7 @@
 //static void _calc_move_times(GCodeState_t *gms, const float position[]);
 static void _calc_move_times(GCodeState_t *gms, const float axis_length[], const float axis_square[]);
 static void _plan_block_list(mpBuf_t *bf, uint8_t *mr_flag);
+static void _commit_planned_block(mpBuf_t *bf, const float entry_unit[], const uint8_t move_type);
 static float _get_junction_vmax(const float a_unit[], const float b_unit[]);
 static void _reset_replannable_list(void);
 
@@ -95,9 +96,6 @@ uint8_t mp_get_runtime_busy()
 stat_t mp_aline(GCodeState_t *gm_in)
 {
 	mpBuf_t *bf; 						// current move pointer
-	float exact_stop = 0;				// preset this value OFF
-	float junction_velocity;
-	uint8_t mr_flag = false;
 
 	// compute some reusable terms
 	float axis_length[AXES];
@@ -224,6 +222,100 @@ stat_t mp_aline(GCodeState_t *gm_in)
 	// set up and pre-compute the jerk terms needed for this round of planning
 	bf->jerk = cm.a[bf->jerk_axis].jerk_max * JERK_MULTIPLIER / fabs(bf->unit[bf->jerk_axis]);	// scale the jerk
 
+	_commit_planned_block(bf, bf->unit, MOVE_TYPE_ALINE);
+	return (STAT_OK);
+}
+
+#ifdef __PLANNER_ARCS
+/*
+ * mp_arc() - plan an arc or helix as a single block
+ *
+ *	The arc is planned like a line of the same path length: one buffer, one trapezoid.
+ *	The differences are in the vectors handed to the velocity planner and the runtime:
+ *
+ *	  - The entry junction is computed against the tangent at the start of the arc, and
+ *		bf->unit[] is set to the tangent at the end of the arc so the next block sees the
+ *		correct junction. Axes other than the plane axes move linearly with path length,
+ *		so their unit vector terms are constant.
+ *
+ *	  - The tangent sweeps through the plane, so at some point along the arc either plane
+ *		axis may carry the whole planar component. Jerk is scaled by that worst case.
+ *
+ *	  - The curvature limit is applied once, by the caller, as part of the arc time
+ *		estimate. See _estimate_arc_time() in plan_arc.c.
+ *
+ *	The runtime interpolates the plane axes on the circle from the path distance run in
+ *	the block. See _exec_aline_segment().
+ *
+ *	gm_in->target must be the arc endpoint and gm_in->move_time the estimated arc time,
+ *	with any feed rate override already applied. The caller segments arcs that are too
+ *	short to plan as a block, or that arrive when no arc record is free (see cm_arc_feed()).
+ */
+
+stat_t mp_arc(GCodeState_t *gm_in, const mpArc_t *arc_in, const float length)
+{
+	mpBuf_t *bf;
+	float entry_unit[AXES];
+	float jerk = 0;
+	int8_t record = mp_get_arc_record();								// the caller checked there is one
+
+	// get a cleared buffer and setup move variables
+	if ((record < 0) || ((bf = mp_get_write_buffer()) == NULL))
+        return(cm_hard_alarm(STAT_BUFFER_FULL_FATAL));                  // never supposed to fail
+	bf->bf_func = mp_exec_aline;										// arcs run through the aline exec
+	bf->length = length;
+	memcpy(&bf->gm, gm_in, sizeof(GCodeState_t));						// copy model state into planner buffer
+	memcpy(&mb.arc[record], arc_in, sizeof(mpArc_t));					// geometry goes in the side pool
+	bf->move_code = record;
+
+	// compute the entry and exit tangents. Theta is measured from the positive plane_axis_1 direction
+	uint8_t p0 = arc_in->plane_axis_0;
+	uint8_t p1 = arc_in->plane_axis_1;
+	float theta = atan2(mm.position[p0] - arc_in->center_0, mm.position[p1] - arc_in->center_1);
+	float theta_end = theta + arc_in->theta_per_mm * length;
+	float planar_rate = arc_in->radius * arc_in->theta_per_mm;		// planar mm per mm of path (signed)
+
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		bf->unit[axis] = (gm_in->target[axis] - mm.position[axis]) / length;
+	}
+	copy_vector(entry_unit, bf->unit);
+	entry_unit[p0] = planar_rate * cos(theta);
+	entry_unit[p1] = -planar_rate * sin(theta);
+	bf->unit[p0] = planar_rate * cos(theta_end);
+	bf->unit[p1] = -planar_rate * sin(theta_end);
+
+	// find the jerk-limit axis using the worst case unit term for the plane axes
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		float unit = ((axis == p0) || (axis == p1)) ? fabs(planar_rate) : fabs(bf->unit[axis]);
+		if (unit > 0) {													// You cannot use the fp_XXX comparisons here!
+			float axis_jerk = cm.a[axis].jerk_max / unit;
+			if ((jerk == 0) || (axis_jerk < jerk)) {
+				jerk = axis_jerk;
+				bf->jerk_axis = axis;
+			}
+		}
+	}
+	bf->jerk = jerk * JERK_MULTIPLIER;
+
+	_commit_planned_block(bf, entry_unit, MOVE_TYPE_ARC);
+	return (STAT_OK);
+}
+#endif // __PLANNER_ARCS
+
+/*
+ * _commit_planned_block() - finish velocity planning for a new block and queue it
+ *
+ *	Expects length, unit vector, jerk and gm to be set in bf. The entry junction is
+ *	computed between the previous block's unit vector and entry_unit, which is the
+ *	block's own unit vector for lines.
+ */
+
+static void _commit_planned_block(mpBuf_t *bf, const float entry_unit[], const uint8_t move_type)
+{
+	float exact_stop = 0;				// preset this value OFF
+	float junction_velocity;
+	uint8_t mr_flag = false;
+
 	if (fabs(bf->jerk - mm.jerk) > JERK_MATCH_PRECISION) {	// specialized comparison for tolerance of delta
 		mm.jerk = bf->jerk;									// used before this point next time around
 		mm.recip_jerk = 1/bf->jerk;							// compute cached jerk terms used by planning
@@ -238,7 +330,7 @@ stat_t mp_aline(GCodeState_t *gm_in)
 		exact_stop = 8675309;								// an arbitrarily large floating point number
 	}
 	bf->cruise_vmax = bf->length / bf->gm.move_time;		// target velocity requested
-	junction_velocity = _get_junction_vmax(bf->pv->unit, bf->unit);
+	junction_velocity = _get_junction_vmax(bf->pv->unit, entry_unit);
 	bf->entry_vmax = min3(bf->cruise_vmax, junction_velocity, exact_stop);
 	bf->delta_vmax = mp_get_target_velocity(0, bf->length, bf);
 	bf->exit_vmax = min3(bf->cruise_vmax, (bf->entry_vmax + bf->delta_vmax), exact_stop);
@@ -247,13 +339,13 @@ stat_t mp_aline(GCodeState_t *gm_in)
 	// Note: these next lines must remain in exact order. Position must update before committing the buffer.
 	_plan_block_list(bf, &mr_flag);				// replan block list
 	copy_vector(mm.position, bf->gm.target);	// set the planner position
-	mp_commit_write_buffer(MOVE_TYPE_ALINE); 	// commit current block (must follow the position update)
-	return (STAT_OK);
+	mp_commit_write_buffer(move_type);		 	// commit current block (must follow the position update)
 }
 
 /***** ALINE HELPERS *****
  * _calc_move_times()
  * _plan_block_list()
+ * _commit_planned_block()
  * _get_junction_vmax()
  * _reset_replannable_list()
  */
@@ -280,6 +372,11 @@ stat_t mp_aline(GCodeState_t *gm_in)
  *	Sets the following variables in the gcode_state struct
  *	  - move_time is set to optimal time
  *	  - minimum_time is set to minimum time
+ *
+ *	Arc segments queued by cm_arc_callback() arrive with move_time set to their share of the
+ *	arc's limit time (axis and radius limits - see _estimate_arc_time()). The chord itself
+ *	doesn't show the radius limit, so that time is kept as a floor. Feed override is not
+ *	applied to the floor.
  */
 /* --- NIST RS274NGC_v3 Guidance ---
  *
@@ -324,8 +421,13 @@ static void _calc_move_times(GCodeState_t *gms, const float axis_length[], const
 	float abc_time=0;				// coordinated move rotary part at requested feed rate
 	float max_time=0;				// time required for the rate-limiting axis
 	float tmp_time=0;				// used in computation
+	float arc_time=0;				// limit time carried by an arc segment
 	gms->minimum_time = 8675309;	// arbitrarily large number
 
+	if ((gms->motion_mode == MOTION_MODE_CW_ARC) || (gms->motion_mode == MOTION_MODE_CCW_ARC)) {
+		arc_time = gms->move_time;
+	}
+
 	// compute times for feed motion
 	if (gms->motion_mode != MOTION_MODE_STRAIGHT_TRAVERSE) {
 		if (gms->feed_rate_mode == INVERSE_TIME_MODE) {
@@ -340,6 +442,10 @@ static void _calc_move_times(GCodeState_t *gms, const float axis_length[], const
 				abc_time = sqrt(axis_square[AXIS_A] + axis_square[AXIS_B] + axis_square[AXIS_C]) / gms->feed_rate;
 			}
 		}
+		// apply feed rate override (M50.1 or realtime). Not applied to homing, probing or jogging
+		inv_time = cm_apply_feed_override(inv_time);
+		xyz_time = cm_apply_feed_override(xyz_time);
+		abc_time = cm_apply_feed_override(abc_time);
 	}
 	for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
 		if (gms->motion_mode == MOTION_MODE_STRAIGHT_TRAVERSE) {
@@ -353,7 +459,7 @@ static void _calc_move_times(GCodeState_t *gms, const float axis_length[], const
 			gms->minimum_time = min(gms->minimum_time, tmp_time);
 		}
 	}
-	gms->move_time = max4(inv_time, max_time, xyz_time, abc_time);
+	gms->move_time = max(max4(inv_time, max_time, xyz_time, abc_time), arc_time);
 }
 
 /* _plan_block_list() - plans the entire block list
@@ -653,6 +759,11 @@ stat_t mp_plan_hold_callback()
 	float braking_length;                       // distance required to brake to zero from braking_velocity
 
 	// examine and process mr buffer
+#ifdef __PLANNER_ARCS
+	if (mr.move_type == MOVE_TYPE_ARC) {		// arcs measure what's left along the path, not the chord
+		mr_available_length = mr.head_length + mr.body_length + mr.tail_length - mr.arc_distance;
+	} else
+#endif
 	mr_available_length = get_axis_vector_length(mr.target, mr.position);
 
 /*	mr_available_length =
@@ -715,7 +826,7 @@ stat_t mp_plan_hold_callback()
 	bp->move_state = MOVE_NEW;					// tell _exec to re-use buffer
 	for (uint8_t i=0; i<PLANNER_BUFFER_POOL_SIZE; i++) {// a safety to avoid wraparound
 		mp_copy_buffer(bp, bp->nx);				// copy bp+1 into bp+0 (and onward...)
-		if (bp->move_type != MOVE_TYPE_ALINE) {	// skip any non-move buffers
+		if ((bp->move_type != MOVE_TYPE_ALINE) && (bp->move_type != MOVE_TYPE_ARC)) {	// skip any non-move buffers
 			bp = mp_get_next_buffer(bp);		// point to next buffer
 			continue;
 		}
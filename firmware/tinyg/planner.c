@@ -53,6 +53,7 @@
  */
 #include "tinyg.h"
 #include "config.h"
+#include "controller.h"
 #include "canonical_machine.h"
 #include "plan_arc.h"
 #include "planner.h"
@@ -400,6 +401,7 @@ uint8_t mp_free_run_buffer()					// EMPTY current run buf & adv to next
 	}
 	mb.buffers_available++;
 	qr_request_queue_report(-1);				// request a QR and add to the "removed buffers" count
+	controller_post_event(EVENT_PLANNER);		// wake a controller waiting for a planner buffer
 	return ((mb.w == mb.r) ? true : false); 	// return true if the queue emptied
 }
 
@@ -445,6 +447,32 @@ void mp_copy_buffer(mpBuf_t *bf, const mpBuf_t *bp)
 	bf->pv = pv;
 }
 
+#ifdef __PLANNER_ARCS
+/*
+ * mp_get_arc_record() - return the index of an arc geometry record no buffer uses, or -1
+ *
+ *	Arc geometry is kept in a small pool beside the planner buffers rather than in every
+ *	buffer. A MOVE_TYPE_ARC buffer names its record in bf->move_code. A record is free
+ *	when no buffer names it, so buffer clears and the buffer copies made when a feedhold
+ *	is planned need no bookkeeping. Called once per arc, never from the runtime.
+ */
+int8_t mp_get_arc_record()
+{
+	for (uint8_t i=0; i < PLANNER_ARC_POOL_SIZE; i++) {
+		uint8_t used = false;
+		for (uint8_t j=0; j < PLANNER_BUFFER_POOL_SIZE; j++) {
+			if ((mb.bf[j].buffer_state != MP_BUFFER_EMPTY) &&
+				(mb.bf[j].move_type == MOVE_TYPE_ARC) && (mb.bf[j].move_code == i)) {
+				used = true;
+				break;
+			}
+		}
+		if (used == false) return (i);
+	}
+	return (-1);
+}
+#endif
+
 /*
 // currently this routine is only used by debug routines
 uint8_t mp_get_buffer_index(mpBuf_t *bf)
@@ -38,6 +38,7 @@ extern "C"{
 enum moveType {				// bf->move_type values
 	MOVE_TYPE_NULL = 0,		// null move - does a no-op
 	MOVE_TYPE_ALINE,		// acceleration planned line
+	MOVE_TYPE_ARC,			// acceleration planned arc or helix
 	MOVE_TYPE_DWELL,		// delay with no movement
 	MOVE_TYPE_COMMAND,		// general command
 	MOVE_TYPE_TOOL,			// T command
@@ -103,6 +104,15 @@ enum sectionState {
 #define PLANNER_BUFFER_POOL_SIZE 32
 #define PLANNER_BUFFER_HEADROOM 4			// buffers to reserve in planner before processing new input line
 
+/* PLANNER_ARC_POOL_SIZE
+ *	Number of arc geometry records kept beside the planner buffers (see mp_get_arc_record()).
+ *	An arc that arrives when every record is in use is segmented instead. Limit is 127
+ */
+#define PLANNER_ARC_POOL_SIZE 8
+
+// Largest segment angle (radians) the runtime rotates by series sin and cos. See _next_arc_point()
+#define ARC_SERIES_MAX_THETA ((float)0.25)
+
 /* Some parameters for _generate_trapezoid()
  * TRAPEZOID_ITERATION_MAX	 				Max iterations for convergence in the HT asymmetric case.
  * TRAPEZOID_ITERATION_ERROR_PERCENT		Error percentage for iteration convergence. As percent - 0.01 = 1%
@@ -134,6 +144,15 @@ enum mpBufferState {				// bf->buffer_state values
 	MP_BUFFER_RUNNING				// current running buffer
 };
 
+typedef struct mpArc {				// arc geometry for MOVE_TYPE_ARC buffers - kept in mb.arc[]
+	float center_0;					// center of circle at plane axis 0 (e.g. X for G17)
+	float center_1;					// center of circle at plane axis 1 (e.g. Y for G17)
+	float radius;
+	float theta_per_mm;				// signed angular travel per mm of path length
+	uint8_t plane_axis_0;
+	uint8_t plane_axis_1;
+} mpArc_t;
+
 typedef struct mpBuffer {			// See Planning Velocity Notes for variable usage
 	struct mpBuffer *pv;			// static pointer to previous buffer
 	struct mpBuffer *nx;			// static pointer to next buffer
@@ -144,7 +163,7 @@ typedef struct mpBuffer {			// See Planning Velocity Notes for variable usage
 
 	uint8_t buffer_state;			// used to manage queuing/dequeuing
 	uint8_t move_type;				// used to dispatch to run routine
-	uint8_t move_code;				// byte that can be used by used exec functions
+	uint8_t move_code;				// byte that can be used by used exec functions (arcs: mb.arc[] index)
 	uint8_t move_state;				// move state machine sequence
 	uint8_t replannable;			// TRUE if move can be re-planned
 
@@ -181,6 +200,9 @@ typedef struct mpBufferPool {		// ring buffer for sub-moves
 	mpBuf_t *q;						// queue_write_buffer pointer
 	mpBuf_t *r;						// get/end_run_buffer pointer
 	mpBuf_t bf[PLANNER_BUFFER_POOL_SIZE];// buffer storage
+#ifdef __PLANNER_ARCS
+	mpArc_t arc[PLANNER_ARC_POOL_SIZE];	// arc geometry records - see mp_get_arc_record()
+#endif
 	magic_t magic_end;
 } mpBufferPool_t;
 
@@ -201,6 +223,7 @@ typedef struct mpMoveRuntimeSingleton {	// persistent runtime variables
 	uint8_t move_state;				// state of the overall move
 	uint8_t section;				// what section is the move in?
 	uint8_t section_state;			// state within a move section
+	uint8_t move_type;				// MOVE_TYPE_ALINE or MOVE_TYPE_ARC
 
 	float unit[AXES];				// unit vector for axis scaling & planning
 	float target[AXES];				// final target for bf (used to correct rounding errors)
@@ -227,6 +250,15 @@ typedef struct mpMoveRuntimeSingleton {	// persistent runtime variables
 	float segment_velocity;			// computed velocity for aline segment
 	float segment_time;				// actual time increment per aline segment
 	float jerk;						// max linear jerk
+
+#ifdef __PLANNER_ARCS
+	mpArc_t arc;					// copy of the bf arc geometry
+	float arc_theta;				// angle of the arc at the start of the block
+	float arc_distance;				// path distance run so far in the block
+	float arc_radius_0;				// radius vector from center to the current arc point
+	float arc_radius_1;
+	uint8_t arc_anchor_count;		// segments left before the radius vector is re-anchored
+#endif
 
 #ifdef __JERK_EXEC					// values used exclusively by computed jerk acceleration
 	float jerk_div2;				// cached value for efficiency
@@ -280,6 +312,10 @@ stat_t mp_dwell(const float seconds);
 void mp_end_dwell(void);
 
 stat_t mp_aline(GCodeState_t *gm_in);
+#ifdef __PLANNER_ARCS
+stat_t mp_arc(GCodeState_t *gm_in, const mpArc_t *arc_in, const float length);
+int8_t mp_get_arc_record(void);
+#endif
 
 stat_t mp_plan_hold_callback(void);
 stat_t mp_end_hold(void);
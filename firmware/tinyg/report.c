@@ -68,6 +68,51 @@ stat_t rpt_exception(uint8_t status)
 	return (status);			// makes it possible to inline, e.g: return(rpt_exception(status));
 }
 
+/*
+ * rpt_tx_ready() - true if a report needing reserve bytes of TX space can be sent now
+ *
+ *	The one reservation check for everything written outside a command response: status,
+ *	queue, rx and probe reports and streamed JSON responses. Nothing is sent while a JSON
+ *	response is held for TX space or a streamed response is part way out, so reports never
+ *	land inside or ahead of a response. A reserve larger than the TX buffer is capped, so
+ *	the report waits for an empty buffer instead of forever.
+ */
+uint8_t rpt_tx_ready(uint16_t reserve)
+{
+	if ((js.tx_pending != 0) || (js.tx_streaming == true)) {
+		return (false);
+	}
+	return (xio_get_tx_free() >= min(reserve, TX_BUFFER_SIZE));
+}
+
+/*
+ * rpt_probe_report() - stream a probe result as one compact record
+ *
+ *	Sent in place of the {"prb":null} response when $prbr is set. A record carries the
+ *	line number and all axes, so a host running many probes need not poll or count
+ *	extra responses against its line mode flow control. Returns STAT_EAGAIN until
+ *	there is TX room for the record (PRB_TX_RESERVE), so the caller can wait for it.
+ */
+stat_t rpt_probe_report()
+{
+	float *p = cm.probe_results;
+
+	if (rpt_tx_ready(PRB_TX_RESERVE) == false) {
+		return (STAT_EAGAIN);
+	}
+	if (cfg.comm_mode == TEXT_MODE) {
+		printf_P(PSTR("prb: e:%d, n:%lu, x:%0.3f, y:%0.3f, z:%0.3f, a:%0.3f, b:%0.3f, c:%0.3f\n"),
+			cm.probe_state, cm.probe_linenum, p[AXIS_X], p[AXIS_Y], p[AXIS_Z], p[AXIS_A], p[AXIS_B], p[AXIS_C]);
+	} else if (js.json_syntax == JSON_SYNTAX_RELAXED) {
+		printf_P(PSTR("{prb:{e:%d,n:%lu,x:%0.3f,y:%0.3f,z:%0.3f,a:%0.3f,b:%0.3f,c:%0.3f}}\n"),
+			cm.probe_state, cm.probe_linenum, p[AXIS_X], p[AXIS_Y], p[AXIS_Z], p[AXIS_A], p[AXIS_B], p[AXIS_C]);
+	} else {
+		printf_P(PSTR("{\"prb\":{\"e\":%d,\"n\":%lu,\"x\":%0.3f,\"y\":%0.3f,\"z\":%0.3f,\"a\":%0.3f,\"b\":%0.3f,\"c\":%0.3f}}\n"),
+			cm.probe_state, cm.probe_linenum, p[AXIS_X], p[AXIS_Y], p[AXIS_Z], p[AXIS_A], p[AXIS_B], p[AXIS_C]);
+	}
+	return (STAT_OK);
+}
+
 /*
  * rpt_er()	- send a bogus exception report for testing purposes (it's not real)
  */
@@ -161,6 +206,7 @@ void rpt_print_system_ready_message(void)
  */
 static stat_t _populate_unfiltered_status_report(void);
 static uint8_t _populate_filtered_status_report(void);
+static uint16_t _status_report_reserve(void);
 
 uint8_t _is_stat(nvObj_t *nv)
 {
@@ -288,6 +334,9 @@ stat_t sr_status_report_callback() 		// called by controller dispatcher
         return (STAT_NOOP);
 #endif
 
+	if (rpt_tx_ready(_status_report_reserve()) == false)	// no room - leave the request
+        return (STAT_NOOP);						// pending so the report is coalesced with any later request
+
 	sr.status_report_requested = false;		// disable reports until requested again
 
 	if (sr.status_report_verbosity == SR_VERBOSE) {
@@ -301,6 +350,21 @@ stat_t sr_status_report_callback() 		// called by controller dispatcher
 	return (STAT_OK);
 }
 
+/*
+ * _status_report_reserve() - TX space needed by the longest report the SR list can make
+ *
+ *	Sized from the configured elements, each at its longest serialized pair (see report.h).
+ */
+static uint16_t _status_report_reserve()
+{
+	uint16_t reserve = TX_RESPONSE_RESERVE + SR_TX_FRAME_LEN;
+	for (uint8_t i=0; i<NV_STATUS_REPORT_LEN; i++) {
+		if (sr.status_report_list[i] == 0) { break;}
+		reserve += SR_TX_PAIR_LEN;
+	}
+	return (reserve);
+}
+
 /*
  * sr_run_text_status_report() - generate a text mode status report in multiline format
  */
@@ -500,6 +564,9 @@ stat_t qr_queue_report_callback() 		// called by controller dispatcher
 	if (qr.queue_report_requested == false)
         return (STAT_NOOP);
 
+	if (rpt_tx_ready(QR_TX_RESERVE) == false)		// no room - qr values keep accumulating...
+        return (STAT_NOOP);						//...and the latest are sent when there is room
+
 	qr.queue_report_requested = false;
 
 	if (cfg.comm_mode == TEXT_MODE) {
@@ -537,8 +604,27 @@ void rx_request_rx_report(void) {
 
 /*
  * rx_report_callback() - send rx report if one has been requested
+ *
+ *	In credit flow control ($ex=3) this also sends the optional credit heartbeat
+ *	every $rxi milliseconds, so a host that is waiting on credits with nothing
+ *	else to read still hears when RX space frees up: {"cr":[bytes,lines]}
+ *	In text mode the heartbeat is cr:bytes,lines. Neither is sent without TX room;
+ *	a late heartbeat goes out as soon as there is.
  */
 stat_t rx_report_callback(void) {
+    if (rpt_tx_ready(RX_TX_RESERVE) == false)
+        return (STAT_NOOP);
+
+    if ((cfg.enable_flow_control == FLOW_CONTROL_CREDIT) && (rx.credit_report_interval != 0) &&
+        (SysTickTimer_getValue() >= rx.credit_report_systick)) {
+        rx.credit_report_systick = SysTickTimer_getValue() + rx.credit_report_interval;
+        if (cfg.comm_mode == TEXT_MODE) {
+            fprintf_P(stderr, PSTR("cr:%d,%d\n"), xio_get_usb_rx_credits(), xio_get_usb_line_credits());
+        } else {
+            fprintf_P(stderr, PSTR("{\"cr\":[%d,%d]}\n"), xio_get_usb_rx_credits(), xio_get_usb_line_credits());
+        }
+        return (STAT_OK);
+    }
     if (!rx.rx_report_requested)
         return (STAT_NOOP);
 
@@ -682,6 +768,9 @@ void qr_print_qi(nvObj_t *nv) { text_print_int(nv, fmt_qi);}
 void qr_print_qo(nvObj_t *nv) { text_print_int(nv, fmt_qo);}
 void qr_print_qv(nvObj_t *nv) { text_print_ui8(nv, fmt_qv);}
 
+static const char fmt_rxi[] PROGMEM = "[rxi] credit report interval%8lu ms [0=off]\n";
+void rx_print_rxi(nvObj_t *nv) { text_print_int(nv, fmt_rxi);}
+
 #endif // __TEXT_MODE
 
 #ifdef __cplusplus
@@ -40,6 +40,20 @@ extern "C"{
 
 #define MIN_ARC_QR_INTERVAL 200					// minimum interval between QRs during arc generation (in system ticks)
 
+// TX space a report needs before it is sent. All include TX_RESPONSE_RESERVE so a report
+// never takes the space the next command response needs. Reports that don't fit are left
+// pending and coalesced - the latest values are sent once the host has read enough.
+// See rpt_tx_ready(). The SR reserve is sized from the SR list - a frame plus the longest
+// pair per element. The longest value is what fntoa() writes for a float with a 32 bit
+// integer part at the highest precision used in the cfgArray.
+#define TX_VALUE_LEN (1 + 10 + 1 + 4)				// -4294967295.0000 (sign, uint32 digits, point, 4 places)
+#define SR_TX_FRAME_LEN 12							// {"sr":{}} plus CR LF and terminator
+#define SR_TX_PAIR_LEN (1 + TOKEN_LEN + 2 + TX_VALUE_LEN + 1)	// "token":value, (quoted token, colon, value, comma)
+#define QR_TX_RESERVE (TX_RESPONSE_RESERVE + 32)	// worst case triple queue report
+#define RX_TX_RESERVE (TX_RESPONSE_RESERVE + 24)	// {"cr":[65535,65535]} or {"rx":65535} plus CR LF
+#define PRB_TX_RESERVE (TX_RESPONSE_RESERVE + 20 + 6*(5 + TX_VALUE_LEN))	// {"prb":{"e":1,"n":4294967295, plus 6 axis pairs
+#define STREAM_TX_RESERVE (TX_RESPONSE_RESERVE + GROUP_LEN + 4 + SR_TX_PAIR_LEN)	// a streamed pair, in a group
+
 enum srVerbosity {								// status report enable and verbosity
 	SR_OFF = 0,									// no reports
 	SR_FILTERED,								// reports only values that have changed from the last report
@@ -89,6 +103,8 @@ typedef struct qrSingleton {		// data for queue reports
 } qrSingleton_t;
 
 typedef struct rxSingleton {
+    uint32_t credit_report_interval;    // ms between credit heartbeats in credit flow control; 0=off
+    uint32_t credit_report_systick;     // SysTick value for next credit heartbeat
     uint8_t rx_report_requested;
     uint16_t space_available;       // space available in usb rx buffer at time of request
 } rxSingleton_t;
@@ -103,6 +119,8 @@ extern rxSingleton_t rx;
 
 void rpt_print_message(char *msg);
 stat_t rpt_exception(uint8_t status);
+uint8_t rpt_tx_ready(uint16_t reserve);
+stat_t rpt_probe_report(void);
 
 stat_t rpt_er(nvObj_t *nv);
 void rpt_print_loading_configs_message(void);
@@ -140,6 +158,7 @@ stat_t qo_get(nvObj_t *nv);
 	void qr_print_qr(nvObj_t *nv);
 	void qr_print_qi(nvObj_t *nv);
 	void qr_print_qo(nvObj_t *nv);
+	void rx_print_rxi(nvObj_t *nv);
 
 #else
 
@@ -150,6 +169,7 @@ stat_t qo_get(nvObj_t *nv);
 	#define qr_print_qr tx_print_stub
 	#define qr_print_qi tx_print_stub
 	#define qr_print_qo tx_print_stub
+	#define rx_print_rxi tx_print_stub
 
 #endif // __TEXT_MODE
 
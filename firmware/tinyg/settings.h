@@ -42,8 +42,18 @@
 
 // Machine configuration settings
 #define CHORDAL_TOLERANCE 			0.01					// chordal accuracy for arc drawing
+#define FOLLOWING_ERROR_THRESHOLD	0						// steps of following error to alarm on. 0 = off
+#define FOLLOWING_ERROR_SEGMENTS	5						// consecutive segments over threshold to alarm
+#define CALIBRATION_JERK_LIMIT		2.0						// calibration sweeps jerk up to this multiple of $xjm
+#define CALIBRATION_VELOCITY_LIMIT	1.5						// ...and velocity up to this multiple of $xvm
+#define CALIBRATION_TRIALS			8						// number of trials in the sweep
+#define CALIBRATION_START_SCALE		0.5						// first trial runs at this multiple of $xjm and $xvm
+#define CALIBRATION_TOLERANCE		0.02					// mm (or deg) of latch shift counted as step loss
+#define CALIBRATION_MARGIN			0.8						// recommended settings are this fraction of what held
 #define SOFT_LIMIT_ENABLE			0						// 0 = off, 1 = on
 #define SWITCH_TYPE 				SW_TYPE_NORMALLY_OPEN	// one of: SW_TYPE_NORMALLY_OPEN, SW_TYPE_NORMALLY_CLOSED
+#define PROBE_SWITCH				SW_MIN_Z				// switch input used by G38.x probing (swNums)
+#define PROBE_REPORT_ENABLE			0						// 0 = report {"prb":...} as a response, 1 = stream probe records
 
 #define MOTOR_POWER_MODE			MOTOR_POWERED_IN_CYCLE	// one of: MOTOR_DISABLED					(0)
 															//		   MOTOR_ALWAYS_POWERED				(1)
@@ -61,6 +71,7 @@
 #define JSON_VERBOSITY				JV_MESSAGES				// one of: JV_SILENT, JV_FOOTER, JV_CONFIGS, JV_MESSAGES, JV_LINENUM, JV_VERBOSE
 #define JSON_SYNTAX_MODE 			JSON_SYNTAX_STRICT		// one of JSON_SYNTAX_RELAXED, JSON_SYNTAX_STRICT
 #define JSON_FOOTER_DEPTH			0						// 0 = new style, 1 = old style
+#define JSON_PARSER_MODE			JSON_MODE_LIST			// one of JSON_MODE_LIST, JSON_MODE_STREAMING
 
 #define STATUS_REPORT_VERBOSITY		SR_FILTERED				// one of: SR_OFF, SR_FILTERED, SR_VERBOSE=
 #define STATUS_REPORT_MIN_MS		100						// milliseconds - enforces a viable minimum
@@ -81,7 +92,8 @@
 // Comm mode and echo levels
 #define COM_EXPAND_CR				false
 #define COM_ENABLE_ECHO				false
-#define COM_ENABLE_FLOW_CONTROL		FLOW_CONTROL_XON		// FLOW_CONTROL_OFF, FLOW_CONTROL_XON, FLOW_CONTROL_RTS
+#define COM_ENABLE_FLOW_CONTROL		FLOW_CONTROL_XON		// FLOW_CONTROL_OFF, FLOW_CONTROL_XON, FLOW_CONTROL_RTS, FLOW_CONTROL_CREDIT
+#define COM_CREDIT_REPORT_INTERVAL	0						// ms between credit heartbeats in credit mode; 0=off
 
 //**** DEBUG SETTINGS ****
 
@@ -117,6 +129,68 @@
 
 /*** Handle optional modules that may not be in every machine ***/
 
+// Encoder wiring and scaling (__ENCODERS only). Phase A on ENCODER_PIN_bp, phase B on the next pin
+#ifndef ENCODER_MOTOR
+#define ENCODER_MOTOR					MOTOR_1
+#define ENCODER_PORT					PORTB
+#define ENCODER_PIN_bp					0
+#define ENCODER_EVSYS_CHMUX				EVSYS_CHMUX_PORTB_PIN0_gc	// must agree with port and pin
+#define ENCODER_STEPS_PER_COUNT			1.0						// motor steps per encoder count (4x decoded)
+#endif
+
+// If the profile does not set homing groups home one axis at a time: Z, X, Y, then A.
+// Give axes the same group number to home them together, e.g. X and Y both 2.
+#ifndef X_HOMING_GROUP
+#define X_HOMING_GROUP					2
+#define Y_HOMING_GROUP					3
+#define Z_HOMING_GROUP					1
+#define A_HOMING_GROUP					4
+#endif
+
+// If the profile does not set up gantry squaring every motor homes on its axis switch
+// Set Mn_HOMING_SWITCH to a switch number+1 (e.g. 4 = ymax) to stop that motor on its own switch
+#ifndef M1_HOMING_SWITCH
+#define M1_HOMING_SWITCH				0
+#define M2_HOMING_SWITCH				0
+#define M3_HOMING_SWITCH				0
+#define M4_HOMING_SWITCH				0
+#define M5_HOMING_SWITCH				0
+#define M6_HOMING_SWITCH				0
+#endif
+#ifndef M1_SQUARING_OFFSET
+#define M1_SQUARING_OFFSET				0
+#define M2_SQUARING_OFFSET				0
+#define M3_SQUARING_OFFSET				0
+#define M4_SQUARING_OFFSET				0
+#define M5_SQUARING_OFFSET				0
+#define M6_SQUARING_OFFSET				0
+#endif
+
+// If the profile does not set up a height map probe a 3 x 3 grid on 10 mm centers
+#ifndef HEIGHT_MAP_COLUMNS
+#define HEIGHT_MAP_ORIGIN_X				0						// machine coordinates, mm
+#define HEIGHT_MAP_ORIGIN_Y				0
+#define HEIGHT_MAP_SPACING_X			10
+#define HEIGHT_MAP_SPACING_Y			10
+#define HEIGHT_MAP_COLUMNS				3
+#define HEIGHT_MAP_ROWS					3
+#define HEIGHT_MAP_PROBE_DEPTH			-10						// machine Z to probe down to
+#define HEIGHT_MAP_CLEARANCE			-5						// machine Z to travel at between points
+#define HEIGHT_MAP_FEED_RATE			100						// mm/min
+#endif
+
+// If the profile does not set kinematics assume a cartesian machine
+#ifndef KINEMATICS
+#define KINEMATICS						KIN_CARTESIAN			// one of: KIN_CARTESIAN, KIN_COREXY, KIN_HBOT, KIN_DELTA
+#define DELTA_ARM_LENGTH				250						// mm - diagonal rod length
+#define DELTA_RADIUS					125						// mm - center to carriage rod joint, horizontal
+#endif
+
+// If the profile does not set an arc centripetal acceleration use the cornering value
+#ifndef ARC_ACCELERATION
+#define ARC_ACCELERATION				JUNCTION_ACCELERATION	// mm/min^2 - 0 disables the acceleration term
+#endif
+
 // If PWM_1 is not defined fill it with default values
 #ifndef	P1_PWM_FREQUENCY
 
@@ -75,8 +75,16 @@ float cm_get_spindle_pwm( uint8_t spindle_mode )
 		if( cm.gm.spindle_speed < speed_lo ) cm.gm.spindle_speed = speed_lo;
 		if( cm.gm.spindle_speed > speed_hi ) cm.gm.spindle_speed = speed_hi;
 
+		// apply spindle override, then clamp again
+		float speed = cm.gm.spindle_speed;
+		if ((cm.gmx.spindle_override_enable == true) && (cm.gmx.spindle_override_factor > 0)) {
+			speed *= cm.gmx.spindle_override_factor;
+			if( speed < speed_lo ) speed = speed_lo;
+			if( speed > speed_hi ) speed = speed_hi;
+		}
+
 		// normalize speed to [0..1]
-		float speed = (cm.gm.spindle_speed - speed_lo) / (speed_hi - speed_lo);
+		speed = (speed - speed_lo) / (speed_hi - speed_lo);
 		return (speed * (phase_hi - phase_lo)) + phase_lo;
 	} else {
 		return pwm.c[PWM_1].phase_off;
@@ -154,6 +162,19 @@ static void _exec_spindle_speed(float *value, float *flag)
 	pwm_set_duty(PWM_1, cm_get_spindle_pwm(cm.gm.spindle_mode) ); // update spindle speed if we're running
 }
 
+/*
+ * cm_adjust_spindle_override() - apply realtime spindle override steps
+ *
+ *	Unlike feed overrides this takes effect immediately by updating the spindle PWM.
+ */
+void cm_adjust_spindle_override(uint8_t reset, int8_t steps)
+{
+	if (cm.gmx.spindle_override_enable == false) reset = true;
+	cm.gmx.spindle_override_factor = cm_step_override_factor(cm.gmx.spindle_override_factor, reset, steps);
+	cm.gmx.spindle_override_enable = true;
+	pwm_set_duty(PWM_1, cm_get_spindle_pwm(cm.gm.spindle_mode) );
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -31,9 +31,11 @@
 
 #include "tinyg.h"
 #include "config.h"
+#include "controller.h"
 #include "stepper.h"
 #include "encoder.h"
 #include "planner.h"
+#include "kinematics.h"
 #include "report.h"
 #include "hardware.h"
 #include "text_parser.h"
@@ -310,6 +312,7 @@ void st_reset()
 		st_run.mot[motor].substep_accumulator = 0;	// will become max negative during per-motor setup;
 		st_pre.mot[motor].corrected_steps = 0;		// diagnostic only - no action effect
 	}
+	st_pre.motor_inhibit = 0;
 	mp_set_steps_to_runtime_position();
 }
 
@@ -659,6 +662,7 @@ ISR(TIMER_EXEC_ISR_vect) {								// exec move SW interrupt
 			st_pre.buffer_state = PREP_BUFFER_OWNED_BY_LOADER; // flip it back
 			_request_load_move();
 		}
+		controller_post_event(EVENT_PLANNER);			// runtime state may have changed (holds, move ends)
 	}
 }
 #endif // __AVR
@@ -941,6 +945,8 @@ static void _load_move()
 		}
 		ACCUMULATE_ENCODER(MOTOR_6);
 #endif
+		LATCH_ENCODERS();								// measured positions overwrite counted steps
+
 		//**** do this last ****
 
 		TIMER_DDA.PER = st_pre.dda_period;
@@ -1012,6 +1018,10 @@ stat_t st_prep_line(float travel_steps[], float following_error[], float segment
 		// Skip this motor if there are no new steps. Leave all other values intact.
 		if (fp_ZERO(travel_steps[motor])) { st_pre.mot[motor].substep_increment = 0; continue;}
 
+		// Inhibited motors (gantry squaring) are held in place. Zeroing the increment here
+		// keeps both the loader and the DDA ISR free of any additional per-motor tests.
+		if (st_pre.motor_inhibit & (1<<motor)) { st_pre.mot[motor].substep_increment = 0; continue;}
+
 		// Setup the direction, compensating for polarity.
 		// Set the step_sign which is used by the stepper ISR to accumulate step position
 
@@ -1065,6 +1075,34 @@ stat_t st_prep_line(float travel_steps[], float following_error[], float segment
 	return (STAT_OK);
 }
 
+/*
+ * st_set_motor_inhibit() - suppress step output for the motors in the mask
+ *
+ *	Used by homing to square a gantry: each motor of a ganged axis is stopped as
+ *	its own switch trips while the remaining motors continue. The mask is applied
+ *	at prep time, and the increments already staged in the prep buffer and running
+ *	in the DDA are zeroed so the motor stops on the next DDA tick rather than at
+ *	the end of the segment. May be called from the switch interrupt.
+ */
+
+void st_set_motor_inhibit(const uint8_t mask)
+{
+#ifdef __AVR
+	uint8_t sreg = SREG;
+	cli();
+#endif
+	st_pre.motor_inhibit = mask;
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		if (mask & (1<<motor)) {
+			st_pre.mot[motor].substep_increment = 0;
+			st_run.mot[motor].substep_increment = 0;
+		}
+	}
+#ifdef __AVR
+	SREG = sreg;
+#endif
+}
+
 /*
  * st_prep_null() - Keeps the loader happy. Otherwise performs no action
  */
@@ -1159,16 +1197,25 @@ static void _set_motor_steps_per_unit(nvObj_t *nv)
 	uint8_t m = _get_motor(nv);
 //	st_cfg.mot[m].units_per_step = (st_cfg.mot[m].travel_rev * st_cfg.mot[m].step_angle) / (360 * st_cfg.mot[m].microsteps); // unused
     st_cfg.mot[m].steps_per_unit = (360 * st_cfg.mot[m].microsteps) / (st_cfg.mot[m].travel_rev * st_cfg.mot[m].step_angle);
+	kin_update_motor_map();
 	st_reset();
 }
 
 /* PER-MOTOR FUNCTIONS
+ * st_set_ma() - set motor map to axis
  * st_set_sa() - set motor step angle
  * st_set_tr() - set travel per motor revolution
  * st_set_mi() - set motor microsteps
  * st_set_pm() - set motor power mode
  * st_set_pl() - set motor power level
  */
+
+stat_t st_set_ma(nvObj_t *nv)			// motor map to axis
+{
+	set_ui8(nv);
+	kin_update_motor_map();
+	return(STAT_OK);
+}
 
 stat_t st_set_sa(nvObj_t *nv)			// motor step angle
 {
@@ -1308,6 +1355,8 @@ static const char fmt_0mi[] PROGMEM = "[%s%s] m%s microsteps%16d [1,2,4,8]\n";
 static const char fmt_0po[] PROGMEM = "[%s%s] m%s polarity%18d [0=normal,1=reverse]\n";
 static const char fmt_0pm[] PROGMEM = "[%s%s] m%s power management%10d [0=disabled,1=always on,2=in cycle,3=when moving]\n";
 static const char fmt_0pl[] PROGMEM = "[%s%s] m%s motor power level%13.3f [0.000=minimum, 1.000=maximum]\n";
+static const char fmt_0hs[] PROGMEM = "[%s%s] m%s homing switch%13d [0=axis switch,1-8=own switch]\n";
+static const char fmt_0so[] PROGMEM = "[%s%s] m%s squaring offset%13.3f%s\n";
 static const char fmt_pwr[] PROGMEM = "Motor %c power enabled state:%2.0f\n";
 
 void st_print_mt(nvObj_t *nv) { text_print_flt(nv, fmt_mt);}
@@ -1341,6 +1390,8 @@ void st_print_mi(nvObj_t *nv) { _print_motor_ui8(nv, fmt_0mi);}
 void st_print_po(nvObj_t *nv) { _print_motor_ui8(nv, fmt_0po);}
 void st_print_pm(nvObj_t *nv) { _print_motor_ui8(nv, fmt_0pm);}
 void st_print_pl(nvObj_t *nv) { _print_motor_flt(nv, fmt_0pl);}
+void st_print_hs(nvObj_t *nv) { _print_motor_ui8(nv, fmt_0hs);}
+void st_print_so(nvObj_t *nv) { _print_motor_flt_units(nv, fmt_0so, cm_get_units_mode(MODEL));}
 void st_print_pwr(nvObj_t *nv){ _print_motor_pwr(nv, fmt_pwr);}
 
 #endif // __TEXT_MODE
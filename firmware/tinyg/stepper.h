@@ -344,6 +344,8 @@ typedef struct cfgMotor {				// per-motor configs
 	uint8_t polarity;					// 0=normal polarity, 1=reverse motor direction
 	uint8_t power_mode;					// See cmMotorPowerMode for enum
 	float power_level;					// set 0.000 to 1.000 for PMW vref setting
+	uint8_t homing_switch;				// own homing switch for squaring: 0=use axis switch, 1-N=switch number+1
+	float squaring_offset;				// offset moved from this motor's switch after squaring (mm or deg)
 	float step_angle;					// degrees per whole step (ex: 1.8)
 	float travel_rev;					// mm or deg of travel per motor revolution
 	float steps_per_unit;				// microsteps per mm (or degree) of travel
@@ -407,6 +409,7 @@ typedef struct stPrepSingleton {
 	uint16_t dda_period;				// DDA or dwell clock period setting
 	uint32_t dda_ticks;					// DDA or dwell ticks for the move
 	uint32_t dda_ticks_X_substeps;		// DDA ticks scaled by substep factor
+	volatile uint8_t motor_inhibit;		// bitmask of motors whose step output is suppressed (squaring)
 	stPrepMotor_t mot[MOTORS];			// prep time motor structs
 	uint16_t magic_end;
 } stPrepSingleton_t;
@@ -429,6 +432,7 @@ stat_t st_clc(nvObj_t *nv);
 void st_energize_motors(void);
 void st_deenergize_motors(void);
 void st_set_motor_power(const uint8_t motor);
+void st_set_motor_inhibit(const uint8_t mask);
 stat_t st_motor_power_callback(void);
 
 void st_request_exec_move(void);
@@ -437,6 +441,7 @@ void st_prep_command(void *bf);		// use a void pointer since we don't know about
 void st_prep_dwell(float microseconds);
 stat_t st_prep_line(float travel_steps[], float following_error[], float segment_time);
 
+stat_t st_set_ma(nvObj_t *nv);
 stat_t st_set_sa(nvObj_t *nv);
 stat_t st_set_tr(nvObj_t *nv);
 stat_t st_set_mi(nvObj_t *nv);
@@ -457,6 +462,8 @@ stat_t st_set_me(nvObj_t *nv);
 	void st_print_po(nvObj_t *nv);
 	void st_print_pm(nvObj_t *nv);
 	void st_print_pl(nvObj_t *nv);
+	void st_print_hs(nvObj_t *nv);
+	void st_print_so(nvObj_t *nv);
 	void st_print_pwr(nvObj_t *nv);
 	void st_print_mt(nvObj_t *nv);
 	void st_print_me(nvObj_t *nv);
@@ -471,6 +478,8 @@ stat_t st_set_me(nvObj_t *nv);
 	#define st_print_po tx_print_stub
 	#define st_print_pm tx_print_stub
 	#define st_print_pl tx_print_stub
+	#define st_print_hs tx_print_stub
+	#define st_print_so tx_print_stub
 	#define st_print_pwr tx_print_stub
 	#define st_print_mt tx_print_stub
 	#define st_print_me tx_print_stub
@@ -43,9 +43,13 @@
 
 #include "tinyg.h"
 #include "config.h"
+#include "controller.h"
 #include "switch.h"
 #include "hardware.h"
 #include "canonical_machine.h"
+#include "planner.h"
+#include "kinematics.h"
+#include "encoder.h"
 #include "text_parser.h"
 
 static void _switch_isr_helper(uint8_t sw_num);
@@ -117,9 +121,14 @@ static void _switch_isr_helper(uint8_t sw_num)
 {
 	if (sw.mode[sw_num] == SW_MODE_DISABLED) return;	// this is never supposed to happen
 	if (sw.debounce[sw_num] == SW_LOCKOUT) return;		// exit if switch is in lockout
+	if (sw.debounce[sw_num] == SW_IDLE) {				// first edge of an event - capture the position
+		en_capture_steps(sw.edge_steps[sw_num]);
+		sw.edge_captured |= (1<<sw_num);
+	}
 	sw.debounce[sw_num] = SW_DEGLITCHING;				// either transitions state from IDLE or overwrites it
 	sw.count[sw_num] = -SW_DEGLITCH_TICKS;				// reset deglitch count regardless of entry state
 	read_switch(sw_num);							// sets the state value in the struct
+	controller_post_event(EVENT_SWITCH);
 }
 
 void switch_rtc_callback(void)
@@ -133,6 +142,7 @@ void switch_rtc_callback(void)
             // check if the state has changed while we were in lockout...
             uint8_t old_state = sw.state[i];
             if(old_state != read_switch(i)) {
+                sw.edge_captured &= ~(1<<i);			// the edge was masked by the lockout
                 sw.debounce[i] = SW_DEGLITCHING;
                 sw.count[i] = -SW_DEGLITCH_TICKS;
             }
@@ -143,7 +153,9 @@ void switch_rtc_callback(void)
 			sw.debounce[i] = SW_LOCKOUT;
 //			sw_show_switch();							// only called if __DEBUG enabled
 
-			if ((cm.cycle_state == CYCLE_HOMING) || (cm.cycle_state == CYCLE_PROBE)) {		// regardless of switch type
+			if ((cm.cycle_state == CYCLE_HOMING) && (cm_homing_switch_latch(i) == true)) {
+				// homing took the switch (group latch or gantry squaring) - let the move run
+			} else if ((cm.cycle_state == CYCLE_HOMING) || (cm.cycle_state == CYCLE_PROBE)) {		// regardless of switch type
 				cm_request_feedhold();
 			} else if (sw.mode[i] & SW_LIMIT_BIT) {		// should be a limit switch, so fire it.
 				sw.limit_flag = true;					// triggers an emergency shutdown
@@ -178,6 +190,44 @@ void reset_switches()
         read_switch(i);
 	}
 	sw.limit_flag = false;
+	sw.edge_captured = 0;
+}
+
+/*
+ * sw_clear_edge() 		 - forget the captured edge of a switch before a move that watches it
+ * sw_get_edge_position() - return the machine position at the last captured edge of a switch
+ *
+ *	The pin interrupt captures the motor step positions on the first edge of each switch
+ *	event, before deglitching. Deglitching and lockout then only qualify the event, so
+ *	homing and probing can use the position of the edge itself rather than wherever the
+ *	machine was when the feedhold took effect. The step positions are converted to
+ *	absolute machine coordinates with forward kinematics.
+ *
+ *	sw_get_edge_position() returns false if no edge was captured since the last clear (or
+ *	the edge fell in a lockout). position[] then holds the runtime position.
+ */
+void sw_clear_edge(uint8_t sw_num)
+{
+	cli();
+	sw.edge_captured &= ~(1<<sw_num);
+	sei();
+}
+
+uint8_t sw_get_edge_position(uint8_t sw_num, float position[])
+{
+	float steps[MOTORS];
+
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		position[axis] = mp_get_runtime_absolute_position(axis);
+	}
+	if ((sw.edge_captured & (1<<sw_num)) == 0) {
+		return (false);
+	}
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		steps[motor] = (float)sw.edge_steps[sw_num][motor];
+	}
+	fk_kinematics(steps, position);
+	return (true);
 }
 
 /*
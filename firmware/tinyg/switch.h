@@ -145,6 +145,8 @@ struct swStruct {								// switch state
 	volatile uint8_t mode[NUM_SWITCHES];		// 0=disabled, 1=homing, 2=homing+limit, 3=limit
 	volatile uint8_t debounce[NUM_SWITCHES];	// switch debouncer state machine - see swDebounce
 	volatile int8_t count[NUM_SWITCHES];		// deglitching and lockout counter
+	volatile uint8_t edge_captured;				// bit per switch - edge_steps holds its latest edge
+	int32_t edge_steps[NUM_SWITCHES][MOTORS];	// motor step positions captured at the edge
 };
 struct swStruct sw;
 
@@ -184,6 +186,8 @@ uint8_t get_limit_switch_thrown(void);
 uint8_t get_switch_thrown(void);
 void reset_switches(void);
 void sw_show_switch(void);
+void sw_clear_edge(uint8_t sw_num);
+uint8_t sw_get_edge_position(uint8_t sw_num, float position[]);
 
 void set_switch_type( uint8_t switch_type );
 uint8_t get_switch_type();
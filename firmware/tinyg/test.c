@@ -42,6 +42,8 @@
 #include "tests/test_012_slow_moves.h"		// slow move test
 #include "tests/test_013_coordinate_offsets.h"	// what it says
 #include "tests/test_014_microsteps.h"		// test all microstep settings
+#include "tests/test_015_arc_accuracy.h"	// arc segment generator endpoint accuracy
+#include "tests/test_016_kinematics.h"		// kinematics transform segment load
 #include "tests/test_050_mudflap.h"			// mudflap test - entire drawing
 #include "tests/test_051_braid.h"			// braid test - partial drawing
 
@@ -77,6 +79,8 @@ uint8_t run_test(nvObj_t *nv)
 		case 12: { xio_open(XIO_DEV_PGM, PGMFILE(&test_slow_moves),PGM_FLAGS); break;}
 		case 13: { xio_open(XIO_DEV_PGM, PGMFILE(&test_coordinate_offsets),PGM_FLAGS); break;}
 		case 14: { xio_open(XIO_DEV_PGM, PGMFILE(&test_microsteps),PGM_FLAGS); break;}
+		case 15: { xio_open(XIO_DEV_PGM, PGMFILE(&test_arc_accuracy),PGM_FLAGS); break;}
+		case 16: { xio_open(XIO_DEV_PGM, PGMFILE(&test_kinematics),PGM_FLAGS); break;}
 		case 50: { xio_open(XIO_DEV_PGM, PGMFILE(&test_mudflap),PGM_FLAGS); break;}
 		case 51: { xio_open(XIO_DEV_PGM, PGMFILE(&test_braid),PGM_FLAGS); break;}
 #endif
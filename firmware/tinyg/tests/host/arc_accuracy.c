@@ -0,0 +1,304 @@
+/*
+ * arc_accuracy.c - host check of arc segment accuracy
+ *
+ *	Standalone - not part of the firmware build. Build and run from firmware/tinyg:
+ *
+ *		gcc -O2 -o arc_accuracy tests/host/arc_accuracy.c -lm
+ *		./arc_accuracy tests/test_004_arcs.h ../../gcode_samples/circles2.gcode
+ *
+ *	Runs the G2/G3 blocks of each file through a copy of the _compute_arc() math in
+ *	single precision (double is float on the xmega) and generates the segments three ways:
+ *
+ *	  accum - sin/cos of the accumulated theta (cm_arc_callback() before the recurrence)
+ *	  recur - rotation recurrence re-anchored every ARC_ANCHOR_SEGMENTS (cm_arc_callback())
+ *	  exact - sin/cos of theta + n * arc_segment_theta for every segment
+ *
+ *	Errors are measured in double precision against the arc through the same center:
+ *
+ *	  endpoint - distance from the last segment endpoint to the programmed target
+ *	  chordal  - worst distance of a segment endpoint or chord midpoint from the arc
+ *
+ *	Segment counts use the chordal tolerance and segment length limits only. The time
+ *	limit depends on feed rates and machine settings and can only lower the count,
+ *	which shortens the recurrence runs, so this is the worst case for drift.
+ *	G-code files are read in mm unless they select G20; .h test files are read from
+ *	their PROGMEM string.
+ *
+ *	Each file is run twice. An arc that ends where it starts with the endpoint given
+ *	(e.g. G2 X0 Y0 I20 from X0 Y0) gets no angular travel from _compute_arc() - only a
+ *	full circle with no endpoint words turns - so the first pass measures the arcs as the
+ *	firmware runs them and the second runs those closed arcs as full circles.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+// settings mirrored from the firmware - see plan_arc.h, planner.h and settings.h
+#define ARC_ANCHOR_SEGMENTS		16
+#define ARC_RADIUS_ERROR_MAX	((float)1.0)
+#define ARC_RADIUS_ERROR_MIN	((float)0.005)
+#define ARC_RADIUS_TOLERANCE	((float)0.001)
+#define CHORDAL_TOLERANCE		((float)0.01)
+#define ARC_SEGMENT_LENGTH		((float)0.1)
+#define MM_PER_INCH				25.4
+#define EPSILON					((float)0.00001)
+#define fp_EQ(a,b) (fabs(a-b) < EPSILON)
+
+enum { GEN_ACCUM = 0, GEN_RECUR, GEN_EXACT, GEN_COUNT };
+static const char *gen_name[GEN_COUNT] = { "accum", "recur", "exact" };
+
+typedef struct {
+	double endpoint;					// worst endpoint error over the file
+	double radial;						// worst segment endpoint distance from the arc
+	double chordal;						// worst chordal error over the file
+	long segments;
+} errors_t;
+
+typedef struct {						// modal state of the little interpreter
+	int motion;							// 0, 1, 2 or 3
+	int plane;							// 17, 18 or 19
+	int inches;
+	int incremental;
+	float position[3];
+} gcode_t;
+
+/*
+ * _run_arc() - compute one arc as _compute_arc() does and measure each generator
+ */
+static int _run_arc(const gcode_t *g, const float target[], const float offset[], float radius_word,
+					int have_plane_target, int run_closed, errors_t err[], int *arcs, int *closed)
+{
+	int a0 = 0, a1 = 1, lin = 2;
+	if (g->plane == 18) { a0 = 0; a1 = 2; lin = 1;}
+	if (g->plane == 19) { a0 = 1; a1 = 2; lin = 0;}
+	float off[3] = { offset[0], offset[1], offset[2] };
+	float radius = radius_word;
+
+	if (radius != 0) {					// _compute_arc_offsets_from_radius()
+		float x = target[a0] - g->position[a0];
+		float y = target[a1] - g->position[a1];
+		float disc = 4 * radius*radius - (x*x + y*y);
+		float h_x2_div_d = (disc > 0) ? -sqrtf(disc) / hypotf(x,y) : 0;
+		if (g->motion == 3) { h_x2_div_d = -h_x2_div_d;}
+		if (radius < 0) { h_x2_div_d = -h_x2_div_d;}
+		off[a0] = (x-(y*h_x2_div_d))/2;
+		off[a1] = (y+(x*h_x2_div_d))/2;
+	} else {
+		radius = hypotf(-off[a0], -off[a1]);
+	}
+	float end_0 = target[a0] - g->position[a0] - off[a0];
+	float end_1 = target[a1] - g->position[a1] - off[a1];
+	float e = fabsf(hypotf(end_0, end_1) - radius);
+	if ((e > ARC_RADIUS_ERROR_MAX) || ((e < ARC_RADIUS_ERROR_MIN) && (e > radius * ARC_RADIUS_TOLERANCE))) {
+		return (-1);					// STAT_ARC_SPECIFICATION_ERROR
+	}
+	float theta = atan2f(-off[a0], -off[a1]);
+	float g18 = (g->plane == 18) ? -1 : 1;
+	float angular_travel = 0;
+	if (have_plane_target) {
+		float theta_end = atan2f(end_0, end_1);
+		if (fp_EQ(theta_end, theta) && fp_EQ(target[a0], g->position[a0]) && fp_EQ(target[a1], g->position[a1])) {
+			(*closed)++;				// ends where it starts - the firmware gives it no angular travel
+			if (run_closed) { have_plane_target = 0;}
+		}
+	}
+	if (have_plane_target) {
+		float theta_end = atan2f(end_0, end_1);
+		if (!fp_EQ(theta_end, theta)) {
+			if (theta_end < theta) { theta_end += (2*M_PI * g18);}
+			angular_travel = theta_end - theta;
+			if (g->motion == 3) { angular_travel -= (2*M_PI * g18);}
+		}
+	} else {							// full circle - P is not supported here
+		angular_travel = (g->motion == 2) ? 2*M_PI*g18 : -2*M_PI*g18;
+	}
+	float linear_travel = target[lin] - g->position[lin];
+	float length = hypotf(angular_travel * radius, linear_travel);
+	if (length < EPSILON) { return (0);}	// STAT_MINIMUM_LENGTH_MOVE - nothing runs
+
+	float for_chordal = length / sqrtf(4*CHORDAL_TOLERANCE * (2 * radius - CHORDAL_TOLERANCE));
+	float for_distance = length / ARC_SEGMENT_LENGTH;
+	float segments = floorf(fminf(for_chordal, for_distance));
+	if (segments < 1) { segments = 1;}
+	float segment_theta = angular_travel / segments;
+	float segment_sin = sinf(segment_theta);
+	float segment_cos = cosf(segment_theta);
+	float radius_0 = sinf(theta) * radius;
+	float radius_1 = cosf(theta) * radius;
+	float center_0 = g->position[a0] - radius_0;
+	float center_1 = g->position[a1] - radius_1;
+	long n_segments = (long)segments;
+
+	for (int gen = 0; gen < GEN_COUNT; gen++) {
+		float r0 = radius_0, r1 = radius_1, accum = theta;
+		double prev_0 = g->position[a0], prev_1 = g->position[a1];
+		double radial = 0, chordal = 0;
+		for (long s = 1; s <= n_segments; s++) {
+			if (gen == GEN_ACCUM) {
+				accum += segment_theta;
+				r0 = sinf(accum) * radius;
+				r1 = cosf(accum) * radius;
+			} else if ((gen == GEN_EXACT) || ((s % ARC_ANCHOR_SEGMENTS) == 0) || (s == n_segments)) {
+				float t = theta + s * segment_theta;
+				r0 = sinf(t) * radius;
+				r1 = cosf(t) * radius;
+			} else {
+				float n0 = r0 * segment_cos + r1 * segment_sin;
+				r1 = r1 * segment_cos - r0 * segment_sin;
+				r0 = n0;
+			}
+			double p0 = (float)(center_0 + r0), p1 = (float)(center_1 + r1);	// target as queued
+			double mid_0 = (p0 + prev_0) / 2 - center_0, mid_1 = (p1 + prev_1) / 2 - center_1;
+			double d_end = fabs(hypot(p0 - center_0, p1 - center_1) - radius);
+			double d_mid = fabs(hypot(mid_0, mid_1) - radius);
+			if (d_end > radial) { radial = d_end;}
+			if (d_end > chordal) { chordal = d_end;}
+			if (d_mid > chordal) { chordal = d_mid;}
+			prev_0 = p0; prev_1 = p1;
+		}
+		double endpoint = hypot(prev_0 - target[a0], prev_1 - target[a1]);
+		if (endpoint > err[gen].endpoint) { err[gen].endpoint = endpoint;}
+		if (radial > err[gen].radial) { err[gen].radial = radial;}
+		if (chordal > err[gen].chordal) { err[gen].chordal = chordal;}
+		err[gen].segments += n_segments;
+	}
+	(*arcs)++;
+	return (0);
+}
+
+/*
+ * _number() - read a g-code number (strtof() would take "0x0y0" as hex)
+ */
+static float _number(char *str, char **end)
+{
+	char buf[32];
+	int n = 0, digits = 0;
+	char *c = str;
+	if ((*c == '-') || (*c == '+')) { buf[n++] = *c++;}
+	while ((isdigit((unsigned char)*c) || (*c == '.')) && (n < 31)) {
+		if (*c != '.') { digits++;}
+		buf[n++] = *c++;
+	}
+	buf[n] = 0;
+	*end = (digits == 0) ? str : c;
+	return (strtof(buf, NULL));
+}
+
+/*
+ * _run_gcode() - interpret the motion words of a g-code text
+ */
+static void _run_gcode(const char *name, char *text, int run_closed)
+{
+	gcode_t g = { 0, 17, 0, 0, {0,0,0} };
+	errors_t err[GEN_COUNT] = {{0}};
+	int arcs = 0, rejected = 0, closed = 0;
+
+	for (char *line = strtok(text, "\n"); line != NULL; line = strtok(NULL, "\n")) {
+		float word[26] = {0};
+		int have[26] = {0};
+		int motion_word = 0;
+		for (char *c = line; *c != 0; ) {
+			if (*c == '(') {				// skip comments
+				while ((*c != 0) && (*c != ')')) c++;
+				if (*c != 0) c++;
+				continue;
+			}
+			if (!isalpha((unsigned char)*c)) { c++; continue;}
+			int letter = toupper((unsigned char)*c++) - 'A';
+			char *end;
+			float value = _number(c, &end);
+			if (end == c) { continue;}
+			c = end;
+			if (letter == 'G' - 'A') {
+				int code = (int)lroundf(value * 10);
+				if (code == 0 || code == 10 || code == 20 || code == 30) { g.motion = code / 10; motion_word = 1;}
+				else if (code == 170 || code == 180 || code == 190) { g.plane = code / 10;}
+				else if (code == 200) { g.inches = 1;}
+				else if (code == 210) { g.inches = 0;}
+				else if (code == 900) { g.incremental = 0;}
+				else if (code == 910) { g.incremental = 1;}
+				else if (code == 800) { g.motion = -1;}
+				continue;
+			}
+			word[letter] = value;
+			have[letter] = 1;
+		}
+		float scale = g.inches ? MM_PER_INCH : 1;
+		int axis[3] = { 'X'-'A', 'Y'-'A', 'Z'-'A' };
+		int has_axis = 0;
+		float target[3];
+		for (int i = 0; i < 3; i++) {
+			target[i] = g.position[i];
+			if (have[axis[i]]) {
+				has_axis = 1;
+				target[i] = word[axis[i]] * scale + (g.incremental ? g.position[i] : 0);
+			}
+		}
+		if (!has_axis && !(motion_word && (g.motion >= 2))) { continue;}
+		if ((g.motion == 2) || (g.motion == 3)) {
+			float offset[3] = { word['I'-'A'] * scale, word['J'-'A'] * scale, word['K'-'A'] * scale };
+			int have_plane_target;
+			if (g.plane == 17) have_plane_target = have['X'-'A'] || have['Y'-'A'];
+			else if (g.plane == 18) have_plane_target = have['X'-'A'] || have['Z'-'A'];
+			else have_plane_target = have['Y'-'A'] || have['Z'-'A'];
+			if (_run_arc(&g, target, offset, word['R'-'A'] * scale, have_plane_target, run_closed, err, &arcs, &closed) < 0) {
+				rejected++;
+			}
+		}
+		if (g.motion >= 0) { memcpy(g.position, target, sizeof(target));}
+	}
+
+	printf("%s: %d arcs", name, arcs);
+	if (rejected) printf(", %d rejected as specification errors", rejected);
+	if (closed) printf(", %d closed arcs %s", closed, run_closed ? "run as full circles" : "have no travel");
+	printf("\n  generator  segments  endpoint (mm)  radial (mm)  chordal (mm)\n");
+	for (int gen = 0; gen < GEN_COUNT; gen++) {
+		printf("  %-9s  %8ld  %13.3e  %11.3e  %12.3e\n", gen_name[gen], err[gen].segments,
+			err[gen].endpoint, err[gen].radial, err[gen].chordal);
+	}
+}
+
+/*
+ * _load() - read a g-code file, or the PROGMEM string of a test header
+ */
+static char *_load(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	if (f == NULL) { perror(path); exit(1);}
+	fseek(f, 0, SEEK_END);
+	long len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	char *text = calloc(len + 1, 1);
+	if (fread(text, 1, len, f) != (size_t)len) { perror(path); exit(1);}
+	fclose(f);
+
+	size_t n = strlen(path);
+	if ((n < 2) || (strcmp(&path[n-2], ".h") != 0)) { return (text);}
+	char *start = strstr(text, "PROGMEM = \"");	// keep the string body, with \n escapes as newlines
+	char *out = text, *c;
+	if (start == NULL) { *text = 0; return (text);}
+	for (c = start + 11; (*c != 0) && !((c[0] == '"') && (c[1] == ';')); c++) {
+		if ((c[0] == '\\') && (c[1] == 'n')) { *out++ = '\n'; c++;}
+		else if ((c[0] == '\\') && ((c[1] == '\r') || (c[1] == '\n'))) { continue;}
+		else if ((*c != '\r') && (*c != '\n')) { *out++ = *c;}
+	}
+	*out = 0;
+	return (text);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s file.gcode|test_NNN.h ...\n", argv[0]);
+		return (1);
+	}
+	for (int i = 1; i < argc; i++) {
+		char *text = _load(argv[i]);
+		char *copy = strdup(text);			// strtok() consumes the text
+		_run_gcode(argv[i], text, 0);
+		_run_gcode(argv[i], copy, 1);
+	}
+	return (0);
+}
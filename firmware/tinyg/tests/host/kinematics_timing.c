@@ -0,0 +1,262 @@
+/*
+ * kinematics_timing.c - host timing of ik_kinematics() with and without Z compensation
+ *
+ *	Standalone - not part of the firmware build. Build and run from firmware/tinyg:
+ *
+ *		gcc -O2 -o kinematics_timing tests/host/kinematics_timing.c -lm
+ *		./kinematics_timing
+ *
+ *	ik_kinematics(), the _ik_xxx() transforms and _height_map_offset() are copied from
+ *	kinematics.c - keep them in step. Each is timed over a path of segment endpoints
+ *	for cartesian, CoreXY and delta, with the height map off and on (7 x 7 points).
+ *	The "segment" column adds the rest of the per-segment float work - the target
+ *	update and step deltas of _exec_aline_segment() and the per-motor substep math of
+ *	st_prep_line() - so the increase is shown against what a segment actually costs.
+ *
+ *	Host times are for a hardware FPU. On the xmega every float operation is a soft-float
+ *	call, which scales the kinematics and the rest of the segment alike, so the percent
+ *	increase carries over better than the absolute times do.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define AXES 6
+#define MOTORS 4
+#define AXIS_X 0
+#define AXIS_Y 1
+#define AXIS_Z 2
+#define DELTA_TOWERS 3
+#define HEIGHT_MAP_MAX_POINTS 49
+#define HEIGHT_MAP_SCALE 1000
+#define DDA_SUBSTEPS 100000
+#define STEP_CORRECTION_THRESHOLD (float)2.00
+#define min(a,b) (((a) < (b)) ? (a) : (b))
+
+#define SEGMENTS 4096					// path length - fits in cache, as the firmware's state does
+#define PASSES 2000
+
+typedef struct {
+	uint8_t active;
+	uint8_t columns, rows;
+	float origin_x, origin_y;
+	float inv_spacing_x, inv_spacing_y;
+	int16_t height[HEIGHT_MAP_MAX_POINTS];
+} kinHeightMap_t;
+
+typedef struct {
+	uint8_t type;
+	uint8_t motor_axis[MOTORS];
+	float motor_steps_per_unit[MOTORS];
+	float tower_x[DELTA_TOWERS];
+	float tower_y[DELTA_TOWERS];
+	float arm_length_sq;
+	kinHeightMap_t map;
+} kin_t;
+
+static kin_t kin;
+
+/**** copied from kinematics.c ****/
+
+static void _ik_cartesian(const float travel[], float joint[])
+{
+	memcpy(joint, travel, sizeof(float)*AXES);
+}
+
+static void _ik_corexy(const float travel[], float joint[])
+{
+	memcpy(joint, travel, sizeof(float)*AXES);
+	joint[AXIS_X] = travel[AXIS_X] + travel[AXIS_Y];
+	joint[AXIS_Y] = travel[AXIS_X] - travel[AXIS_Y];
+}
+
+static void _ik_delta(const float travel[], float joint[])
+{
+	memcpy(joint, travel, sizeof(float)*AXES);
+	for (uint8_t tower=0; tower<DELTA_TOWERS; tower++) {
+		float dx = kin.tower_x[tower] - travel[AXIS_X];
+		float dy = kin.tower_y[tower] - travel[AXIS_Y];
+		float height_sq = kin.arm_length_sq - dx*dx - dy*dy;
+		joint[AXIS_X + tower] = travel[AXIS_Z] + ((height_sq > 0) ? sqrtf(height_sq) : 0);
+	}
+}
+
+static void (*const _inverse_kinematics[])(const float travel[], float joint[]) = {
+	_ik_cartesian, _ik_corexy, _ik_corexy, _ik_delta
+};
+
+static float _height_map_offset(const float travel[])
+{
+	if (kin.map.active == 0) return (0);
+
+	float u = (travel[AXIS_X] - kin.map.origin_x) * kin.map.inv_spacing_x;
+	float v = (travel[AXIS_Y] - kin.map.origin_y) * kin.map.inv_spacing_y;
+	uint8_t last_column = kin.map.columns - 1;
+	uint8_t last_row = kin.map.rows - 1;
+
+	if (u < 0) { u = 0;} else if (u > last_column) { u = last_column;}
+	if (v < 0) { v = 0;} else if (v > last_row) { v = last_row;}
+	uint8_t i = min((uint8_t)u, last_column - 1);
+	uint8_t j = min((uint8_t)v, last_row - 1);
+	u -= i;
+	v -= j;
+
+	const int16_t *h = &kin.map.height[j * kin.map.columns + i];
+	float z0 = h[0] + (h[1] - h[0]) * u;
+	float z1 = h[kin.map.columns] + (h[kin.map.columns + 1] - h[kin.map.columns]) * u;
+	return ((z0 + (z1 - z0) * v) * ((float)1 / HEIGHT_MAP_SCALE));
+}
+
+static void __attribute__((noinline)) ik_kinematics(const float travel[], float steps[])
+{
+	float position[AXES];
+	float joint[AXES];
+
+	memcpy(position, travel, sizeof(float)*AXES);
+	position[AXIS_Z] += _height_map_offset(travel);
+	_inverse_kinematics[kin.type](position, joint);
+
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		steps[motor] = joint[kin.motor_axis[motor]] * kin.motor_steps_per_unit[motor];
+	}
+}
+
+/**** the rest of the per-segment float work (plan_exec.c, stepper.c) ****/
+
+static struct {
+	float position[AXES], target[AXES], unit[AXES];
+	float position_steps[MOTORS], target_steps[MOTORS], commanded_steps[MOTORS];
+	float following_error[MOTORS];
+	float prev_segment_time[MOTORS];
+	uint32_t substep_increment[MOTORS];
+	int8_t step_sign[MOTORS];
+} mr;
+
+static void __attribute__((noinline)) _segment(const float target[], float segment_time)
+{
+	float travel_steps[MOTORS];
+	float segment_length = 0;
+
+	for (uint8_t i=0; i<AXES; i++) {		// _exec_aline_segment(): target from the unit vector
+		segment_length += (target[i] - mr.position[i]) * mr.unit[i];
+	}
+	for (uint8_t i=0; i<AXES; i++) {
+		mr.target[i] = mr.position[i] + (mr.unit[i] * segment_length);
+	}
+	for (uint8_t i=0; i<MOTORS; i++) {
+		mr.commanded_steps[i] = mr.position_steps[i];
+		mr.position_steps[i] = mr.target_steps[i];
+		mr.following_error[i] = mr.position_steps[i] - mr.commanded_steps[i];
+	}
+	ik_kinematics(target, mr.target_steps);
+	for (uint8_t i=0; i<MOTORS; i++) {
+		travel_steps[i] = mr.target_steps[i] - mr.position_steps[i];
+	}
+	for (uint8_t motor=0; motor<MOTORS; motor++) {	// st_prep_line(): per-motor setup
+		if (fabsf(travel_steps[motor]) < 1e-6) continue;
+		mr.step_sign[motor] = (travel_steps[motor] >= 0) ? 1 : -1;
+		if (fabsf(segment_time - mr.prev_segment_time[motor]) > 0.0000001) {
+			mr.prev_segment_time[motor] = segment_time;
+		}
+		if (fabsf(mr.following_error[motor]) > STEP_CORRECTION_THRESHOLD) {
+			travel_steps[motor] -= mr.following_error[motor] * 0.25f;
+		}
+		mr.substep_increment[motor] = (uint32_t)roundf(fabsf(travel_steps[motor] * DDA_SUBSTEPS));
+	}
+	memcpy(mr.position, target, sizeof(float)*AXES);
+}
+
+/**** harness ****/
+
+static float path[SEGMENTS][AXES];
+static volatile float sink;
+
+static double _now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (t.tv_sec * 1e9 + t.tv_nsec);
+}
+
+static double _time_ik()						// ns per call, best of 5
+{
+	float steps[MOTORS];
+	double best = 1e9;
+	for (int k=0; k<5; k++) {
+		double t0 = _now();
+		for (int p=0; p<PASSES; p++) {
+			for (int s=0; s<SEGMENTS; s++) {
+				ik_kinematics(path[s], steps);
+				sink = steps[0];
+			}
+		}
+		double t = (_now() - t0) / ((double)PASSES * SEGMENTS);
+		if (t < best) best = t;
+	}
+	return (best);
+}
+
+static double _time_segment()
+{
+	double best = 1e9;
+	for (int k=0; k<5; k++) {
+		double t0 = _now();
+		for (int p=0; p<PASSES; p++) {
+			for (int s=0; s<SEGMENTS; s++) {
+				_segment(path[s], 0.0000833f);	// 5 ms in minutes
+			}
+		}
+		sink = (float)mr.substep_increment[0];
+		double t = (_now() - t0) / ((double)PASSES * SEGMENTS);
+		if (t < best) best = t;
+	}
+	return (best);
+}
+
+int main()
+{
+	static const char *name[] = { "cartesian", "CoreXY", "H-bot", "delta" };
+	static const float tower_angle[DELTA_TOWERS] = { 210, 330, 90 };
+
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		kin.motor_axis[motor] = (motor < 3) ? motor : AXIS_Y;	// Y is ganged on motor 4
+		kin.motor_steps_per_unit[motor] = 80;
+	}
+	for (uint8_t tower=0; tower<DELTA_TOWERS; tower++) {
+		kin.tower_x[tower] = 120 * cosf(tower_angle[tower] * M_PI / 180);
+		kin.tower_y[tower] = 120 * sinf(tower_angle[tower] * M_PI / 180);
+	}
+	kin.arm_length_sq = 250 * 250;
+	kin.map.columns = 7;
+	kin.map.rows = 7;
+	kin.map.origin_x = -60;
+	kin.map.origin_y = -60;
+	kin.map.inv_spacing_x = 1.0f / 20;
+	kin.map.inv_spacing_y = 1.0f / 20;
+	for (int i=0; i<HEIGHT_MAP_MAX_POINTS; i++) {
+		kin.map.height[i] = (int16_t)(((i * 37) % 200) - 100);	// +/- 0.1 mm
+	}
+	for (int s=0; s<SEGMENTS; s++) {			// spiral over the map and a little past its edge
+		float a = s * 0.05f, r = 70.0f * s / SEGMENTS;
+		path[s][AXIS_X] = r * cosf(a);
+		path[s][AXIS_Y] = r * sinf(a);
+		path[s][AXIS_Z] = -1.0f + s * 0.0001f;
+	}
+	mr.unit[AXIS_X] = 0.6f;
+	mr.unit[AXIS_Y] = 0.8f;
+
+	printf("kinematics   ik off   ik on  (ns)   segment off  segment on  (ns)   segment increase\n");
+	for (uint8_t type=0; type<4; type++) {
+		if (type == 2) continue;				// H-bot is the CoreXY transform
+		kin.type = type;
+		kin.map.active = 0;
+		double ik_off = _time_ik(), seg_off = _time_segment();
+		kin.map.active = 1;
+		double ik_on = _time_ik(), seg_on = _time_segment();
+		printf("%-10s  %7.1f  %7.1f        %11.1f  %10.1f         %5.1f%%\n", name[type],
+			   ik_off, ik_on, seg_off, seg_on, 100 * (seg_on - seg_off) / seg_off);
+	}
+	return (0);
+}
@@ -0,0 +1,64 @@
+/*
+ * test_015_arc_accuracy.h
+ *
+ * Notes:
+ *	  -	The character array should be derived from the filename (by convention)
+ *	  - Comments are not allowed in the char array, but gcode comments are OK e.g. (g0 test)
+ *	  - Each group of arcs ends on a known point and is followed by a dwell. The status
+ *		report sent at the dwell shows the endpoint error of the arc segment generator
+ *		against the position named in the step message
+ */
+
+const char test_arc_accuracy[] PROGMEM = "\
+(MSG**** Arc accuracy test [v1] ****)\n\
+N1 g00g17g21g40g49g80g90\n\
+N10 g0x0y0z0\n\
+(msgStep 1: test_004 arcs - CW and CCW, 90 to 360 degrees - return to 0,0)\n\
+N20 f500\n\
+N30 g2x10y-10i10\n\
+N40 g3x0y0i-10\n\
+N50 g2x20y0i10\n\
+N60 g2x0y0i-10\n\
+N70 g3x20y0i10\n\
+N80 g3x0y0i-10\n\
+N90 g4p1\n\
+(msgStep 2: four CW and four CCW full circles, R=20 - should read x0 y0)\n\
+N100 f1200\n\
+N110 g2x0y0i20\n\
+N120 g2x0y0i20\n\
+N130 g2x0y0i20\n\
+N140 g2x0y0i20\n\
+N150 g3x0y0i20\n\
+N160 g3x0y0i20\n\
+N170 g3x0y0i20\n\
+N180 g3x0y0i20\n\
+N190 g4p1\n\
+(msgStep 3: large slow circle, R=50 - many segments between re-anchors - should read x0 y0)\n\
+N200 f400\n\
+N210 g2x0y0i50\n\
+N220 g3x0y0i50\n\
+N230 g4p1\n\
+(msgStep 4: helix, 3 turns with linear Z travel - should read x0 y0 z6)\n\
+N240 f800\n\
+N250 g3x0y0z2i20\n\
+N260 g3x0y0z4i20\n\
+N270 g3x0y0z6i20\n\
+N280 g4p1\n\
+N290 g0z0\n\
+(msgStep 5: circles2.gcode circles in inches - should read x2.000 y1.500)\n\
+N300 g20\n\
+N310 f40\n\
+N320 g0x2.875y1.5\n\
+N330 g3x2.875y1.5i-1.375j0\n\
+N340 g0x2.0y1.5\n\
+N350 g3x2.0y1.5i-0.5j0\n\
+N360 g4p1\n\
+(msgStep 6: G18 arc by radius - should read x67.738 z23.617)\n\
+N400 g21\n\
+N410 g0x0y0z0\n\
+N420 g1x30.707z50.727f500\n\
+N430 g18g2x67.738z23.617r25f250\n\
+N440 g4p1\n\
+N450 g17\n\
+N460 g0x0y0z0\n\
+N470 m30";
@@ -0,0 +1,61 @@
+/*
+ * test_016_kinematics.h
+ *
+ * Notes:
+ *	  -	The character array should be derived from the filename (by convention)
+ *	  - Comments are not allowed in the char array, but gcode comments are OK e.g. (g0 test)
+ *	  - Runs on the kinematics already selected by $kin - the test does not change it.
+ *		Run it once for each $kin setting the machine supports
+ *	  - Every segment runs the inverse transform in the EXEC, so long moves at high feed
+ *		load the segment budget as hard as short ones. A transform that overruns the
+ *		5 ms segment shows up as stutter or a stalled move, not as a wrong position
+ *	  - Moves stay within 20 mm of 0,0 so the test is safe on a small delta
+ *	  - Run it again with a height map loaded and $hmpe=1 to add the Z compensation
+ *		lookup to every segment. It should run the same as without
+ */
+const char test_kinematics[] PROGMEM = "\
+(MSG**** Kinematics segment load test [v1] ****)\n\
+N1 g00g17g21g40g49g80g90\n\
+N10 g0x0y0z0\n\
+(msgStep 1: fast XY lines through the centre and along the edges)\n\
+N20 f3000\n\
+N30 g1x20y0\n\
+N40 x-20y0\n\
+N50 x0y20\n\
+N60 x0y-20\n\
+N70 x14y14\n\
+N80 x-14y-14\n\
+N90 x14y-14\n\
+N100 x-14y14\n\
+N110 x0y0\n\
+N120 g4p1\n\
+(msgStep 2: fast circles - continuous segments at changing joint ratios)\n\
+N130 g0x20y0\n\
+N140 g3x20y0i-20\n\
+N150 g2x20y0i-20\n\
+N160 g3x20y0i-20\n\
+N170 g2x20y0i-20\n\
+N180 g0x0y0\n\
+N190 g4p1\n\
+(msgStep 3: helix - all three joints move on every segment)\n\
+N200 g0x10y0\n\
+N210 g3x10y0z2i-10\n\
+N220 g3x10y0z4i-10\n\
+N230 g2x10y0z2i-10\n\
+N240 g2x10y0z0i-10\n\
+N250 g4p1\n\
+(msgStep 4: short XY moves - many short blocks through the transform)\n\
+N260 g0x0y0\n\
+N270 g1x1y1\n\
+N280 x2y0\n\
+N290 x3y1\n\
+N300 x4y0\n\
+N310 x5y1\n\
+N320 x6y0\n\
+N330 x7y1\n\
+N340 x8y0\n\
+N350 x9y1\n\
+N360 x10y0\n\
+N370 g0x0y0z0\n\
+(msgShould read x0 y0 z0 - moves should run smoothly with no stalls)\n\
+N380 m30";
@@ -45,7 +45,7 @@
 /****** REVISIONS ******/
 
 #ifndef TINYG_FIRMWARE_BUILD
-#define TINYG_FIRMWARE_BUILD        440.20	// arc test
+#define TINYG_FIRMWARE_BUILD        440.31	// probe settings ($prbs, $prbr) shift NVM indexes
 
 #endif
 #define TINYG_FIRMWARE_VERSION		0.97					// firmware major version
@@ -59,6 +59,7 @@
 //#define __NEW_SWITCHES					// Using v9 style switch code
 //#define __JERK_EXEC						// Use computed jerk (versus forward difference based exec)
 //#define __KAHAN							// Use Kahan summation in aline exec functions
+#define __PLANNER_ARCS						// Queue G2/G3 as single arc blocks (versus line segments)
 
 #define __TEXT_MODE							// enables text mode	(~10Kb)
 #define __HELP_SCREENS						// enables help screens (~3.5Kb)
@@ -68,6 +69,8 @@
 /****** DEVELOPMENT SETTINGS ******/
 
 #define __DIAGNOSTIC_PARAMETERS				// enables system diagnostic parameters (_xx) in config_app
+//#define __DISPATCH_PROFILE				// enables controller dispatch profiler ($dp, $dpb). Uses TIMER_5
+//#define __ENCODERS						// enables quadrature encoder input. Uses TIMER_5 and event channel 0
 //#define __DEBUG_SETTINGS					// special settings. See settings.h
 //#define __CANNED_STARTUP					// run any canned startup moves
 
@@ -390,8 +393,8 @@ char *get_status_message(stat_t status);
 #define	STAT_JSON_SYNTAX_ERROR 111              // JSON input string is not well formed
 #define	STAT_JSON_TOO_MANY_PAIRS 112            // JSON input string has too many JSON pairs
 #define	STAT_JSON_TOO_LONG 113					// JSON input or output exceeds buffer size
-#define	STAT_ERROR_114 114
-#define	STAT_ERROR_115 115
+#define	STAT_SNAPSHOT_FORMAT_ERROR 114			// config snapshot line is malformed or out of sequence
+#define	STAT_SNAPSHOT_CHECKSUM_ERROR 115		// config snapshot line or CRC check failed
 #define	STAT_ERROR_116 116
 #define	STAT_ERROR_117 117
 #define	STAT_ERROR_118 118
@@ -496,7 +499,7 @@ char *get_status_message(stat_t status);
 #define	STAT_MACHINE_ALARMED 203						// machine is alarmed. Command not processed
 #define	STAT_LIMIT_SWITCH_HIT 204						// a limit switch was hit causing shutdown
 #define	STAT_PLANNER_FAILED_TO_CONVERGE 205				// trapezoid generator can through this exception
-#define	STAT_ERROR_206 206
+#define	STAT_FOLLOWING_ERROR_EXCEEDED 206				// following error over threshold - see $fet, $fen
 #define	STAT_ERROR_207 207
 #define	STAT_ERROR_208 208
 #define	STAT_ERROR_209 209
@@ -541,7 +544,7 @@ char *get_status_message(stat_t status);
 #define	STAT_HOMING_ERROR_TRAVEL_MIN_MAX_IDENTICAL 244
 #define	STAT_HOMING_ERROR_NEGATIVE_LATCH_BACKOFF 245
 #define	STAT_HOMING_ERROR_SWITCH_MISCONFIGURATION 246
-#define	STAT_ERROR_247 247
+#define	STAT_CALIBRATION_FAILED 247						// step loss calibration cycle did not complete
 #define	STAT_ERROR_248 248
 #define	STAT_ERROR_249 249
 
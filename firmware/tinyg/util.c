@@ -218,30 +218,105 @@ char_t *pstr2str(const char *pgm_string)
 }
 
 /*
- * fntoa() - return ASCII string given a float and a decimal precision value
+ * fntoa()  - return ASCII string given a float and a decimal precision value
+ * inttoa() - return ASCII string given a signed 32 bit integer
+ * hextoa() - return ASCII lower-case hex string given an unsigned 32 bit integer
  *
- *	Returns length of string, less the terminating NUL character
+ *	All return length of string, less the terminating NUL character
+ *
+ *	These are hand-rolled replacements for the sprintf("%0.Nf") ladder formerly used
+ *	by fntoa(). vfprintf with float support is slow and stack-hungry on the AVR and
+ *	these are called for every float in every status report, competing with the
+ *	segment exec for cycles. Output is identical to "%0.Nf" for precision 0 - 7
+ *	(and "%f" otherwise), including round-half-to-even on exact ties. On the AVR the
+ *	scaling is done in float (double is float), which is no worse than vfprintf there.
+ *
+ *	Values whose integer part won't fit in 32 bits are passed to sprintf (rare to never)
  */
+#define FNTOA_MAX_PRECISION 7
+#define FNTOA_MAX_INTEGER ((float)4294967040.0)	// largest float that fits in a uint32_t
+
+static const uint32_t fntoa_scale[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000 };
+
+static char_t _utoa(char_t *str, uint32_t n, uint8_t min_digits)
+{
+	char_t buf[10];								// uint32 is at most 10 digits
+	uint8_t i = 0;
+	do {
+		buf[i++] = '0' + (n % 10);
+		n /= 10;
+	} while ((n != 0) || (i < min_digits));
+
+	char_t len = i;
+	while (i != 0) { *str++ = buf[--i]; }		// reverse into the output string
+	*str = 0;								// NUL
+	return (len);
+}
+
+char_t inttoa(char_t *str, int32_t n)
+{
+	if (n < 0) {
+		*str = '-';
+		return (_utoa(str+1, (uint32_t)0 - (uint32_t)n, 1) + 1);
+	}
+	return (_utoa(str, (uint32_t)n, 1));
+}
+
+char_t hextoa(char_t *str, uint32_t n)
+{
+	char_t buf[8];
+	uint8_t i = 0;
+	do {
+		buf[i++] = "0123456789abcdef"[n & 0x0F];
+		n >>= 4;
+	} while (n != 0);
+
+	char_t len = i;
+	while (i != 0) { *str++ = buf[--i]; }
+	*str = 0;								// NUL
+	return (len);
+}
+
 char_t fntoa(char_t *str, float n, uint8_t precision)
 {
     // handle special cases
 	if (isnan(n)) {
 		strcpy(str, "nan");
 		return (3);
-
-	} else if (isinf(n)) {
+	}
+	if (isinf(n)) {
 		strcpy(str, "inf");
 		return (3);
+	}
+	if (precision > FNTOA_MAX_PRECISION) { precision = 6; }	// same as "%f"
 
-	} else if (precision == 0 ) { return((char_t)sprintf((char *)str, "%0.0f", (double) n));
-	} else if (precision == 1 ) { return((char_t)sprintf((char *)str, "%0.1f", (double) n));
-	} else if (precision == 2 ) { return((char_t)sprintf((char *)str, "%0.2f", (double) n));
-	} else if (precision == 3 ) { return((char_t)sprintf((char *)str, "%0.3f", (double) n));
-	} else if (precision == 4 ) { return((char_t)sprintf((char *)str, "%0.4f", (double) n));
-	} else if (precision == 5 ) { return((char_t)sprintf((char *)str, "%0.5f", (double) n));
-	} else if (precision == 6 ) { return((char_t)sprintf((char *)str, "%0.6f", (double) n));
-	} else if (precision == 7 ) { return((char_t)sprintf((char *)str, "%0.7f", (double) n));
-	} else					    { return((char_t)sprintf((char *)str, "%f", (double) n)); }
+	char_t *start = str;
+	float value = n;
+	if (signbit(n)) {							// "%f" keeps the sign of values that round to zero
+		*str++ = '-';
+		n = -n;
+	}
+	if (n >= FNTOA_MAX_INTEGER) {
+		return ((char_t)sprintf((char *)start, "%0.*f", precision, (double)value));
+	}
+	uint32_t integer = (uint32_t)n;
+	double scaled = ((double)n - integer) * fntoa_scale[precision];
+	uint32_t fraction = (uint32_t)scaled;
+	double remainder = scaled - fraction;
+	uint32_t last_digit = (precision == 0) ? integer : fraction;
+	if ((remainder > 0.5) || ((remainder == 0.5) && (last_digit & 1))) {	// round half to even
+		fraction++;
+	}
+	if (fraction >= fntoa_scale[precision]) {	// rounding carried into the integer part
+		fraction -= fntoa_scale[precision];
+		integer++;
+	}
+	str += _utoa(str, integer, 1);
+	if (precision != 0) {
+		*str++ = '.';
+		str += _utoa(str, fraction, precision);
+	}
+	return (str - start);
 }
 
 /*
@@ -252,8 +327,6 @@ char_t fntoa(char_t *str, float n, uint8_t precision)
  * 	This is based on the the Java hashCode function.
  *	See http://en.wikipedia.org/wiki/Java_hashCode()
  */
-#define HASHMASK 9999
-
 uint16_t compute_checksum(char_t const *string, const uint16_t length)
 {
 	uint32_t h = 0;
@@ -79,6 +79,9 @@ uint8_t isnumber(char_t c);
 char_t *escape_string(char_t *dst, char_t *src);
 char_t *pstr2str(const char *pgm_string);
 char_t fntoa(char_t *str, float n, uint8_t precision);
+char_t inttoa(char_t *str, int32_t n);
+char_t hextoa(char_t *str, uint32_t n);
+#define HASHMASK 9999					// checksum modulus - see compute_checksum()
 uint16_t compute_checksum(char_t const *string, const uint16_t length);
 
 //*** other utilities ***
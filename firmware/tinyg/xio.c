@@ -57,6 +57,7 @@
  *	xio_gets() - get a string from the XIO_DEV device (non blocking line reader)
  *	xio_getc() - read a character from the XIO_DEV device (not stdio compatible)
  *	xio_putc() - write a character to the XIO_DEV device (not stdio compatible)
+ *	xio_write_block() - write a block of characters to the XIO_DEV device
  *  xio_set_baud() - set baud rates for devices for which this is meaningful
  *
  * The device type layer currently knows about USARTS, SPI, and File devices. Methods are:
@@ -146,7 +147,7 @@ uint8_t xio_test_assertions()
  *	This function is here so that the caller can detect that the serial system is active
  *	and therefore generating interrupts. This is a hack for the earlier AVRs that require
  *	interrupts to be disabled for EEPROM write so the caller can see if the XIO system is
- *	quiescent. This is used by the G10 deferred writeback persistence functions.
+ *	quiescent. This is used by the NVM write queue - see nvm_write_callback().
  *
  *	Idle conditions:
  *	- The serial RX buffer is empty, indicating with some probability that data is not being sent
@@ -155,9 +156,9 @@ uint8_t xio_test_assertions()
 
 uint8_t xio_isbusy()
 {
-	if (xio_get_rx_bufcount_usart(&USBu) != 0) return (false);
-	if (xio_get_tx_bufcount_usart(&USBu) != 0) return (false);
-	return (true);
+	if (xio_get_rx_bufcount_usart(&USBu) != 0) return (true);
+	if (xio_get_tx_bufcount_usart(&USBu) != 0) return (true);
+	return (false);
 }
 
 /*
@@ -213,6 +214,12 @@ void xio_open_generic(uint8_t dev, x_open_t x_open,
  * xio_gets() - entry point for non-blocking get line function
  * xio_getc() - entry point for getc (not stdio compatible)
  * xio_putc() - entry point for putc (not stdio compatible)
+ * xio_read_block() - entry point for non-blocking block read; returns chars read
+ * xio_write_block() - entry point for block write; returns chars written
+ *
+ *	The block functions use the USART span copies where the device has them and
+ *	fall back to per-character getc / putc otherwise. A block read ends after the
+ *	first line terminator, so a line reader never takes characters from the next line.
  *
  * It might be prudent to run an assertion such as below, but we trust the callers:
  * 	if (dev < XIO_DEV_COUNT) blah blah blah
@@ -238,6 +245,36 @@ int xio_putc(const uint8_t dev, const char c)
 	return (ds[dev].x_putc(c, &ds[dev].file));
 }
 
+int xio_read_block(const uint8_t dev, char *buf, const int size)
+{
+	if (dev < XIO_DEV_USART_OFFSET + XIO_DEV_USART_COUNT) {
+		return (xio_read_block_usart(&ds[dev], buf, size));
+	}
+	int count = 0;
+	uint8_t flag_block = ds[dev].flag_block;
+	ds[dev].flag_block = false;							// a block read never waits
+	while (count < size) {
+		int c = ds[dev].x_getc(&ds[dev].file);
+		if (c < 0) break;								// _FDEV_ERR or _FDEV_EOF
+		buf[count++] = (char)c;
+		if ((c == CR) || (c == LF)) break;				// end of line
+	}
+	ds[dev].flag_block = flag_block;
+	return (count);
+}
+
+int xio_write_block(const uint8_t dev, const char *buf, const int size)
+{
+	if (dev == XIO_DEV_USB) {
+		return (xio_write_block_usb(buf, size));
+	}
+	int count = 0;
+	while (count < size) {
+		ds[dev].x_putc(buf[count++], &ds[dev].file);
+	}
+	return (count);
+}
+
 /*
  * xio_ctrl() - PUBLIC set control flags (top-level XIO_DEV access)
  * xio_ctrl_generic() - PRIVATE but generic set-control-flags
@@ -292,6 +329,7 @@ void xio_fc_null(xioDev_t *d)
  * xio_set_stdin()  - set stdin from device number
  * xio_set_stdout() - set stdout from device number
  * xio_set_stderr() - set stderr from device number
+ * xio_get_stderr() - get the device number stderr is set to (the active response channel)
  *
  *	stderr is defined in stdio as __iob[2]. Turns out stderr is the last RAM
  *	allocated by the linker for this project. We usae that to keep a shadow
@@ -304,3 +342,4 @@ void xio_set_stderr(const uint8_t dev)
 	stderr = &ds[dev].file;
 	xio.stderr_shadow = stderr;		// this is the last thing in RAM, so we use it as a memory corruption canary
 }
+uint8_t xio_get_stderr() { return (((xioDev_t *)fdev_get_udata(stderr))->dev); }
@@ -188,6 +188,8 @@ int xio_ctrl(const uint8_t dev, const flags_t flags);
 int xio_gets(const uint8_t dev, char *buf, const int size);
 int xio_getc(const uint8_t dev);
 int xio_putc(const uint8_t dev, const char c);
+int xio_read_block(const uint8_t dev, char *buf, const int size);
+int xio_write_block(const uint8_t dev, const char *buf, const int size);
 int xio_set_baud(const uint8_t dev, const uint8_t baud_rate);
 
 // generic functions (private, but at virtual level)
@@ -208,6 +210,7 @@ void xio_init_stdio(void);				// set std devs & do startup prompt
 void xio_set_stdin(const uint8_t dev);
 void xio_set_stdout(const uint8_t dev);
 void xio_set_stderr(const uint8_t dev);
+uint8_t xio_get_stderr(void);
 
 /*************************************************************************
  * SUPPORTING DEFINTIONS - SHOULD NOT NEED TO CHANGE
@@ -284,6 +287,20 @@ enum xioSignals {
 #define CHAR_QUEUE_FLUSH (char)'%'
 //#define CHAR_BOOTLOADER ESC
 
+/* Realtime command characters
+ * Extended ASCII codes that do not occur in Gcode or JSON. These are trapped in the
+ * RX ISRs and queued to the controller along with feedhold, cycle start and queue flush.
+ * See controller_queue_realtime()
+ */
+#define CHAR_STATUS_POLL (char)0x80			// request an immediate status report
+#define CHAR_JOG_CANCEL (char)0x85			// stop a jog and discard the rest of it
+#define CHAR_FEED_OVR_RESET (char)0x90		// feed override to 100%
+#define CHAR_FEED_OVR_PLUS (char)0x91		// feed override +10%
+#define CHAR_FEED_OVR_MINUS (char)0x92		// feed override -10%
+#define CHAR_SPINDLE_OVR_RESET (char)0x99	// spindle override to 100%
+#define CHAR_SPINDLE_OVR_PLUS (char)0x9A	// spindle override +10%
+#define CHAR_SPINDLE_OVR_MINUS (char)0x9B	// spindle override -10%
+
 /* XIO return codes
  * These codes are the "inner nest" for the STAT_ return codes.
  * The first N TG codes correspond directly to these codes.
@@ -99,7 +99,7 @@ int xio_putc_rs485(const char c, FILE *stream)
 	if ((next_tx_buf_head = (RSu.tx_buf_head)-1) == 0) { // adv. head & wrap
 		next_tx_buf_head = TX_BUFFER_SIZE-1;	 // -1 avoids the off-by-one
 	}
-	while(next_tx_buf_head == RSu.tx_buf_tail) { // buf full. sleep or ret
+	while(next_tx_buf_head == xio_get_index(RSu.tx_buf_tail)) { // buf full. sleep or ret
 		if (RS.flag_block) {
 			sleep_mode();
 		} else {
@@ -160,16 +160,12 @@ ISR(RS485_RX_ISR_vect)	//ISR(USARTC1_RXC_vect)		// serial port C0 RX isr
 	// trap async commands - do not insert into RX queue
 	if (c == CHAR_RESET) {	 						// trap Kill character
 		hw_request_hard_reset();
+		controller_post_event(EVENT_REALTIME);
 		return;
 	}
-	if (c == CHAR_FEEDHOLD) {						// trap feedhold signal
-		cm_request_feedhold();
-		return;
-	}
-	if (c == CHAR_CYCLE_START) {					// trap end_feedhold signal
-		cm_request_cycle_start();
-		return;
-	}
+	if ((c != CHAR_QUEUE_FLUSH) && (controller_queue_realtime(c))) {
+		return;										// trap feedhold, cycle start and realtime commands
+	}												// (queue flush is not trapped on RS485)
 	// filter out CRs and LFs if they are to be ignored
 	if ((c == CR) && (RS.flag_ignorecr)) return;
 	if ((c == LF) && (RS.flag_ignorelf)) return;
@@ -179,6 +175,11 @@ ISR(RS485_RX_ISR_vect)	//ISR(USARTC1_RXC_vect)		// serial port C0 RX isr
 	if (RSu.rx_buf_head != RSu.rx_buf_tail) {		// write char unless buffer full
 		RSu.rx_buf[RSu.rx_buf_head] = c;			// (= USARTC1.DATA;)
 		RSu.rx_buf_count++;
+		if (xio_is_line_end(c, RSu.rx_last_in)) {	// mark a line boundary
+			RSu.rx_lines_in++;
+			controller_post_event(EVENT_RX);
+		}
+		RSu.rx_last_in = c;
 		// flow control detection goes here - should it be necessary
 		return;
 	}
@@ -93,8 +93,6 @@ static struct cfgUSART const cfgUsart[] PROGMEM = {
  * FUNCTIONS
  ******************************************************************************/
 
-static int _gets_helper(xioDev_t *d, xioUsart_t *dx);
-
 /*
  *	xio_init_usart() - general purpose USART initialization (shared)
  */
@@ -174,6 +172,7 @@ void xio_set_baud_usart(xioUsart_t *dx, const uint8_t baud)
  * xio_xoff_usart() - send XOFF flow control for USART devices
  * xio_xon_usart()  - send XON flow control for USART devices
  * xio_fc_usart() - Usart device flow control callback
+ * xio_get_index_usart() - atomic read of a 16 bit ring index written by an ISR
  * xio_get_tx_bufcount_usart() - returns number of chars in TX buffer
  * xio_get_rx_bufcount_usart() - returns number of chars in RX buffer
  *
@@ -226,28 +225,52 @@ void xio_fc_usart(xioDev_t *d)		// callback from the usart handlers
 	}
 }
 
+buffer_t xio_get_index_usart(const volatile buffer_t *index)
+{
+	buffer_t i;
+	do { i = *index; } while (i != *index);		// re-read if the ISR changed it mid-read
+	return (i);
+}
+
 buffer_t xio_get_tx_bufcount_usart(const xioUsart_t *dx)
 {
-	if (dx->tx_buf_head <= dx->tx_buf_tail) {
-		return (dx->tx_buf_tail - dx->tx_buf_head);
+	buffer_t tail = xio_get_index(dx->tx_buf_tail);
+	if (dx->tx_buf_head <= tail) {
+		return (tail - dx->tx_buf_head);
 	} else {
-		return (TX_BUFFER_SIZE - (dx->tx_buf_head - dx->tx_buf_tail));
+		return (TX_BUFFER_SIZE - (dx->tx_buf_head - tail));
+	}
+}
+
+/*
+ * xio_get_tx_free() - returns free space in the TX buffer of the active response channel
+ *
+ *	Output producers use this to reserve space before writing, rather than letting
+ *	the putc sleep until the host reads enough characters. The active channel is the
+ *	device stderr is set to. Devices without a TX ring never wait, so report them empty.
+ */
+buffer_t xio_get_tx_free(void)
+{
+	uint8_t dev = xio_get_stderr();
+	if (dev >= XIO_DEV_USART_OFFSET + XIO_DEV_USART_COUNT) {
+		return (TX_BUFFER_SIZE);
 	}
+	return (TX_BUFFER_SIZE - xio_get_tx_bufcount_usart(&us[dev - XIO_DEV_USART_OFFSET]));
 }
 
 buffer_t xio_get_rx_bufcount_usart(const xioUsart_t *dx)
 {
 //	return (dx->rx_buf_count);
-	if (dx->rx_buf_head <= dx->rx_buf_tail) {
-		return (dx->rx_buf_tail - dx->rx_buf_head);
+	buffer_t head = xio_get_index(dx->rx_buf_head);
+	if (head <= dx->rx_buf_tail) {
+		return (dx->rx_buf_tail - head);
 	} else {
-		return (RX_BUFFER_SIZE - (dx->rx_buf_head - dx->rx_buf_tail));
+		return (RX_BUFFER_SIZE - (head - dx->rx_buf_tail));
 	}
 }
 
 /*
  *	xio_gets_usart() - read a complete line from the usart device
- * _gets_helper() 	 - non-blocking character getter for gets
  *
  *	Retains line context across calls - so it can be called multiple times.
  *	Reads as many characters as it can until any of the following is true:
@@ -257,6 +280,12 @@ buffer_t xio_get_rx_bufcount_usart(const xioUsart_t *dx)
  *	  - read would cause output buffer overflow (return XIO_BUFFER_FULL)
  *	  - read returns complete line (returns XIO_OK)
  *
+ *	The RX ISRs count line terminators as they arrive, so nothing is copied out of
+ *	the RX buffer until a complete line is there - the line is then read in one pass,
+ *	a contiguous RX span at a time using xio_read_block_usart().
+ *	The exception is a line that fills the buffer to the XOFF high water mark
+ *	without a terminator; that is read as it arrives, as it would never complete.
+ *
  *	Note: LINEMODE flag in device struct is ignored. It's ALWAYS LINEMODE here.
  *	Note: This function assumes ignore CR and ignore LF handled upstream before the RX buffer
  */
@@ -271,45 +300,80 @@ int xio_gets_usart(xioDev_t *d, char *buf, const int size)
 		d->size = size;
 		d->signal = XIO_SIG_OK;					// reset signal register
 	}
-	while (true) {
-		switch (_gets_helper(d,dx)) {
-			case (XIO_BUFFER_EMPTY): return (XIO_EAGAIN); // empty condition
-			case (XIO_BUFFER_FULL): return (XIO_BUFFER_FULL);// overrun err
-			case (XIO_EOL): return (XIO_OK);			  // got complete line
-			case (XIO_EAGAIN): break;					  // loop for next character
+	if ((dx->rx_lines_in == dx->rx_lines_out) &&	// no complete line buffered yet
+		(xio_get_rx_bufcount_usart(dx) < XOFF_RX_HI_WATER_MARK)) {
+		return (XIO_EAGAIN);
+	}
+	while (true) {								// copy the line a contiguous span at a time
+		if (d->len > d->size) return (XIO_BUFFER_FULL);	// still overrun from an earlier call
+		char prev = dx->rx_last_out;
+		char *c = &d->buf[d->len];
+		int count = xio_read_block_usart(d, c, d->size - d->len + 1);
+		if (count == 0) return (XIO_EAGAIN);	// RX buffer is empty
+		if (d->flag_echo) {						// conditional echo regardless of character
+			for (int i=0; i<count; i++) d->x_putc(c[i], stdout);
+		}
+		if ((c[0] == LF) && (prev == CR)) {		// the LF of a CR LF pair ends no line of its own
+			continue;							// (the block ends on it, so it's the only character)
+		}
+		d->len += count;
+		if ((c[count-1] == CR) || (c[count-1] == LF)) {	// handle CR, LF termination
+			d->buf[d->len-1] = NUL;				// terminate line in place of the CR or LF
+			d->signal = XIO_SIG_EOL;
+			d->flag_in_line = false;			// clear in-line state (reset)
+			return (XIO_OK);					// got complete line
+		}
+		if (d->len > d->size) {					// handle buffer overruns
+			d->buf[d->size] = NUL;				// terminate line (d->size is zero based)
+			d->signal = XIO_SIG_EOL;
+			return (XIO_BUFFER_FULL);
 		}
 	}
 	return (XIO_OK);
 }
 
-static int _gets_helper(xioDev_t *d, xioUsart_t *dx)
+/*
+ * xio_read_block_usart() - read up to size characters from the RX buffer
+ *
+ *	Non-blocking. Returns the number of characters copied, which may be zero.
+ *	Characters are copied a contiguous span at a time - from the tail down to the
+ *	head or to the wrap location - so wrap tests and flow control run per span
+ *	rather than per character. The copy ends after the first CR or LF so a line
+ *	reader never takes characters from the next line. No echo is performed.
+ */
+int xio_read_block_usart(xioDev_t *d, char *buf, const int size)
 {
-	char c = NUL;
+	xioUsart_t *dx = d->x;
+	buffer_t head = xio_get_index(dx->rx_buf_head);
+	int count = 0;
 
-	if (dx->rx_buf_head == dx->rx_buf_tail) {	// RX ISR buffer empty
+	if (head == dx->rx_buf_tail) {				// RX ISR buffer empty
 		dx->rx_buf_count = 0;					// reset count for good measure
-		return(XIO_BUFFER_EMPTY);				// stop reading
+		return (0);
 	}
-	advance_buffer(dx->rx_buf_tail, RX_BUFFER_SIZE);
-	dx->rx_buf_count--;
-	d->x_flow(d);								// run flow control
-//	c = dx->rx_buf[dx->rx_buf_tail];			// get char from RX Q
-	c = (dx->rx_buf[dx->rx_buf_tail] & 0x007F);	// get char from RX Q & mask MSB
-	if (d->flag_echo) d->x_putc(c, stdout);		// conditional echo regardless of character
-
-	if (d->len >= d->size) {					// handle buffer overruns
-		d->buf[d->size] = NUL;					// terminate line (d->size is zero based)
-		d->signal = XIO_SIG_EOL;
-		return (XIO_BUFFER_FULL);
-	}
-	if ((c == CR) || (c == LF)) {				// handle CR, LF termination
-		d->buf[(d->len)++] = NUL;
-		d->signal = XIO_SIG_EOL;
-		d->flag_in_line = false;				// clear in-line state (reset)
-		return (XIO_EOL);						// return for end-of-line
+	while ((count < size) && (dx->rx_buf_tail != head)) {
+		buffer_t next = (dx->rx_buf_tail == 1) ? RX_BUFFER_SIZE-1 : dx->rx_buf_tail-1;
+		buffer_t last = (head <= next) ? head : 1;		// end of this contiguous span
+		buffer_t span = 0;
+		uint8_t line_end = false;
+		while (true) {
+			char c = (dx->rx_buf[next] & 0x007F);		// get char from RX Q & mask MSB
+			buf[count++] = c;
+			span++;
+			if ((c == CR) || (c == LF)) {
+				if (xio_is_line_end(c, dx->rx_last_out)) dx->rx_lines_out++;
+				line_end = true;
+			}
+			dx->rx_last_out = c;
+			if ((line_end) || (next == last) || (count == size)) break;
+			next--;
+		}
+		dx->rx_buf_count -= span;
+		xio_set_index(dx->rx_buf_tail, next);			// free the span only once it's copied
+		if (line_end) break;
 	}
-	d->buf[(d->len)++] = c;						// write character to buffer
-	return (XIO_EAGAIN);
+	d->x_flow(d);										// run flow control
+	return (count);
 }
 
 /*
@@ -345,7 +409,7 @@ int xio_getc_usart(FILE *stream)
 	xioUsart_t *dx = d->x;
 	char c;
 
-	while (dx->rx_buf_head == dx->rx_buf_tail) {	// RX ISR buffer empty
+	while (xio_get_index(dx->rx_buf_head) == dx->rx_buf_tail) {	// RX ISR buffer empty
 		dx->rx_buf_count = 0;						// reset count for good measure
 		if (d->flag_block) {
 			sleep_mode();
@@ -354,15 +418,20 @@ int xio_getc_usart(FILE *stream)
 			return(_FDEV_ERR);
 		}
 	}
-	advance_buffer(dx->rx_buf_tail, RX_BUFFER_SIZE);
+	buffer_t tail = dx->rx_buf_tail;
+	advance_buffer(tail, RX_BUFFER_SIZE);
+	xio_set_index(dx->rx_buf_tail, tail);
 	dx->rx_buf_count--;
 	d->x_flow(d);									// flow control callback
 	c = (dx->rx_buf[dx->rx_buf_tail] & 0x007F);		// get char from RX buf & mask MSB
 
 	// Triage the input character for handling. This code does not handle deletes
 	if (d->flag_echo) d->x_putc(c, stdout);			// conditional echo regardless of character
+	char prev = dx->rx_last_out;
+	dx->rx_last_out = c;
 	if (c > CR) return(c); 							// fast cutout for majority cases
 	if ((c == CR) || (c == LF)) {
+		if (xio_is_line_end(c, prev)) dx->rx_lines_out++;
 		if (d->flag_linemode) return('\n');
 	}
 	return(c);
@@ -409,6 +478,8 @@ void xio_queue_RX_char_usart(const uint8_t dev, const char c)
 	if (dx->rx_buf_head != dx->rx_buf_tail) {	// write char unless buffer full
 		dx->rx_buf[dx->rx_buf_head] = c;		// FAKE INPUT DATA
 		dx->rx_buf_count++;
+		if (xio_is_line_end(c, dx->rx_last_in)) dx->rx_lines_in++;
+		dx->rx_last_in = c;
 		return;
 	}
 	// buffer-full handling
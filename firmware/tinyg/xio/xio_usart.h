@@ -47,21 +47,27 @@
 //#define CTRLA_RXOFF_TXOFF_TXCON (USART_TXCINTLVL_LO_gc)
 
 // Buffer sizing
-#define buffer_t uint_fast8_t					// fast, but limits buffer to 255 char max
-//#define buffer_t uint16_t						// larger buffers
+// RX and TX ring sizes are set independently and may be overridden from the build.
+// The index type follows from the larger of the two - 8 bits up to 255, 16 bits above.
+// Must reserve 2 bytes for buffer management. 4096 is the largest supported ring, but
+// RAM is the practical limit on the xmega - 2 x 1022 is about as far as it will go.
+#ifndef RX_BUFFER_SIZE
+#define RX_BUFFER_SIZE 254						// 254 keeps 8 bit indexes
+#endif
+#ifndef TX_BUFFER_SIZE
+#define TX_BUFFER_SIZE 254
+#endif
 
-// Must reserve 2 bytes for buffer management
-#define RX_BUFFER_SIZE (buffer_t)254			// buffer_t can be 8 bits
-#define TX_BUFFER_SIZE (buffer_t)254			// buffer_t can be 8 bits
-//#define RX_BUFFER_SIZE (buffer_t)255			// buffer_t can be 8 bits
-//#define TX_BUFFER_SIZE (buffer_t)255			// buffer_t can be 8 bits
+#if ((RX_BUFFER_SIZE > 4096) || (TX_BUFFER_SIZE > 4096))
+#error "USART ring buffers are limited to 4096 bytes"
+#endif
 
-// Alternates for larger buffers - mostly for debugging
-//#define buffer_t uint16_t						// slower, but larger buffers
-//#define RX_BUFFER_SIZE (buffer_t)510			// buffer_t must be 16 bits if >255
-//#define TX_BUFFER_SIZE (buffer_t)510			// buffer_t must be 16 bits if >255
-//#define RX_BUFFER_SIZE (buffer_t)1022			// 2046 is the practical upper limit
-//#define TX_BUFFER_SIZE (buffer_t)1022			// 2046 is practical upper limit given RAM
+#if ((RX_BUFFER_SIZE > 255) || (TX_BUFFER_SIZE > 255))
+#define buffer_t uint16_t						// slower, but larger buffers
+#define BUFFER_INDEX_16BIT						// ISR-written indexes need atomic reads
+#else
+#define buffer_t uint_fast8_t					// fast, but limits buffer to 255 char max
+#endif
 
 // XON/XOFF hi and lo watermarks. At 115.200 the host has approx. 100 uSec per char
 // to react to an XOFF. 90% (0.9) of 255 chars gives 25 chars to react, or about 2.5 ms.
@@ -70,6 +76,15 @@
 #define XOFF_TX_HI_WATER_MARK (TX_BUFFER_SIZE * 0.9)	// % to issue XOFF
 #define XOFF_TX_LO_WATER_MARK (TX_BUFFER_SIZE * 0.05)	// % to issue XON
 
+// TX space reservations. Output producers check free space before they start writing
+// so they never sleep in xio_putc_usb() waiting for the host to read. A command is only
+// read if a typical response will fit; reports reserve their own space on top of that.
+#define TX_RESPONSE_RESERVE 	(buffer_t)48	// TX free space required to read the next command
+
+// Credit flow control ($ex=3). The host may send as many bytes and as many complete lines
+// as the last credits it was given; credits are reported in response footers and heartbeats.
+#define RX_LINE_CREDITS			8				// max complete lines the host may have queued in RX
+
 // General
 #define USART_TX_REGISTER_READY_bm USART_DREIF_bm
 #define USART_RX_DATA_READY_bm USART_RXCIF_bm
@@ -160,8 +175,7 @@ enum xioFCState {
  ******************************************************************************/
 /*
  * USART extended control structure
- * Note: As defined this struct won't do buffers larger than 256 chars -
- *	     or a max of 254 characters usable
+ * Note: buffer_t sizes the ring indexes - see Buffer sizing, above
  */
 typedef struct xioUSART {
 	uint8_t fc_char_rx;			 			// RX-side flow control character to send
@@ -171,6 +185,10 @@ typedef struct xioUSART {
 	volatile buffer_t rx_buf_tail;			// RX buffer read index
 	volatile buffer_t rx_buf_head;			// RX buffer write index (written by ISR)
 	volatile buffer_t rx_buf_count;			// RX buffer counter for flow control
+	volatile uint8_t rx_lines_in;			// line terminators received (written by ISR)
+	uint8_t rx_lines_out;					// line terminators read - in != out means a line is ready
+	volatile char rx_last_in;				// last character received - see xio_is_line_end()
+	char rx_last_out;						// last character read
 
 	volatile buffer_t tx_buf_tail;			// TX buffer read index  (written by ISR)
 	volatile buffer_t tx_buf_head;			// TX buffer write index
@@ -183,6 +201,21 @@ typedef struct xioUSART {
 	volatile char tx_buf[TX_BUFFER_SIZE];
 } xioUsart_t;
 
+// Indexes written by an ISR (rx_buf_head, tx_buf_tail) must be read with xio_get_index()
+// from the main loop, and rx_buf_tail (read by the RX ISR) written with xio_set_index().
+// 16 bit indexes take two loads or stores and the ISR can run in between.
+#ifdef BUFFER_INDEX_16BIT
+#define xio_get_index(i) xio_get_index_usart(&(i))
+#define xio_set_index(i,v) { uint8_t sreg = SREG; cli(); (i) = (v); SREG = sreg; }
+#else
+#define xio_get_index(i) (i)
+#define xio_set_index(i,v) { (i) = (v); }
+#endif
+
+// A line ends at a CR or an LF, but CR LF ends one line, not two. The LF of a CR LF pair
+// is not counted on either side, so line credits and the line-ready test stay one per line.
+#define xio_is_line_end(c,prev) (((c) == CR) || (((c) == LF) && ((prev) != CR)))
+
 /******************************************************************************
  * USART CLASS AND DEVICE FUNCTION PROTOTYPES AND ALIASES
  ******************************************************************************/
@@ -200,10 +233,18 @@ int xio_putc_rs485(const char c, FILE *stream);	// stdio compatible put characte
 void xio_enable_rs485_rx(void);					// needed for startup
 void xio_enable_rs485_tx(void);					// included for completeness
 
+// block transfers - copy contiguous ring spans rather than one character at a time
+int xio_read_block_usart(xioDev_t *d, char *buf, const int size);
+int xio_write_block_usb(const char *buf, const int size);
+
 // handy helpers
+buffer_t xio_get_index_usart(const volatile buffer_t *index);
 buffer_t xio_get_rx_bufcount_usart(const xioUsart_t *dx);
 buffer_t xio_get_tx_bufcount_usart(const xioUsart_t *dx);
 buffer_t xio_get_usb_rx_free(void);
+buffer_t xio_get_tx_free(void);
+buffer_t xio_get_usb_rx_credits(void);
+uint8_t xio_get_usb_line_credits(void);
 void xio_reset_usb_rx_buffers(void);
 
 void xio_queue_RX_char_usart(const uint8_t dev, const char c);
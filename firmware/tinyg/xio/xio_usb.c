@@ -56,8 +56,8 @@ int xio_putc_usb(const char c, FILE *stream)
 	buffer_t next_tx_buf_head = USBu.tx_buf_head-1;		// set next head while leaving current one alone
 	if (next_tx_buf_head == 0)
 		next_tx_buf_head = TX_BUFFER_SIZE-1; 			// detect wrap and adjust; -1 avoids off-by-one
-	while (next_tx_buf_head == USBu.tx_buf_tail)
-		sleep_mode(); 									// sleep until there is space in the buffer
+	while (next_tx_buf_head == xio_get_index(USBu.tx_buf_tail))
+		sleep_mode(); 									// backstop only - producers reserve space up front
 	USBu.usart->CTRLA = CTRLA_RXON_TXOFF;				// disable TX interrupt (mutex region)
 	USBu.tx_buf_head = next_tx_buf_head;				// accept next buffer head
 	USBu.tx_buf[USBu.tx_buf_head] = c;					// write char to buffer
@@ -67,7 +67,7 @@ int xio_putc_usb(const char c, FILE *stream)
 		USBu.usart->CTRLA = CTRLA_RXON_TXON;			// force interrupt to send the queued <CR>
 		buffer_t next_tx_buf_head = USBu.tx_buf_head-1;
 		if (next_tx_buf_head == 0) next_tx_buf_head = TX_BUFFER_SIZE-1;
-		while (next_tx_buf_head == USBu.tx_buf_tail) sleep_mode();
+		while (next_tx_buf_head == xio_get_index(USBu.tx_buf_tail)) sleep_mode();
 		USBu.usart->CTRLA = CTRLA_RXON_TXOFF;			// MUTEX region
 		USBu.tx_buf_head = next_tx_buf_head;
 		USBu.tx_buf[USBu.tx_buf_head] = CR;
@@ -77,6 +77,47 @@ int xio_putc_usb(const char c, FILE *stream)
 	return (XIO_OK);
 }
 
+/*
+ * xio_write_block_usb() - write a block of characters to the USB TX buffer
+ *
+ *	Same semantics as calling xio_putc_usb() for each character, including <LF><CR>
+ *	expansion, but the buffer head is published and the TX interrupt kicked once per
+ *	contiguous span instead of once per character. Returns the number of characters
+ *	taken from buf, which is always size.
+ */
+int xio_write_block_usb(const char *buf, const int size)
+{
+	int count = 0;
+	uint8_t pending_cr = false;							// <CR> owed from <LF><CR> expansion
+
+	while ((count < size) || (pending_cr)) {
+		buffer_t next = (USBu.tx_buf_head == 1) ? TX_BUFFER_SIZE-1 : USBu.tx_buf_head-1;
+		buffer_t tail = xio_get_index(USBu.tx_buf_tail);
+		if (next == tail) {
+			sleep_mode();								// backstop only - see xio_putc_usb()
+			continue;
+		}
+		buffer_t last = (tail < next) ? tail+1 : 1;		// end of this contiguous span
+		buffer_t head;
+		do {											// fill the span (not yet visible to the ISR)
+			head = next--;
+			if (pending_cr) {
+				USBu.tx_buf[head] = CR;
+				pending_cr = false;
+			} else {
+				char c = buf[count++];
+				USBu.tx_buf[head] = c;
+				pending_cr = ((c == '\n') && (USB.flag_crlf));
+			}
+		} while ((head != last) && ((count < size) || (pending_cr)));
+
+		USBu.usart->CTRLA = CTRLA_RXON_TXOFF;			// disable TX interrupt (mutex region)
+		USBu.tx_buf_head = head;						// publish the span
+		USBu.usart->CTRLA = CTRLA_RXON_TXON;			// force interrupt to send the span
+	}
+	return (count);
+}
+
 ISR(USB_TX_ISR_vect) //ISR(USARTC0_DRE_vect)		// USARTC0 data register empty
 {
 	// If the CTS pin (FTDI's RTS) is HIGH, then we cannot send anything, so exit
@@ -101,6 +142,7 @@ ISR(USB_TX_ISR_vect) //ISR(USARTC0_DRE_vect)		// USARTC0 data register empty
 	if (USBu.tx_buf_head != USBu.tx_buf_tail) {		// buffer has data
 		advance_buffer(USBu.tx_buf_tail, TX_BUFFER_SIZE);
 		USBu.usart->DATA = USBu.tx_buf[USBu.tx_buf_tail];
+		controller_post_event(EVENT_TX);			// wake a controller waiting for TX space
 	} else {
 		USBu.usart->CTRLA = CTRLA_RXON_TXOFF;		// buffer has no data; force another interrupt
 	}
@@ -145,19 +187,11 @@ ISR(USB_RX_ISR_vect)	//ISR(USARTC0_RXC_vect)	// serial port C0 RX int
 	// trap async commands - do not insert character into RX queue
 	if (c == CHAR_RESET) {	 					// trap Kill signal
 		hw_request_hard_reset();
+		controller_post_event(EVENT_REALTIME);
 		return;
 	}
-	if (c == CHAR_FEEDHOLD) {					// trap feedhold signal
-		cm_request_feedhold();
-		return;
-	}
-	if (c == CHAR_QUEUE_FLUSH) {				// trap queue flush signal
-		cm_request_queue_flush();
-		return;
-	}
-	if (c == CHAR_CYCLE_START) {				// trap cycle start signal
-		cm_request_cycle_start();
-		return;
+	if (controller_queue_realtime(c)) {			// trap feedhold, cycle start, queue flush
+		return;									// and realtime command characters
 	}
 	if (USB.flag_xoff) {
 		if (c == XOFF) {						// trap incoming XON/XOFF signals
@@ -180,6 +214,11 @@ ISR(USB_RX_ISR_vect)	//ISR(USARTC0_RXC_vect)	// serial port C0 RX int
 	if (USBu.rx_buf_head != USBu.rx_buf_tail) {	// buffer is not full
 		USBu.rx_buf[USBu.rx_buf_head] = c;		// write char unless full
 		USBu.rx_buf_count++;
+		if (xio_is_line_end(c, USBu.rx_last_in)) {	// mark a line boundary for xio_gets_usart()
+			USBu.rx_lines_in++;
+			controller_post_event(EVENT_RX);
+		}
+		USBu.rx_last_in = c;
 		if ((USB.flag_xoff) && (xio_get_rx_bufcount_usart(&USBu) > XOFF_RX_HI_WATER_MARK)) {
 			xio_xoff_usart(&USBu);
 		}
@@ -201,6 +240,32 @@ buffer_t xio_get_usb_rx_free(void)
 	return (RX_BUFFER_SIZE - xio_get_rx_bufcount_usart(&USBu));
 }
 
+/*
+ * xio_get_usb_rx_credits()   - returns bytes the host may send without overrunning RX
+ * xio_get_usb_line_credits() - returns complete lines the host may send
+ *
+ *	Credits for the credit flow control protocol. Unlike xio_get_usb_rx_free() the byte
+ *	credit is exact or conservative - it never counts the 2 slots used for buffer
+ *	management. Line credits come back as xio_gets_usart() consumes lines.
+ */
+buffer_t xio_get_usb_rx_credits(void)
+{
+	buffer_t count = xio_get_rx_bufcount_usart(&USBu);
+	if (count >= RX_BUFFER_SIZE-2) {
+		return (0);
+	}
+	return (RX_BUFFER_SIZE-2 - count);
+}
+
+uint8_t xio_get_usb_line_credits(void)
+{
+	uint8_t lines = USBu.rx_lines_in - USBu.rx_lines_out;	// complete lines waiting in RX
+	if (lines >= RX_LINE_CREDITS) {
+		return (0);
+	}
+	return (RX_LINE_CREDITS - lines);
+}
+
 /*
  * xio_reset_usb_rx_buffers() - clears the USB RX buffer
  */
@@ -213,4 +278,6 @@ void xio_reset_usb_rx_buffers(void)
 	// reset RX interrupt circular buffer
 	USBu.rx_buf_head = 1;		// can't use location 0 in circular buffer
 	USBu.rx_buf_tail = 1;
+	USBu.rx_lines_out = USBu.rx_lines_in;
+	USBu.rx_last_out = USBu.rx_last_in;
 }
@@ -404,6 +404,29 @@ uint16_t EEPROM_WriteBytes(const uint16_t address, const int8_t *buf, const uint
 #endif //__NNVM
 }
 
+/*
+ * EEPROM_WritePage() - write one full page to EEPROM in a single erase/write
+ *
+ *	Writes EEPROM_PAGESIZE bytes from buf to the page starting at address,
+ *	which must be page aligned. This costs one page erase regardless of how
+ *	many bytes changed, as opposed to one erase per byte for EEPROM_WriteBytes().
+ *	If memory mapped EEPROM is enabled this function will not work.
+ *
+ *	Returns address past the write
+ */
+
+uint16_t EEPROM_WritePage(const uint16_t address, const int8_t *buf)
+{
+#ifdef __NNVM
+	NNVM_WriteBytes(address, buf, EEPROM_PAGESIZE);
+#else
+	EEPROM_FlushBuffer();					// discard any partially loaded page
+	EEPROM_LoadPage((const uint8_t *)buf);	// also disables mapping
+	EEPROM_AtomicWritePage(address / EEPROM_PAGESIZE);
+#endif //__NNVM
+	return (address + EEPROM_PAGESIZE);
+}
+
 /*
  * EEPROM_ReadBytes() - read N bytes to EEPROM; may span multiple pages
  *
@@ -611,7 +634,7 @@ inline void EEPROM_AtomicWritePage(uint8_t pageAddr)
 	NVM.ADDR1 = (address >> 8) & EEPROM_ADDR1_MASK_gm;
 	NVM.ADDR2 = 0x00;
 	NVM.CMD = NVM_CMD_ERASE_WRITE_EEPROM_PAGE_gc; // erase & write page command
-	NVM_EXEC();
+	NVM_EXEC_WRAPPER();
 }
 
 /*
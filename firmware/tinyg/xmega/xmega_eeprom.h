@@ -78,6 +78,7 @@ uint16_t EEPROM_WriteString(const uint16_t address, const char *buf, const uint8
 uint16_t EEPROM_ReadString(const uint16_t address, char *buf, const uint16_t size);
 uint16_t EEPROM_WriteBytes(const uint16_t address, const int8_t *buf, const uint16_t size);
 uint16_t EEPROM_ReadBytes(const uint16_t address, int8_t *buf, const uint16_t size);
+uint16_t EEPROM_WritePage(const uint16_t address, const int8_t *buf);
 
 //#ifdef __UNIT_TEST_EEPROM
 void EEPROM_unit_tests(void);
@@ -99,6 +100,7 @@ void EEPROM_EraseAll( void );
 
 // Note: the ByPage macros rely on pagesize = 32, and are as yet untested
 #define EEPROM_ReadChar (char)EEPROM_ReadByte
+#define EEPROM_IsBusy() ((NVM.STATUS & NVM_NVMBUSY_bm) == NVM_NVMBUSY_bm)
 #define EEPROM_ReadByteByPage(p,b) EEPROM_ReadByte( (p<<5) | (b) )
 #define EEPROM_ReadCharByPage(p,b) (char)EEPROM_ReadByte( (p<<5) | (b) )
 #define EEPROM_WriteByteByPage(p,b,v) EEPROM_ReadByte( ((p<<5) | (b)), v )
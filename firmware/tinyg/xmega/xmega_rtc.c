@@ -22,6 +22,7 @@
 
 #include "../tinyg.h"
 #include "../config.h"
+#include "../controller.h"
 #include "../switch.h"
 #include "xmega_rtc.h"
 
@@ -76,4 +77,5 @@ ISR(RTC_COMP_vect)
 
 	// callbacks to whatever you need to happen on each RTC tick go here:
 	switch_rtc_callback();					// switch debouncing
+	controller_post_event(EVENT_TICK);		// run the controller's timed tasks
 }